@@ -0,0 +1,406 @@
+//Least squares fitting of cubic Bezier curves to points
+//Schneider, "An Algorithm for Automatically Fitting Digitized Curves", Graphics Gems, 1990
+
+#include <iostream>
+#include <cmath>
+#include <vector>
+#include <assert.h>
+#include "BezierFit.h"
+using namespace std;
+
+static const int FIT_MAX_ITERATIONS = 4;
+static const double FIT_SAMPLE_SPACING = 8.0; //Longest gap between points, in units of maxError
+
+inline Point Sub(const Point &a, const Point &b)
+{
+	return Point(a.first - b.first, a.second - b.second);
+}
+
+inline Point Scale(const Point &a, double s)
+{
+	return Point(a.first * s, a.second * s);
+}
+
+inline double Dot(const Point &a, const Point &b)
+{
+	return a.first * b.first + a.second * b.second;
+}
+
+inline Point Normalize(const Point &a)
+{
+	double len = sqrt(Dot(a, a));
+	if(len == 0.0)
+		return a;
+	return Scale(a, 1.0 / len);
+}
+
+inline Point Along(const Point &pt, const Point &dir, double dist)
+{
+	return Point(pt.first + dir.first * dist, pt.second + dir.second * dist);
+}
+
+///Evaluate a Bezier curve of the given degree with de Casteljau's algorithm
+static Point BezierPoint(const Point *ctrl, int degree, double t)
+{
+	Point tmp[4];
+	for(int i = 0; i <= degree; i++)
+		tmp[i] = ctrl[i];
+	for(int i = 1; i <= degree; i++)
+		for(int j = 0; j <= degree-i; j++)
+			tmp[j] = Point((1.0-t) * tmp[j].first + t * tmp[j+1].first,
+				(1.0-t) * tmp[j].second + t * tmp[j+1].second);
+	return tmp[0];
+}
+
+///Points first to last, parameterized by chord length
+class FitSpan
+{
+public:
+	size_t first, last;
+	Point tan1, tan2; //Unit tangents at the ends, pointing into the span
+};
+
+static void ChordLengthParameterize(const Point *pts, size_t first, size_t last, vector<double> &u)
+{
+	u.resize(last - first + 1);
+	u[0] = 0.0;
+	for(size_t i = first+1; i <= last; i++)
+	{
+		Point d = Sub(pts[i], pts[i-1]);
+		u[i-first] = u[i-first-1] + sqrt(Dot(d, d));
+	}
+	double total = u[last-first];
+	for(size_t i = 1; i <= last-first; i++)
+		u[i] /= total;
+}
+
+///Find the control points with the given end tangents that best fit the points in the
+///least squares sense, for the current parameter values
+static void GenerateBezier(const Point *pts, const class FitSpan &span, const vector<double> &u,
+	Point *ctrl)
+{
+	const Point &p0 = pts[span.first];
+	const Point &p3 = pts[span.last];
+	double c00 = 0.0, c01 = 0.0, c11 = 0.0, x0 = 0.0, x1 = 0.0;
+	for(size_t i = 0; i < u.size(); i++)
+	{
+		double t = u[i], mt = 1.0 - t;
+		double b0 = mt*mt*mt, b1 = 3.0*t*mt*mt, b2 = 3.0*t*t*mt, b3 = t*t*t;
+		Point a1 = Scale(span.tan1, b1);
+		Point a2 = Scale(span.tan2, b2);
+		c00 += Dot(a1, a1);
+		c01 += Dot(a1, a2);
+		c11 += Dot(a2, a2);
+		Point tmp = Sub(pts[span.first+i], Point(p0.first * (b0+b1) + p3.first * (b2+b3),
+			p0.second * (b0+b1) + p3.second * (b2+b3)));
+		x0 += Dot(a1, tmp);
+		x1 += Dot(a2, tmp);
+	}
+
+	double det = c00 * c11 - c01 * c01;
+	double alpha1 = 0.0, alpha2 = 0.0;
+	if(det != 0.0)
+	{
+		alpha1 = (x0 * c11 - x1 * c01) / det;
+		alpha2 = (c00 * x1 - c01 * x0) / det;
+	}
+
+	//Fall back to a third of the chord if the solution is degenerate
+	Point chord = Sub(p3, p0);
+	double segLength = sqrt(Dot(chord, chord));
+	double epsilon = 1e-6 * segLength;
+	if(alpha1 < epsilon || alpha2 < epsilon)
+		alpha1 = alpha2 = segLength / 3.0;
+
+	ctrl[0] = p0;
+	ctrl[1] = Along(p0, span.tan1, alpha1);
+	ctrl[2] = Along(p3, span.tan2, alpha2);
+	ctrl[3] = p3;
+}
+
+///Improve a parameter value with one Newton-Raphson step towards the closest point
+static double NewtonRaphsonRootFind(const Point *ctrl, const Point &pt, double t)
+{
+	Point d1[3], d2[2];
+	for(int i = 0; i < 3; i++)
+		d1[i] = Scale(Sub(ctrl[i+1], ctrl[i]), 3.0);
+	for(int i = 0; i < 2; i++)
+		d2[i] = Scale(Sub(d1[i+1], d1[i]), 2.0);
+
+	Point q = BezierPoint(ctrl, 3, t);
+	Point q1 = BezierPoint(d1, 2, t);
+	Point q2 = BezierPoint(d2, 1, t);
+	Point diff = Sub(q, pt);
+	double numerator = Dot(diff, q1);
+	double denominator = Dot(q1, q1) + Dot(diff, q2);
+	if(denominator == 0.0)
+		return t;
+	return t - numerator / denominator;
+}
+
+///\return largest squared distance between the points and the curve, and where it is
+static double ComputeMaxError(const Point *pts, const class FitSpan &span, const Point *ctrl,
+	const vector<double> &u, size_t &splitPointOut)
+{
+	double maxDist2 = 0.0;
+	splitPointOut = (span.first + span.last) / 2;
+	for(size_t i = span.first+1; i < span.last; i++)
+	{
+		Point d = Sub(BezierPoint(ctrl, 3, u[i-span.first]), pts[i]);
+		double dist2 = Dot(d, d);
+		if(dist2 >= maxDist2)
+		{
+			maxDist2 = dist2;
+			splitPointOut = i;
+		}
+	}
+	return maxDist2;
+}
+
+static void FitSpans(const Point *pts, const class FitSpan &whole, double maxError,
+	class TwistedPath &bezierOut)
+{
+	double error2 = maxError * maxError;
+	vector<class FitSpan> stack;
+	stack.push_back(whole);
+	vector<double> u, uPrime;
+	Point ctrl[4];
+
+	while(stack.size() > 0)
+	{
+		class FitSpan span = stack.back();
+		stack.pop_back();
+
+		if(span.last - span.first == 1)
+		{
+			Point chord = Sub(pts[span.last], pts[span.first]);
+			double dist = sqrt(Dot(chord, chord)) / 3.0;
+			ctrl[1] = Along(pts[span.first], span.tan1, dist);
+			ctrl[2] = Along(pts[span.last], span.tan2, dist);
+			bezierOut.CurveTo(ctrl[1].first, ctrl[1].second, ctrl[2].first, ctrl[2].second,
+				pts[span.last].first, pts[span.last].second);
+			continue;
+		}
+
+		ChordLengthParameterize(pts, span.first, span.last, u);
+		GenerateBezier(pts, span, u, ctrl);
+		size_t splitPoint = 0;
+		double err2 = ComputeMaxError(pts, span, ctrl, u, splitPoint);
+
+		//If the fit is close, try to improve it by reparameterizing. Error is only
+		//measured on the curve if the parameters stay in [0,1], and the points
+		//must keep their order along it, else the previous fit is kept.
+		if(err2 >= error2 && err2 < 16.0 * error2)
+		{
+			for(int iter = 0; iter < FIT_MAX_ITERATIONS && err2 >= error2; iter++)
+			{
+				uPrime.resize(u.size());
+				bool monotonic = true;
+				for(size_t i = 0; i < u.size(); i++)
+				{
+					double t = NewtonRaphsonRootFind(ctrl, pts[span.first+i], u[i]);
+					uPrime[i] = t < 0.0 ? 0.0 : (t > 1.0 ? 1.0 : t);
+					if(i > 0 && uPrime[i] < uPrime[i-1])
+						monotonic = false;
+				}
+				if(!monotonic)
+					break;
+				u.swap(uPrime);
+				GenerateBezier(pts, span, u, ctrl);
+				err2 = ComputeMaxError(pts, span, ctrl, u, splitPoint);
+			}
+		}
+
+		if(err2 < error2)
+		{
+			bezierOut.CurveTo(ctrl[1].first, ctrl[1].second, ctrl[2].first, ctrl[2].second,
+				ctrl[3].first, ctrl[3].second);
+			continue;
+		}
+
+		//Split at the worst point with a shared tangent, so the join stays smooth.
+		//The right half is pushed first so the left half is output first.
+		Point centerTan = Normalize(Sub(pts[splitPoint-1], pts[splitPoint+1]));
+		if(centerTan.first == 0.0 && centerTan.second == 0.0)
+			centerTan = Normalize(Sub(pts[splitPoint-1], pts[splitPoint]));
+		class FitSpan left = span, right = span;
+		left.last = splitPoint;
+		left.tan2 = centerTan;
+		right.first = splitPoint;
+		right.tan1 = Scale(centerTan, -1.0);
+		stack.push_back(right);
+		stack.push_back(left);
+	}
+}
+
+void FitBezierToPoints(const Contour &line, double maxError, double cornerAngle,
+	class TwistedPath &bezierOut)
+{
+	bezierOut.Clear();
+
+	//Error is only measured at the points, so long straight segments get
+	//extra points to keep the curves close to them. Repeated points have
+	//no direction, so they are dropped.
+	double spacing = FIT_SAMPLE_SPACING * maxError;
+	Contour pts;
+	pts.reserve(line.size());
+	for(size_t i = 0; i < line.size(); i++)
+	{
+		if(pts.size() > 0 && line[i] == pts.back())
+			continue;
+		if(pts.size() > 0 && spacing > 0.0)
+		{
+			Point prev = pts.back();
+			Point d = Sub(line[i], prev);
+			int steps = (int)ceil(sqrt(Dot(d, d)) / spacing);
+			for(int j = 1; j < steps; j++)
+				pts.push_back(Along(prev, d, (double)j / steps));
+		}
+		pts.push_back(line[i]);
+	}
+	if(pts.size() == 0)
+		return;
+
+	bezierOut.MoveTo(pts[0].first, pts[0].second);
+	if(pts.size() == 1)
+		return;
+
+	//Split into runs between corners, each fitted with smooth joins
+	double cosCorner = cos(cornerAngle);
+	size_t runStart = 0;
+	for(size_t i = 1; i < pts.size(); i++)
+	{
+		bool corner = false;
+		if(i + 1 < pts.size() && cornerAngle < M_PI)
+		{
+			Point in = Normalize(Sub(pts[i], pts[i-1]));
+			Point out = Normalize(Sub(pts[i+1], pts[i]));
+			corner = Dot(in, out) < cosCorner;
+		}
+		if(!corner && i + 1 < pts.size())
+			continue;
+
+		class FitSpan span;
+		span.first = runStart;
+		span.last = i;
+		span.tan1 = Normalize(Sub(pts[runStart+1], pts[runStart]));
+		span.tan2 = Normalize(Sub(pts[i-1], pts[i]));
+		FitSpans(&pts[0], span, maxError, bezierOut);
+		runStart = i;
+	}
+}
+
+static double FitTestRandom(unsigned &state, double lo, double hi)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return lo + (hi - lo) * (state / 4294967296.0);
+}
+
+///True if a point is within the tolerance of any of the path's curves. Each curve
+///is sampled finely enough for the spacing along it to be well under the tolerance,
+///and skipped if its control points are all too far away to be close.
+static bool FitTestNearPath(const class TwistedPath &path, const Point &pt, double tolerance)
+{
+	double tolerance2 = tolerance * tolerance;
+	const double *ctrl = &path.coords[0];
+	for(size_t i = 1; i < path.Size(); i++, ctrl += 6)
+	{
+		Point bez[4] = {Point(ctrl[0], ctrl[1]), Point(ctrl[2], ctrl[3]),
+			Point(ctrl[4], ctrl[5]), Point(ctrl[6], ctrl[7])};
+		bool left = true, right = true, below = true, above = true;
+		double polyLen = 0.0;
+		for(int j = 0; j < 4; j++)
+		{
+			left = left && bez[j].first < pt.first - tolerance;
+			right = right && bez[j].first > pt.first + tolerance;
+			below = below && bez[j].second < pt.second - tolerance;
+			above = above && bez[j].second > pt.second + tolerance;
+			if(j > 0)
+			{
+				Point d = Sub(bez[j], bez[j-1]);
+				polyLen += sqrt(Dot(d, d));
+			}
+		}
+		if(left || right || below || above)
+			continue;
+
+		int steps = (int)ceil(polyLen / (0.01 * tolerance)) + 1;
+		for(int j = 0; j <= steps; j++)
+		{
+			Point d = Sub(BezierPoint(bez, 3, (double)j / steps), pt);
+			if(Dot(d, d) < tolerance2)
+				return true;
+		}
+	}
+	return false;
+}
+
+void FitBezierToPointsTests()
+{
+	// ** Straight line needs one curve **
+	Contour line;
+	for(int i = 0; i <= 10; i++)
+		line.push_back(Point(i * 10.0, i * 5.0));
+	class TwistedPath path;
+	FitBezierToPoints(line, 0.5, M_PI, path);
+	cout << "fitted curves " << path.Size()-1 << endl;
+	assert(path.Size() == 2);
+	assert(path.verbs[0] == MoveTo && path.verbs[1] == CurveTo);
+	assert(path.coords[6] == 100.0 && path.coords[7] == 50.0);
+
+	// ** Quarter circle fits within the error with few curves **
+	Contour arc;
+	for(int i = 0; i <= 90; i++)
+	{
+		double ang = i * M_PI / 180.0;
+		arc.push_back(Point(100.0 * cos(ang), 100.0 * sin(ang)));
+	}
+	FitBezierToPoints(arc, 0.1, M_PI, path);
+	assert(path.Size() >= 2 && path.Size() <= 4);
+	const double *ctrl = &path.coords[0];
+	for(size_t i = 1; i < path.Size(); i++)
+	{
+		for(int j = 0; j <= 10; j++)
+		{
+			Point bez[4] = {Point(ctrl[0], ctrl[1]), Point(ctrl[2], ctrl[3]),
+				Point(ctrl[4], ctrl[5]), Point(ctrl[6], ctrl[7])};
+			Point pt = BezierPoint(bez, 3, j / 10.0);
+			double r = sqrt(Dot(pt, pt));
+			assert(fabs(r - 100.0) < 0.2);
+		}
+		ctrl += 6;
+	}
+
+	// ** Right angle is kept as a corner **
+	Contour corner;
+	corner.push_back(Point(0.0, 0.0));
+	corner.push_back(Point(10.0, 0.0));
+	corner.push_back(Point(20.0, 0.0));
+	corner.push_back(Point(20.0, 10.0));
+	corner.push_back(Point(20.0, 20.0));
+	FitBezierToPoints(corner, 0.5, M_PI / 4.0, path);
+	assert(path.Size() == 3);
+	assert(path.coords[6] == 20.0 && path.coords[7] == 0.0);
+	assert(path.coords[12] == 20.0 && path.coords[13] == 20.0);
+
+	// ** Every point of a wiggly random walk is within the error of the curves **
+	unsigned state = 12345;
+	for(int trial = 0; trial < 50; trial++)
+	{
+		Contour walk;
+		double x = 0.0, y = 0.0, heading = 0.0;
+		for(int i = 0; i < 60; i++)
+		{
+			walk.push_back(Point(x, y));
+			heading += FitTestRandom(state, -3.0, 3.0);
+			double step = FitTestRandom(state, 1.0, 10.0);
+			x += step * cos(heading);
+			y += step * sin(heading);
+		}
+		FitBezierToPoints(walk, 0.5, M_PI, path);
+		for(size_t i = 0; i < walk.size(); i++)
+			assert(FitTestNearPath(path, walk[i], 0.5 * 1.01));
+	}
+}
@@ -0,0 +1,14 @@
+#ifndef _BEZIER_FIT_H
+#define _BEZIER_FIT_H
+#include "drawlib.h"
+
+///Fit a smooth path of cubic Bezier curves through a line, using as few curves
+///as keep every point within maxError of the path (Schneider's algorithm).
+///Vertices where the line turns by more than cornerAngle (radians) become sharp
+///corners; M_PI or more keeps the whole path smooth.
+void FitBezierToPoints(const Contour &line, double maxError, double cornerAngle,
+	class TwistedPath &bezierOut);
+
+void FitBezierToPointsTests();
+
+#endif //_BEZIER_FIT_H
@@ -0,0 +1,129 @@
+//Single producer, single consumer ring buffer
+//https://en.wikipedia.org/wiki/Circular_buffer
+
+#include "CmdRing.h"
+#include <iostream>
+#include <thread>
+#include <assert.h>
+using namespace std;
+
+CmdRing::CmdRing(size_t capacity) : head(0), tail(0)
+{
+	size_t size = 1;
+	while(size < capacity)
+		size *= 2;
+	this->slots.resize(size, NULL);
+	this->mask = size - 1;
+}
+
+CmdRing::~CmdRing()
+{
+	//Commands still in the ring are owned by it
+	class BaseCmd *cmd = NULL;
+	while(this->TryPop(cmd))
+		delete cmd;
+}
+
+bool CmdRing::TryPush(class BaseCmd *cmd)
+{
+	size_t t = this->tail.load(memory_order_relaxed);
+	if(t - this->head.load() >= this->slots.size())
+		return false;
+	this->slots[t & this->mask] = cmd;
+	this->tail.store(t + 1); //Publishes the slot to the consumer
+	return true;
+}
+
+bool CmdRing::TryPop(class BaseCmd *&cmdOut)
+{
+	size_t h = this->head.load(memory_order_relaxed);
+	if(h == this->tail.load())
+		return false;
+	cmdOut = this->slots[h & this->mask];
+	this->slots[h & this->mask] = NULL;
+	this->head.store(h + 1); //Hands the slot back to the producer
+	return true;
+}
+
+bool CmdRing::Empty() const
+{
+	return this->head.load() == this->tail.load();
+}
+
+bool CmdRing::Full() const
+{
+	return this->tail.load() - this->head.load() >= this->slots.size();
+}
+
+size_t CmdRing::Capacity() const
+{
+	return this->slots.size();
+}
+
+// *************************************
+
+static void CmdRingTestConsumer(class CmdRing *ring, size_t count, bool *inOrder)
+{
+	*inOrder = true;
+	for(size_t i = 0; i < count; )
+	{
+		class BaseCmd *cmd = NULL;
+		if(!ring->TryPop(cmd))
+		{
+			this_thread::yield();
+			continue;
+		}
+		//The command type field carries the sequence number modulo the number of types
+		if(cmd->type != (CmdTypes)(i % (CMD_INSTANCES + 1)))
+			*inOrder = false;
+		delete cmd;
+		i++;
+	}
+}
+
+void CmdRingTests()
+{
+	// ** Capacity rounds up and full or empty rings refuse **
+	class CmdRing ring(5);
+	assert(ring.Capacity() == 8);
+	assert(ring.Empty());
+	class BaseCmd *cmd = NULL;
+	assert(!ring.TryPop(cmd));
+	for(int i = 0; i < 8; i++)
+		assert(ring.TryPush(new class BaseCmd()));
+	assert(ring.Full());
+	class BaseCmd extra;
+	assert(!ring.TryPush(&extra));
+
+	// ** Wrapping around keeps the order **
+	for(int i = 0; i < 8; i++)
+	{
+		assert(ring.TryPop(cmd));
+		delete cmd;
+	}
+	for(int i = 0; i < 5; i++)
+		assert(ring.TryPush(new class BaseCmd((CmdTypes)i)));
+	for(int i = 0; i < 5; i++)
+	{
+		assert(ring.TryPop(cmd));
+		assert(cmd->type == (CmdTypes)i);
+		delete cmd;
+	}
+	assert(ring.Empty());
+
+	// ** Order is kept between threads **
+	size_t count = 200000;
+	bool inOrder = false;
+	thread consumer(CmdRingTestConsumer, &ring, count, &inOrder);
+	for(size_t i = 0; i < count; )
+	{
+		cmd = new class BaseCmd((CmdTypes)(i % (CMD_INSTANCES + 1)));
+		while(!ring.TryPush(cmd))
+			this_thread::yield();
+		i++;
+	}
+	consumer.join();
+	cout << "ring in order " << inOrder << endl;
+	assert(inOrder);
+	assert(ring.Empty());
+}
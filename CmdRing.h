@@ -0,0 +1,34 @@
+#ifndef _CMD_RING_H
+#define _CMD_RING_H
+
+#include <vector>
+#include <atomic>
+#include "drawlib.h"
+
+///Bounded ring of commands passed from one producer thread to one consumer
+///thread without locks. Slots are reused as the ring wraps around.
+class CmdRing
+{
+protected:
+	std::vector<class BaseCmd *> slots;
+	size_t mask;
+	std::atomic<size_t> head; //Next slot to pop, only written by the consumer
+	std::atomic<size_t> tail; //Next slot to push, only written by the producer
+
+public:
+	///Capacity is rounded up to a power of two
+	CmdRing(size_t capacity);
+	virtual ~CmdRing();
+
+	///\return false if the ring is full
+	bool TryPush(class BaseCmd *cmd);
+	///\return false if the ring is empty
+	bool TryPop(class BaseCmd *&cmdOut);
+	bool Empty() const;
+	bool Full() const;
+	size_t Capacity() const;
+};
+
+void CmdRingTests();
+
+#endif //_CMD_RING_H
@@ -0,0 +1,25 @@
+#include <stdlib.h>
+#include "CpuFeatures.h"
+
+static int DetectSimdLevel()
+{
+	int detected = SIMD_NONE;
+#ifdef DRAWLIB_X86_SIMD
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("sse2"))
+		detected = SIMD_SSE2;
+	if(__builtin_cpu_supports("avx"))
+		detected = SIMD_AVX;
+#endif
+	const char *forced = getenv("DRAWLIB_SIMD");
+	if(forced != NULL && atoi(forced) < detected)
+		detected = atoi(forced) > 0 ? atoi(forced) : SIMD_NONE;
+	return detected;
+}
+
+SimdLevel GetSimdLevel()
+{
+	//Detected once, safely even if worker threads ask at the same time
+	static const int level = DetectSimdLevel();
+	return (SimdLevel)level;
+}
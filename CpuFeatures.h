@@ -0,0 +1,20 @@
+#ifndef _CPU_FEATURES_H
+#define _CPU_FEATURES_H
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DRAWLIB_X86_SIMD
+#endif
+
+///Vector instruction sets that kernels can dispatch on
+enum SimdLevel
+{
+	SIMD_NONE,
+	SIMD_SSE2,
+	SIMD_AVX
+};
+
+///Detect the best instruction set the processor supports. This can be
+///lowered with the DRAWLIB_SIMD environment variable (0 none, 1 SSE2, 2 AVX).
+SimdLevel GetSimdLevel();
+
+#endif //_CPU_FEATURES_H
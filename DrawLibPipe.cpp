@@ -0,0 +1,217 @@
+#include "DrawLibPipe.h"
+using namespace std;
+
+DrawLibPipe::DrawLibPipe(class DrawLibCairo &target, size_t capacity, class IDrawLib *metrics) : IDrawLib(),
+	target(target), metrics(metrics), ring(capacity), consumerWaiting(false), producerWaiting(false),
+	stopping(false), numAdded(0), numDrawn(0)
+{
+	this->consumer = thread(&DrawLibPipe::ConsumerMain, this);
+}
+
+DrawLibPipe::~DrawLibPipe()
+{
+	//Commands already added are still drawn
+	this->stopping = true;
+	this->WakeConsumer();
+	this->consumer.join();
+}
+
+// ************* Threads *************
+
+//Each side sets its waiting flag before checking the ring again under the
+//mutex, and the other side checks the flag after changing the ring, so a
+//wake up cannot be missed.
+
+void DrawLibPipe::WakeConsumer()
+{
+	if(this->consumerWaiting)
+	{
+		lock_guard<mutex> lock(this->waitMutex);
+		this->consumerCond.notify_one();
+	}
+}
+
+void DrawLibPipe::WakeProducer()
+{
+	if(this->producerWaiting)
+	{
+		lock_guard<mutex> lock(this->waitMutex);
+		this->producerCond.notify_one();
+	}
+}
+
+void DrawLibPipe::ConsumerMain()
+{
+	while(true)
+	{
+		class BaseCmd *cmd = NULL;
+		if(!this->ring.TryPop(cmd))
+		{
+			unique_lock<mutex> lock(this->waitMutex);
+			this->consumerWaiting = true;
+			while(this->ring.Empty() && !this->stopping)
+				this->consumerCond.wait(lock);
+			this->consumerWaiting = false;
+			if(this->ring.Empty())
+				return; //Stopping with nothing left to draw
+			continue;
+		}
+		this->WakeProducer(); //A slot is free
+
+		//After an error, later commands are dropped until it is reported
+		if(!this->drawError)
+		{
+			try
+			{
+				this->target.DrawSingleCmd(*cmd);
+			}
+			catch(...)
+			{
+				this->drawError = current_exception();
+			}
+		}
+		delete cmd;
+		this->numDrawn++;
+		this->WakeProducer();
+	}
+}
+
+void DrawLibPipe::Push(class BaseCmd *cmd)
+{
+	try
+	{
+		this->RethrowError();
+	}
+	catch(...)
+	{
+		delete cmd;
+		throw;
+	}
+	this->numAdded++;
+	while(!this->ring.TryPush(cmd))
+	{
+		unique_lock<mutex> lock(this->waitMutex);
+		this->producerWaiting = true;
+		while(this->ring.Full())
+			this->producerCond.wait(lock);
+		this->producerWaiting = false;
+	}
+	this->WakeConsumer();
+}
+
+void DrawLibPipe::RethrowError()
+{
+	if(this->numDrawn != this->numAdded)
+		return; //Only read the error once the consumer has finished with it
+	if(this->drawError)
+	{
+		exception_ptr err = this->drawError;
+		this->drawError = exception_ptr();
+		rethrow_exception(err);
+	}
+}
+
+void DrawLibPipe::Flush()
+{
+	{
+		unique_lock<mutex> lock(this->waitMutex);
+		this->producerWaiting = true;
+		while(this->numDrawn != this->numAdded)
+			this->producerCond.wait(lock);
+		this->producerWaiting = false;
+	}
+	this->RethrowError();
+}
+
+// ************* IDrawLib *************
+
+void DrawLibPipe::ClearDrawingCmds()
+{
+	//Commands are drawn as they are added, so there is nothing to clear
+}
+
+void DrawLibPipe::AddCmd(class BaseCmd *cmd)
+{
+	this->Push(cmd->Clone());
+}
+
+void DrawLibPipe::AddDrawPolygonsCmd(const std::vector<Polygon> &polygons, const class ShapeProperties &properties)
+{
+	this->Push(new class DrawPolygonsCmd(polygons, properties));
+}
+
+void DrawLibPipe::AddDrawLinesCmd(const Contours &lines, const class LineProperties &properties)
+{
+	this->Push(new class DrawLinesCmd(lines, properties));
+}
+
+void DrawLibPipe::AddDrawTextCmd(const std::vector<class TextLabel> &textStrs, const class TextProperties &properties)
+{
+	this->Push(new class DrawTextCmd(textStrs, properties));
+}
+
+void DrawLibPipe::AddDrawTwistedTextCmd(const std::vector<class TwistedTextLabel> &textStrs, const class TextProperties &properties)
+{
+	this->Push(new class DrawTwistedTextCmd(textStrs, properties));
+}
+
+void DrawLibPipe::AddLoadImageResourcesCmd(const std::map<std::string, std::string> &loadIdToFilenameMapping)
+{
+	this->Push(new class LoadImageResourcesCmd(loadIdToFilenameMapping));
+}
+
+void DrawLibPipe::AddUnloadImageResourcesCmd(const std::vector<std::string> &unloadIds)
+{
+	this->Push(new class UnloadImageResourcesCmd(unloadIds));
+}
+
+void DrawLibPipe::AddDrawPolygonInstancesCmd(const std::vector<Polygon> &polygons, const class ShapeProperties &properties,
+	const std::vector<double> &transforms, const std::vector<unsigned int> &colours)
+{
+	this->Push(new class DrawInstancesCmd(polygons, properties, transforms, colours));
+}
+
+void DrawLibPipe::AddDrawLineInstancesCmd(const Contours &lines, const class LineProperties &properties,
+	const std::vector<double> &transforms, const std::vector<unsigned int> &colours)
+{
+	this->Push(new class DrawInstancesCmd(lines, properties, transforms, colours));
+}
+
+int DrawLibPipe::GetTriangleBoundsText(const TextLabel &label, const class TextProperties &properties,
+	TwistedTriangles &trianglesOut)
+{
+	if(this->metrics != NULL)
+		return this->metrics->GetTriangleBoundsText(label, properties, trianglesOut);
+	this->Flush();
+	return this->target.GetTriangleBoundsText(label, properties, trianglesOut);
+}
+
+int DrawLibPipe::GetTriangleBoundsTwistedText(const TwistedTextLabel &label,
+	const class TextProperties &properties,
+	TwistedTriangles &trianglesOut, double &pathLenOut, double &textLenOut)
+{
+	if(this->metrics != NULL)
+		return this->metrics->GetTriangleBoundsTwistedText(label, properties, trianglesOut, pathLenOut, textLenOut);
+	this->Flush();
+	return this->target.GetTriangleBoundsTwistedText(label, properties, trianglesOut, pathLenOut, textLenOut);
+}
+
+int DrawLibPipe::GetResourceDimensionsFromFilename(const std::string &filename, unsigned &widthOut, unsigned &heightOut)
+{
+	//Only reads the file, so does not need the target to be idle
+	return this->target.GetResourceDimensionsFromFilename(filename, widthOut, heightOut);
+}
+
+int DrawLibPipe::GetDrawableExtents(double &x1,
+	double &y1,
+	double &x2,
+	double &y2)
+{
+	this->Flush();
+	return this->target.GetDrawableExtents(x1, y1, x2, y2);
+}
+
+void DrawLibPipe::Draw()
+{
+	this->Flush();
+}
@@ -0,0 +1,73 @@
+#ifndef _DRAW_LIB_PIPE_H
+#define _DRAW_LIB_PIPE_H
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include "drawlibcairo.h"
+#include "CmdRing.h"
+
+///Draw commands on a cairo drawing library from a second thread while they
+///are still being added, so decoding and rasterization overlap. Commands pass
+///through a bounded ring and are drawn in the order they were added. Adding
+///waits while the ring is full. Text measurement is delegated to another
+///drawing library if one is given, otherwise it waits for drawing to catch
+///up so the target is not used by two threads at once.
+class DrawLibPipe : public IDrawLib
+{
+protected:
+	class DrawLibCairo &target;
+	class IDrawLib *metrics;
+	class CmdRing ring;
+	std::thread consumer;
+	std::mutex waitMutex;
+	std::condition_variable consumerCond, producerCond;
+	std::atomic<bool> consumerWaiting, producerWaiting;
+	std::atomic<bool> stopping;
+	std::atomic<size_t> numAdded, numDrawn;
+	std::exception_ptr drawError;
+
+	void ConsumerMain();
+	void Push(class BaseCmd *cmd);
+	void WakeConsumer();
+	void WakeProducer();
+	void RethrowError();
+
+public:
+	DrawLibPipe(class DrawLibCairo &target, size_t capacity = 256, class IDrawLib *metrics = NULL);
+	virtual ~DrawLibPipe();
+
+	///Wait until every command added so far has been drawn. The first error
+	///thrown while drawing is rethrown here, and later commands are dropped
+	///until it has been.
+	void Flush();
+
+	void ClearDrawingCmds();
+	void AddCmd(class BaseCmd *cmd);
+	void AddDrawPolygonsCmd(const std::vector<Polygon> &polygons, const class ShapeProperties &properties);
+	void AddDrawLinesCmd(const Contours &lines, const class LineProperties &properties);
+	void AddDrawTextCmd(const std::vector<class TextLabel> &textStrs, const class TextProperties &properties);
+	void AddDrawTwistedTextCmd(const std::vector<class TwistedTextLabel> &textStrs, const class TextProperties &properties);
+	void AddLoadImageResourcesCmd(const std::map<std::string, std::string> &loadIdToFilenameMapping);
+	void AddUnloadImageResourcesCmd(const std::vector<std::string> &unloadIds);
+	void AddDrawPolygonInstancesCmd(const std::vector<Polygon> &polygons, const class ShapeProperties &properties,
+		const std::vector<double> &transforms, const std::vector<unsigned int> &colours);
+	void AddDrawLineInstancesCmd(const Contours &lines, const class LineProperties &properties,
+		const std::vector<double> &transforms, const std::vector<unsigned int> &colours);
+	int GetTriangleBoundsText(const TextLabel &label, const class TextProperties &properties,
+		TwistedTriangles &trianglesOut);
+	int GetTriangleBoundsTwistedText(const TwistedTextLabel &label,
+		const class TextProperties &properties,
+		TwistedTriangles &trianglesOut, double &pathLenOut, double &textLenOut);
+	int GetResourceDimensionsFromFilename(const std::string &filename, unsigned &widthOut, unsigned &heightOut);
+	int GetDrawableExtents(double &x1,
+		double &y1,
+		double &x2,
+		double &y2);
+	///Same as Flush, as commands are drawn as they are added
+	void Draw();
+};
+
+#endif //_DRAW_LIB_PIPE_H
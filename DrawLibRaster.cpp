@@ -0,0 +1,121 @@
+#include "DrawLibRaster.h"
+#include <cmath>
+#include <algorithm>
+using namespace std;
+
+DrawLibRaster::DrawLibRaster(cairo_surface_t *surface) : DrawLibCairoPango(surface),
+	pixels(NULL), stride(0), fillRule(RASTER_NONZERO)
+{
+
+}
+
+DrawLibRaster::~DrawLibRaster()
+{
+
+}
+
+///Prepare to write pixels directly, limited to the current clip
+///\return false if the surface cannot be drawn to directly
+bool DrawLibRaster::BeginRaster()
+{
+	if(cairo_surface_get_type(this->surface) != CAIRO_SURFACE_TYPE_IMAGE
+		|| cairo_image_surface_get_format(this->surface) != CAIRO_FORMAT_ARGB32)
+		return false;
+
+	cairo_surface_flush(this->surface);
+	this->pixels = cairo_image_surface_get_data(this->surface);
+	if(this->pixels == NULL)
+		return false;
+	this->stride = cairo_image_surface_get_stride(this->surface);
+
+	cairo_matrix_t mat;
+	cairo_get_matrix(this->cr, &mat);
+	this->userToDevice = AffineTransform(mat.xx, mat.yx, mat.xy, mat.yy, mat.x0, mat.y0);
+
+	double x1=0.0, y1=0.0, x2=0.0, y2=0.0;
+	cairo_identity_matrix(this->cr);
+	cairo_clip_extents(this->cr, &x1, &y1, &x2, &y2);
+	cairo_set_matrix(this->cr, &mat);
+	int width = cairo_image_surface_get_width(this->surface);
+	int height = cairo_image_surface_get_height(this->surface);
+	this->rasterizer.Reset(max(0, (int)floor(x1)), max(0, (int)floor(y1)),
+		min(width, (int)ceil(x2)), min(height, (int)ceil(y2)));
+	return true;
+}
+
+void DrawLibRaster::EndRaster()
+{
+	cairo_surface_mark_dirty(this->surface);
+	this->pixels = NULL;
+}
+
+void DrawLibRaster::AddRing(const Contour &ring, int orientation)
+{
+	this->cmdVertices += ring.size();
+	if(ring.size() < 3)
+		return;
+	this->devicePts.assign(ring.begin(), ring.end());
+	TransformPoints(this->userToDevice, &this->devicePts[0], this->devicePts.size());
+	this->rasterizer.AddRing(&this->devicePts[0], this->devicePts.size(), orientation);
+}
+
+void DrawLibRaster::DrawCmdPolygons(class DrawPolygonsCmd &polygonsCmd)
+{
+	const class ShapeProperties &properties = polygonsCmd.properties;
+	if(properties.imageId.size() > 0 || !this->BeginRaster())
+	{
+		DrawLibCairo::DrawCmdPolygons(polygonsCmd);
+		return;
+	}
+
+	//Each polygon is blended separately, as cairo does
+	bool nonZero = this->fillRule == RASTER_NONZERO;
+	const std::vector<Polygon> &polygons = polygonsCmd.GetPolygons(this->detailLevel);
+	for(size_t i=0;i < polygons.size();i++)
+	{
+		const Polygon &polygon = polygons[i];
+		this->AddRing(polygon.first, nonZero ? 1 : 0);
+		for(size_t j=0; j < polygon.second.size(); j++)
+			this->AddRing(polygon.second[j], nonZero ? -1 : 0);
+		this->rasterizer.Fill(this->pixels, this->stride,
+			properties.r, properties.g, properties.b, properties.a, this->fillRule);
+	}
+	this->EndRaster();
+}
+
+void DrawLibRaster::DrawCmdLines(class DrawLinesCmd &linesCmd)
+{
+	if(!this->BeginRaster())
+	{
+		DrawLibCairo::DrawCmdLines(linesCmd);
+		return;
+	}
+
+	const class LineProperties &properties = linesCmd.properties;
+	RasterLineJoin join = RASTER_JOIN_MITER;
+	RasterLineCap cap = RASTER_CAP_BUTT;
+	LineStyleFromProperties(properties, join, cap);
+	double miterLimit = cairo_get_miter_limit(this->cr);
+
+	//Strokes are outlined in user space so the width follows the transform
+	const Contours &lines = linesCmd.GetLines(this->detailLevel);
+	for(size_t i=0;i < lines.size();i++)
+	{
+		const Contour &contour = lines[i];
+		this->cmdVertices += contour.size();
+		StrokeToRings(contour, properties.lineWidth, properties.closedLoop, join, cap,
+			miterLimit, 0.1 * this->pixelSize, this->strokeRings);
+		if(this->strokeRings.size() == 0)
+			continue;
+		for(size_t j=0; j < this->strokeRings.size(); j++)
+		{
+			const Contour &ring = this->strokeRings[j];
+			this->devicePts.assign(ring.begin(), ring.end());
+			TransformPoints(this->userToDevice, &this->devicePts[0], this->devicePts.size());
+			this->rasterizer.AddRing(&this->devicePts[0], this->devicePts.size(), 1);
+		}
+		this->rasterizer.Fill(this->pixels, this->stride,
+			properties.r, properties.g, properties.b, properties.a, RASTER_NONZERO);
+	}
+	this->EndRaster();
+}
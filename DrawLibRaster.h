@@ -0,0 +1,33 @@
+#ifndef _DRAW_LIB_RASTER_H
+#define _DRAW_LIB_RASTER_H
+
+#include "drawlibcairo.h"
+#include "ScanlineRaster.h"
+
+///Drawing of polygons and lines by a software scanline rasterizer straight
+///into the pixels of an ARGB32 image surface. Text is drawn by Pango as usual.
+///Textured polygons, and surfaces that are not ARGB32 images, fall back to cairo.
+class DrawLibRaster : public DrawLibCairoPango
+{
+protected:
+	class ScanlineRasterizer rasterizer;
+	unsigned char *pixels;
+	int stride;
+	class AffineTransform userToDevice;
+	Contour devicePts; //Working space for transformed rings
+	Contours strokeRings;
+
+	virtual void DrawCmdPolygons(class DrawPolygonsCmd &polygons);
+	virtual void DrawCmdLines(class DrawLinesCmd &linesCmd);
+
+	bool BeginRaster();
+	void EndRaster();
+	void AddRing(const Contour &ring, int orientation);
+public:
+	RasterFillRule fillRule; //Rule used to fill polygons, holes are cut either way
+
+	DrawLibRaster(cairo_surface_t *surface);
+	virtual ~DrawLibRaster();
+};
+
+#endif //_DRAW_LIB_RASTER_H
@@ -0,0 +1,718 @@
+//Streaming SVG output
+//https://www.w3.org/TR/SVG11/
+
+#include "DrawLibSvg.h"
+#include <stdio.h>
+#include <string.h>
+#include <cmath>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <assert.h>
+using namespace std;
+
+DrawLibSvg::DrawLibSvg(std::ostream &out, double width, double height, class IDrawLib *metrics) : IDrawLib(),
+	out(out), metrics(metrics), numPaths(0), finished(false), precision(2), width(width), height(height)
+{
+	this->buff = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+		"<svg xmlns=\"http://www.w3.org/2000/svg\" xmlns:xlink=\"http://www.w3.org/1999/xlink\" width=\"";
+	this->AppendNumber(width);
+	this->buff += "\" height=\"";
+	this->AppendNumber(height);
+	this->buff += "\" viewBox=\"0 0 ";
+	this->AppendNumber(width);
+	this->buff += " ";
+	this->AppendNumber(height);
+	this->buff += "\">\n";
+	this->out << this->buff;
+}
+
+DrawLibSvg::~DrawLibSvg()
+{
+	this->Finish();
+}
+
+void DrawLibSvg::Finish()
+{
+	if(this->finished)
+		return;
+	this->out << "</svg>\n";
+	this->out.flush();
+	this->finished = true;
+}
+
+// ************* Formatting *************
+
+void DrawLibSvg::AppendNumber(double val)
+{
+	char tmp[64];
+	int len = snprintf(tmp, sizeof(tmp), "%.*f", max(0, min(this->precision, 17)), val);
+	if(len <= 0 || len >= (int)sizeof(tmp))
+		return;
+
+	//Trim trailing zeros and a negative zero
+	if(memchr(tmp, '.', len) != NULL)
+	{
+		while(len > 0 && tmp[len-1] == '0')
+			len--;
+		if(len > 0 && tmp[len-1] == '.')
+			len--;
+	}
+	if(len == 2 && tmp[0] == '-' && tmp[1] == '0')
+	{
+		tmp[0] = '0';
+		len = 1;
+	}
+	this->buff.append(tmp, len);
+}
+
+void DrawLibSvg::AppendPoint(const Point &pt)
+{
+	this->AppendNumber(pt.first);
+	this->buff += ' ';
+	this->AppendNumber(pt.second);
+}
+
+void DrawLibSvg::AppendColour(double r, double g, double b)
+{
+	char tmp[8];
+	snprintf(tmp, sizeof(tmp), "#%02x%02x%02x",
+		(int)round(255.0 * max(0.0, min(1.0, r))),
+		(int)round(255.0 * max(0.0, min(1.0, g))),
+		(int)round(255.0 * max(0.0, min(1.0, b))));
+	this->buff += tmp;
+}
+
+static void EscapeXml(const std::string &text, std::string &out)
+{
+	for(size_t i = 0; i < text.size(); i++)
+	{
+		switch(text[i])
+		{
+		case '&': out += "&amp;"; break;
+		case '<': out += "&lt;"; break;
+		case '>': out += "&gt;"; break;
+		case '"': out += "&quot;"; break;
+		case '\'': out += "&apos;"; break;
+		default: out += text[i];
+		}
+	}
+}
+
+void DrawLibSvg::AppendEscaped(const std::string &text)
+{
+	EscapeXml(text, this->buff);
+}
+
+///Find the CSS class with these declarations, writing its definition the
+///first time it is used
+void DrawLibSvg::StyleClass(const std::string &declarations, std::string &classOut)
+{
+	std::map<std::string, unsigned>::iterator it = this->styleClasses.find(declarations);
+	unsigned num = 0;
+	if(it != this->styleClasses.end())
+		num = it->second;
+	else
+	{
+		num = this->styleClasses.size();
+		this->styleClasses[declarations] = num;
+		this->out << "<style>.s" << num << "{" << declarations << "}</style>\n";
+	}
+	stringstream ss;
+	ss << "s" << num;
+	classOut = ss.str();
+}
+
+///Fill paint of a textured shape, writing the pattern the first time it is used.
+///Missing textures are red, as in the cairo back end.
+std::string DrawLibSvg::TextureFill(const class ShapeProperties &properties)
+{
+	std::map<std::string, std::string>::iterator fit = this->imageFilenames.find(properties.imageId);
+	if(fit == this->imageFilenames.end())
+		return "#ff0000";
+
+	//Keyed by filename, so an id loaded again with another image gets a new pattern.
+	//Image dimensions are only needed to write the pattern the first time.
+	stringstream key;
+	key << fit->second << "\n" << properties.texx << "," << properties.texy;
+	std::map<std::string, unsigned>::iterator it = this->patterns.find(key.str());
+	unsigned num = 0;
+	if(it != this->patterns.end())
+		num = it->second;
+	else
+	{
+		unsigned imgWidth = 0, imgHeight = 0;
+		if(this->GetResourceDimensionsFromFilename(fit->second, imgWidth, imgHeight) != 0)
+			return "#ff0000";
+		num = this->patterns.size();
+		this->patterns[key.str()] = num;
+		//Not in buff, which holds the style this fill is part of
+		std::string href;
+		EscapeXml(fit->second, href);
+		this->out << "<defs><pattern id=\"tex" << num << "\" patternUnits=\"userSpaceOnUse\" width=\""
+			<< imgWidth << "\" height=\"" << imgHeight << "\"";
+		if(properties.texx != 0.0 || properties.texy != 0.0)
+			this->out << " patternTransform=\"translate(" << properties.texx << " " << properties.texy << ")\"";
+		this->out << "><image xlink:href=\"" << href << "\" width=\"" << imgWidth
+			<< "\" height=\"" << imgHeight << "\"/></pattern></defs>\n";
+	}
+	stringstream ss;
+	ss << "url(#tex" << num << ")";
+	return ss.str();
+}
+
+void DrawLibSvg::AppendTextStyle(const class TextProperties &properties, std::string &style)
+{
+	this->buff.clear();
+	this->buff += "font-family:'";
+	this->AppendEscaped(properties.font);
+	this->buff += "';font-size:";
+	this->AppendNumber(properties.fontSize);
+	this->buff += "pt;fill:";
+	if(properties.fill)
+	{
+		this->AppendColour(properties.fr, properties.fg, properties.fb);
+		this->buff += ";fill-opacity:";
+		this->AppendNumber(properties.fa);
+	}
+	else
+		this->buff += "none";
+	if(properties.outline)
+	{
+		this->buff += ";stroke:";
+		this->AppendColour(properties.lr, properties.lg, properties.lb);
+		this->buff += ";stroke-opacity:";
+		this->AppendNumber(properties.la);
+		this->buff += ";stroke-width:";
+		this->AppendNumber(properties.lineWidth);
+		this->buff += ";paint-order:stroke"; //Fill is drawn over the outline
+	}
+	if(properties.halign > 0.75f)
+		this->buff += ";text-anchor:end";
+	else if(properties.halign > 0.25f)
+		this->buff += ";text-anchor:middle";
+	style = this->buff;
+}
+
+// ************* Commands *************
+
+void DrawLibSvg::PolygonStyleClass(const class ShapeProperties &properties, std::string &classOut)
+{
+	this->buff.clear();
+	this->buff += "fill:";
+	if(properties.imageId.size() > 0)
+		this->buff += this->TextureFill(properties);
+	else
+		this->AppendColour(properties.r, properties.g, properties.b);
+	this->buff += ";fill-opacity:";
+	this->AppendNumber(properties.a);
+	this->buff += ";fill-rule:evenodd"; //Inner rings are holes
+	this->StyleClass(this->buff, classOut);
+}
+
+void DrawLibSvg::LineStyleClass(const class LineProperties &properties, std::string &classOut)
+{
+	this->buff.clear();
+	this->buff += "fill:none;stroke:";
+	this->AppendColour(properties.r, properties.g, properties.b);
+	this->buff += ";stroke-opacity:";
+	this->AppendNumber(properties.a);
+	this->buff += ";stroke-width:";
+	this->AppendNumber(properties.lineWidth);
+	if(properties.lineCap == "sqaure" || properties.lineCap == "square")
+		this->buff += ";stroke-linecap:square";
+	if(properties.lineCap == "round")
+		this->buff += ";stroke-linecap:round";
+	if(properties.lineJoin == "round")
+		this->buff += ";stroke-linejoin:round";
+	if(properties.lineJoin == "bevel")
+		this->buff += ";stroke-linejoin:bevel";
+	this->buff += ";stroke-miterlimit:10"; //cairo default
+	this->StyleClass(this->buff, classOut);
+}
+
+void DrawLibSvg::AppendPolygonPath(const Polygon &polygon)
+{
+	for(size_t j = 0; j <= polygon.second.size(); j++)
+	{
+		const Contour &ring = j == 0 ? polygon.first : polygon.second[j-1];
+		for(size_t k = 0; k < ring.size(); k++)
+		{
+			this->buff += k == 0 ? 'M' : ' ';
+			this->AppendPoint(ring[k]);
+		}
+		if(ring.size() > 0)
+			this->buff += 'Z';
+	}
+}
+
+void DrawLibSvg::AppendLinePath(const Contour &line, bool closedLoop)
+{
+	for(size_t k = 0; k < line.size(); k++)
+	{
+		this->buff += k == 0 ? 'M' : ' ';
+		this->AppendPoint(line[k]);
+	}
+	if(closedLoop)
+		this->buff += 'Z';
+}
+
+void DrawLibSvg::WritePolygons(const std::vector<Polygon> &polygons, const class ShapeProperties &properties)
+{
+	std::string className;
+	this->PolygonStyleClass(properties, className);
+
+	//Each polygon is a separate path, as they are filled separately by cairo
+	for(size_t i = 0; i < polygons.size(); i++)
+	{
+		const Polygon &polygon = polygons[i];
+		if(polygon.first.size() == 0)
+			continue;
+		this->buff.clear();
+		this->buff += "<path class=\"";
+		this->buff += className;
+		this->buff += "\" d=\"";
+		this->AppendPolygonPath(polygon);
+		this->buff += "\"/>\n";
+		this->out << this->buff;
+	}
+}
+
+void DrawLibSvg::WriteLines(const Contours &lines, const class LineProperties &properties)
+{
+	std::string className;
+	this->LineStyleClass(properties, className);
+
+	for(size_t i = 0; i < lines.size(); i++)
+	{
+		const Contour &line = lines[i];
+		if(line.size() == 0)
+			continue;
+		this->buff.clear();
+		this->buff += "<path class=\"";
+		this->buff += className;
+		this->buff += "\" d=\"";
+		this->AppendLinePath(line, properties.closedLoop);
+		this->buff += "\"/>\n";
+		this->out << this->buff;
+	}
+}
+
+void DrawLibSvg::WriteText(const std::vector<class TextLabel> &textStrs, const class TextProperties &properties)
+{
+	std::string style, className;
+	this->AppendTextStyle(properties, style);
+	if(properties.valign > 0.75f)
+		style += ";dominant-baseline:text-after-edge";
+	else if(properties.valign > 0.25f)
+		style += ";dominant-baseline:central";
+	else
+		style += ";dominant-baseline:text-before-edge"; //Position is the top of the text
+	this->StyleClass(style, className);
+
+	for(size_t i = 0; i < textStrs.size(); i++)
+	{
+		const class TextLabel &label = textStrs[i];
+		this->buff.clear();
+		this->buff += "<text class=\"";
+		this->buff += className;
+		this->buff += "\" transform=\"translate(";
+		this->AppendNumber(label.x);
+		this->buff += ' ';
+		this->AppendNumber(label.y);
+		this->buff += ')';
+		if(label.ang != 0.0)
+		{
+			this->buff += " rotate(";
+			this->AppendNumber(label.ang * 180.0 / M_PI);
+			this->buff += ')';
+		}
+		this->buff += "\">";
+		this->AppendEscaped(label.text);
+		this->buff += "</text>\n";
+		this->out << this->buff;
+	}
+}
+
+void DrawLibSvg::WriteTwistedText(const std::vector<class TwistedTextLabel> &textStrs, const class TextProperties &properties)
+{
+	std::string style, className;
+	this->AppendTextStyle(properties, style);
+	this->StyleClass(style, className);
+
+	static const char verbChars[] = {'M', 'L', 'l', 'C', 'c'};
+	for(size_t i = 0; i < textStrs.size(); i++)
+	{
+		const class TwistedTextLabel &label = textStrs[i];
+		const class TwistedPath &path = label.path;
+		unsigned pathNum = this->numPaths++;
+
+		this->buff.clear();
+		this->buff += "<defs><path id=\"tp";
+		char tmp[32];
+		snprintf(tmp, sizeof(tmp), "%u", pathNum);
+		this->buff += tmp;
+		this->buff += "\" d=\"";
+		const double *c = path.coords.size() > 0 ? &path.coords[0] : NULL;
+		for(size_t j = 0; j < path.verbs.size(); j++)
+		{
+			TwistedCurveCmdType ty = path.verbs[j];
+			this->buff += verbChars[ty];
+			int arity = TwistedCurveCmdArity(ty);
+			for(int k = 0; k < arity; k++)
+			{
+				if(k > 0)
+					this->buff += ' ';
+				this->AppendNumber(c[k]);
+			}
+			c += arity;
+		}
+		this->buff += "\"/></defs><text class=\"";
+		this->buff += className;
+		this->buff += "\"><textPath xlink:href=\"#tp";
+		this->buff += tmp;
+		this->buff += '"';
+		if(properties.halign > 0.25f)
+		{
+			this->buff += " startOffset=\"";
+			this->AppendNumber(properties.halign > 0.75f ? 100.0 : 50.0);
+			this->buff += "%\"";
+		}
+		this->buff += '>';
+		this->AppendEscaped(label.text);
+		this->buff += "</textPath></text>\n";
+		this->out << this->buff;
+	}
+}
+
+///Write the prototype once in the defs, then a use element for each instance.
+///The style is on the use elements so per instance colours can override it.
+void DrawLibSvg::WriteInstances(const class DrawInstancesCmd &instancesCmd)
+{
+	size_t numInstances = instancesCmd.NumInstances();
+	bool filled = instancesCmd.polygons.size() > 0;
+	if(numInstances == 0 || (!filled && instancesCmd.lines.size() == 0))
+		return;
+
+	std::string className;
+	if(filled)
+		this->PolygonStyleClass(instancesCmd.shapeProperties, className);
+	else
+		this->LineStyleClass(instancesCmd.lineProperties, className);
+
+	char id[32];
+	snprintf(id, sizeof(id), "inst%u", this->numPaths++);
+	this->buff.clear();
+	this->buff += "<defs><path id=\"";
+	this->buff += id;
+	this->buff += "\" d=\"";
+	if(filled)
+	{
+		for(size_t i = 0; i < instancesCmd.polygons.size(); i++)
+			this->AppendPolygonPath(instancesCmd.polygons[i]);
+	}
+	else
+	{
+		for(size_t i = 0; i < instancesCmd.lines.size(); i++)
+			this->AppendLinePath(instancesCmd.lines[i], instancesCmd.lineProperties.closedLoop);
+	}
+	this->buff += "\"/></defs>\n";
+	this->out << this->buff;
+
+	bool perInstanceColour = instancesCmd.colours.size() > 0;
+	for(size_t i = 0; i < numInstances; i++)
+	{
+		const double *t = &instancesCmd.transforms[i * 6];
+		this->buff.clear();
+		this->buff += "<use xlink:href=\"#";
+		this->buff += id;
+		this->buff += "\" class=\"";
+		this->buff += className;
+		this->buff += "\" transform=\"matrix(";
+		for(int k = 0; k < 6; k++)
+		{
+			if(k > 0)
+				this->buff += ' ';
+			this->AppendNumber(t[k]);
+		}
+		this->buff += ")\"";
+		if(perInstanceColour)
+		{
+			double r = 0.0, g = 0.0, b = 0.0, a = 0.0;
+			instancesCmd.GetColour(i, r, g, b, a);
+			this->buff += filled ? " style=\"fill:" : " style=\"stroke:";
+			this->AppendColour(r, g, b);
+			this->buff += filled ? ";fill-opacity:" : ";stroke-opacity:";
+			this->AppendNumber(a);
+			this->buff += '"';
+		}
+		this->buff += "/>\n";
+		this->out << this->buff;
+	}
+}
+
+void DrawLibSvg::WriteLoadResources(const std::map<std::string, std::string> &loadIdToFilenameMapping)
+{
+	for(std::map<std::string, std::string>::const_iterator it = loadIdToFilenameMapping.begin();
+		it != loadIdToFilenameMapping.end();
+		it++)
+		this->imageFilenames[it->first] = it->second;
+}
+
+void DrawLibSvg::WriteUnloadResources(const std::vector<std::string> &unloadIds)
+{
+	for(size_t i = 0; i < unloadIds.size(); i++)
+		this->imageFilenames.erase(unloadIds[i]);
+}
+
+// ************* IDrawLib *************
+
+void DrawLibSvg::ClearDrawingCmds()
+{
+	//Commands are written as they are added, so there is nothing to clear
+}
+
+void DrawLibSvg::AddCmd(class BaseCmd *cmd)
+{
+	if(this->finished)
+		return;
+	switch(cmd->type)
+	{
+	case CMD_POLYGONS:
+		{
+			class DrawPolygonsCmd *polygonsCmd = (class DrawPolygonsCmd *)cmd;
+			if(polygonsCmd->IsQuantized())
+			{
+				std::vector<Polygon> expanded;
+				polygonsCmd->quantized.Dequantize(expanded);
+				this->WritePolygons(expanded, polygonsCmd->properties);
+			}
+			else
+				this->WritePolygons(polygonsCmd->polygons, polygonsCmd->properties);
+			break;
+		}
+	case CMD_LINES:
+		{
+			class DrawLinesCmd *linesCmd = (class DrawLinesCmd *)cmd;
+			if(linesCmd->IsQuantized())
+			{
+				Contours expanded;
+				linesCmd->quantized.Dequantize(expanded);
+				this->WriteLines(expanded, linesCmd->properties);
+			}
+			else
+				this->WriteLines(linesCmd->lines, linesCmd->properties);
+			break;
+		}
+	case CMD_TEXT:
+		this->WriteText(((class DrawTextCmd *)cmd)->textStrs, ((class DrawTextCmd *)cmd)->properties);
+		break;
+	case CMD_TWISTED_TEXT:
+		this->WriteTwistedText(((class DrawTwistedTextCmd *)cmd)->textStrs, ((class DrawTwistedTextCmd *)cmd)->properties);
+		break;
+	case CMD_LOAD_RESOURCES:
+		this->WriteLoadResources(((class LoadImageResourcesCmd *)cmd)->loadIdToFilenameMapping);
+		break;
+	case CMD_UNLOAD_RESOURCES:
+		this->WriteUnloadResources(((class UnloadImageResourcesCmd *)cmd)->unloadIds);
+		break;
+	case CMD_INSTANCES:
+		this->WriteInstances(*(class DrawInstancesCmd *)cmd);
+		break;
+	default:
+		break;
+	}
+}
+
+void DrawLibSvg::AddDrawPolygonsCmd(const std::vector<Polygon> &polygons, const class ShapeProperties &properties)
+{
+	if(!this->finished)
+		this->WritePolygons(polygons, properties);
+}
+
+void DrawLibSvg::AddDrawLinesCmd(const Contours &lines, const class LineProperties &properties)
+{
+	if(!this->finished)
+		this->WriteLines(lines, properties);
+}
+
+void DrawLibSvg::AddDrawTextCmd(const std::vector<class TextLabel> &textStrs, const class TextProperties &properties)
+{
+	if(!this->finished)
+		this->WriteText(textStrs, properties);
+}
+
+void DrawLibSvg::AddDrawTwistedTextCmd(const std::vector<class TwistedTextLabel> &textStrs, const class TextProperties &properties)
+{
+	if(!this->finished)
+		this->WriteTwistedText(textStrs, properties);
+}
+
+void DrawLibSvg::AddLoadImageResourcesCmd(const std::map<std::string, std::string> &loadIdToFilenameMapping)
+{
+	this->WriteLoadResources(loadIdToFilenameMapping);
+}
+
+void DrawLibSvg::AddUnloadImageResourcesCmd(const std::vector<std::string> &unloadIds)
+{
+	this->WriteUnloadResources(unloadIds);
+}
+
+void DrawLibSvg::AddDrawPolygonInstancesCmd(const std::vector<Polygon> &polygons, const class ShapeProperties &properties,
+	const std::vector<double> &transforms, const std::vector<unsigned int> &colours)
+{
+	class DrawInstancesCmd cmd(polygons, properties, transforms, colours);
+	this->AddCmd(&cmd);
+}
+
+void DrawLibSvg::AddDrawLineInstancesCmd(const Contours &lines, const class LineProperties &properties,
+	const std::vector<double> &transforms, const std::vector<unsigned int> &colours)
+{
+	class DrawInstancesCmd cmd(lines, properties, transforms, colours);
+	this->AddCmd(&cmd);
+}
+
+int DrawLibSvg::GetTriangleBoundsText(const TextLabel &label, const class TextProperties &properties, 
+	TwistedTriangles &trianglesOut)
+{
+	if(this->metrics != NULL)
+		return this->metrics->GetTriangleBoundsText(label, properties, trianglesOut);
+	trianglesOut.clear();
+	return -1;
+}
+
+int DrawLibSvg::GetTriangleBoundsTwistedText(const TwistedTextLabel &label, 
+	const class TextProperties &properties, 
+	TwistedTriangles &trianglesOut, double &pathLenOut, double &textLenOut)
+{
+	if(this->metrics != NULL)
+		return this->metrics->GetTriangleBoundsTwistedText(label, properties, trianglesOut, pathLenOut, textLenOut);
+	trianglesOut.clear();
+	pathLenOut = 0.0;
+	textLenOut = 0.0;
+	return -1;
+}
+
+int DrawLibSvg::GetResourceDimensionsFromFilename(const std::string &filename, unsigned &widthOut, unsigned &heightOut)
+{
+	if(this->metrics != NULL)
+		return this->metrics->GetResourceDimensionsFromFilename(filename, widthOut, heightOut);
+	return -1;
+}
+
+int DrawLibSvg::GetDrawableExtents(double &x1,
+	double &y1,
+	double &x2,
+	double &y2)
+{
+	x1 = 0.0;
+	y1 = 0.0;
+	x2 = this->width;
+	y2 = this->height;
+	return 0;
+}
+
+void DrawLibSvg::Draw()
+{
+	this->out.flush();
+}
+
+// *************************************
+
+///Reports a fixed image size, as a drawing library that loads images would
+class DrawLibSvgTestImages : public DrawLibSvg
+{
+public:
+	int numDimensionQueries;
+
+	DrawLibSvgTestImages(std::ostream &out) : DrawLibSvg(out, 100.0, 50.0), numDimensionQueries(0) {}
+
+	int GetResourceDimensionsFromFilename(const std::string &filename, unsigned &widthOut, unsigned &heightOut)
+	{
+		this->numDimensionQueries ++;
+		widthOut = 16;
+		heightOut = 8;
+		return 0;
+	}
+};
+
+static void DrawLibSvgTextureTests()
+{
+	stringstream ss;
+	{
+		class DrawLibSvgTestImages svg(ss);
+		svg.precision = 1;
+
+		std::map<std::string, std::string> images;
+		images["tex"] = "a&b.png";
+		svg.AddLoadImageResourcesCmd(images);
+
+		std::vector<Polygon> polygons;
+		Contour outer;
+		outer.push_back(Point(0.0, 0.0));
+		outer.push_back(Point(10.0, 0.0));
+		outer.push_back(Point(10.0, 10.0));
+		polygons.push_back(Polygon(outer, Contours()));
+		class ShapeProperties textured;
+		textured.imageId = "tex";
+		svg.AddDrawPolygonsCmd(polygons, textured);
+		svg.AddDrawPolygonsCmd(polygons, textured);
+
+		//Image size is asked for only when the pattern is written
+		assert(svg.numDimensionQueries == 1);
+	}
+	string result = ss.str();
+	cout << result;
+
+	//The pattern and style are written once, and the filename stays out of the style
+	assert(result.find("<image xlink:href=\"a&amp;b.png\" width=\"16\" height=\"8\"/>") != string::npos);
+	assert(result.find("<style>.s0{fill:url(#tex0);fill-opacity:1;fill-rule:evenodd}</style>") != string::npos);
+	assert(result.find("tex1") == string::npos);
+	assert(result.find(".s1") == string::npos);
+	assert(result.find("<path class=\"s0\"") != result.rfind("<path class=\"s0\""));
+}
+
+void DrawLibSvgTests()
+{
+	stringstream ss;
+	{
+		class DrawLibSvg svg(ss, 100.0, 50.0);
+		svg.precision = 1;
+
+		std::vector<Polygon> polygons;
+		Contour outer;
+		outer.push_back(Point(0.0, 0.0));
+		outer.push_back(Point(10.25, 0.0));
+		outer.push_back(Point(10.25, -10.0));
+		polygons.push_back(Polygon(outer, Contours()));
+		svg.AddDrawPolygonsCmd(polygons, ShapeProperties(1.0, 0.0, 0.0));
+		svg.AddDrawPolygonsCmd(polygons, ShapeProperties(1.0, 0.0, 0.0));
+
+		std::vector<class TextLabel> labels;
+		labels.push_back(TextLabel("a<b", 1.0, 2.0));
+		svg.AddDrawTextCmd(labels, TextProperties());
+
+		//Two copies of the polygon, the second blue
+		double transforms[] = {1.0, 0.0, 0.0, 1.0, 5.0, 5.0, 2.0, 0.0, 0.0, 2.0, 20.0, 0.0};
+		std::vector<unsigned int> colours;
+		colours.push_back(PackColour(1.0, 0.0, 0.0));
+		colours.push_back(PackColour(0.0, 0.0, 1.0, 0.5));
+		svg.AddDrawPolygonInstancesCmd(polygons, ShapeProperties(1.0, 0.0, 0.0),
+			std::vector<double>(transforms, transforms + 12), colours);
+	}
+	string result = ss.str();
+	cout << result;
+
+	//Style is written once and shared
+	assert(result.find("<style>.s0{fill:#ff0000;") != string::npos);
+	assert(result.find(".s1{font-family") != string::npos);
+	assert(result.find(".s2") == string::npos);
+	assert(result.find("<path class=\"s0\" d=\"M0 0 10.2 0 10.2 -10Z\"/>") != string::npos);
+	assert(result.find(">a&lt;b</text>") != string::npos);
+	assert(result.find("<defs><path id=\"inst0\" d=\"M0 0 10.2 0 10.2 -10Z\"/></defs>") != string::npos);
+	assert(result.find("<use xlink:href=\"#inst0\" class=\"s0\" transform=\"matrix(2 0 0 2 20 0)\" "
+		"style=\"fill:#0000ff;fill-opacity:0.5\"/>") != string::npos);
+	assert(result.substr(result.size() - 7) == "</svg>\n");
+
+	DrawLibSvgTextureTests();
+}
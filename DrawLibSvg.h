@@ -0,0 +1,79 @@
+#ifndef _DRAW_LIB_SVG_H
+#define _DRAW_LIB_SVG_H
+
+#include <ostream>
+#include "drawlib.h"
+
+///Write drawing commands to an SVG stream as soon as they are added, so
+///memory use does not grow with the size of the drawing. Each distinct style
+///is written once as a CSS class. Text measurement and image sizes are
+///delegated to another drawing library if one is given.
+class DrawLibSvg : public IDrawLib
+{
+protected:
+	std::ostream &out;
+	class IDrawLib *metrics;
+	std::map<std::string, unsigned> styleClasses; //CSS declarations to class number
+	std::map<std::string, std::string> imageFilenames;
+	std::map<std::string, unsigned> patterns; //Image filename and offset to pattern number
+	std::string buff; //Working space for the element being written
+	unsigned numPaths;
+	bool finished;
+
+	void StyleClass(const std::string &declarations, std::string &classOut);
+	std::string TextureFill(const class ShapeProperties &properties);
+	void AppendNumber(double val);
+	void AppendPoint(const Point &pt);
+	void AppendColour(double r, double g, double b);
+	void AppendEscaped(const std::string &text);
+	void AppendTextStyle(const class TextProperties &properties, std::string &style);
+	void PolygonStyleClass(const class ShapeProperties &properties, std::string &classOut);
+	void LineStyleClass(const class LineProperties &properties, std::string &classOut);
+	void AppendPolygonPath(const Polygon &polygon);
+	void AppendLinePath(const Contour &line, bool closedLoop);
+
+	void WritePolygons(const std::vector<Polygon> &polygons, const class ShapeProperties &properties);
+	void WriteLines(const Contours &lines, const class LineProperties &properties);
+	void WriteText(const std::vector<class TextLabel> &textStrs, const class TextProperties &properties);
+	void WriteTwistedText(const std::vector<class TwistedTextLabel> &textStrs, const class TextProperties &properties);
+	void WriteInstances(const class DrawInstancesCmd &instancesCmd);
+	void WriteLoadResources(const std::map<std::string, std::string> &loadIdToFilenameMapping);
+	void WriteUnloadResources(const std::vector<std::string> &unloadIds);
+public:
+	int precision; //Decimal places of coordinates
+	double width, height;
+
+	DrawLibSvg(std::ostream &out, double width, double height, class IDrawLib *metrics = NULL);
+	virtual ~DrawLibSvg();
+
+	///Close the SVG document. Commands added after this are ignored.
+	void Finish();
+
+	void ClearDrawingCmds();
+	void AddCmd(class BaseCmd *cmd);
+	void AddDrawPolygonsCmd(const std::vector<Polygon> &polygons, const class ShapeProperties &properties);
+	void AddDrawLinesCmd(const Contours &lines, const class LineProperties &properties);
+	void AddDrawTextCmd(const std::vector<class TextLabel> &textStrs, const class TextProperties &properties);
+	void AddDrawTwistedTextCmd(const std::vector<class TwistedTextLabel> &textStrs, const class TextProperties &properties);
+	void AddLoadImageResourcesCmd(const std::map<std::string, std::string> &loadIdToFilenameMapping);
+	void AddUnloadImageResourcesCmd(const std::vector<std::string> &unloadIds);
+	void AddDrawPolygonInstancesCmd(const std::vector<Polygon> &polygons, const class ShapeProperties &properties,
+		const std::vector<double> &transforms, const std::vector<unsigned int> &colours);
+	void AddDrawLineInstancesCmd(const Contours &lines, const class LineProperties &properties,
+		const std::vector<double> &transforms, const std::vector<unsigned int> &colours);
+	int GetTriangleBoundsText(const TextLabel &label, const class TextProperties &properties, 
+		TwistedTriangles &trianglesOut);
+	int GetTriangleBoundsTwistedText(const TwistedTextLabel &label, 
+		const class TextProperties &properties, 
+		TwistedTriangles &trianglesOut, double &pathLenOut, double &textLenOut);
+	int GetResourceDimensionsFromFilename(const std::string &filename, unsigned &widthOut, unsigned &heightOut);
+	int GetDrawableExtents(double &x1,
+		double &y1,
+		double &x2,
+		double &y2);
+	void Draw();
+};
+
+void DrawLibSvgTests();
+
+#endif //_DRAW_LIB_SVG_H
@@ -0,0 +1,490 @@
+//Tile binning renderer, drawing tiles of the surface in parallel
+
+#include "DrawLibTiled.h"
+#include <cmath>
+#include <algorithm>
+using namespace std;
+
+DrawLibTiled::DrawLibTiled(cairo_surface_t *surface, class WorkStealingPool *pool) : DrawLibCairoPango(surface),
+	pool(pool), ownPool(false), parent(NULL), tilesX(0), tilesY(0),
+	canvasX1(0.0), canvasY1(0.0), canvasX2(0.0), canvasY2(0.0), tileSize(256)
+{
+	cairo_matrix_init_identity(&this->drawMatrix);
+}
+
+DrawLibTiled::DrawLibTiled(cairo_surface_t *surface, const class DrawLibTiled *parent) : DrawLibCairoPango(surface),
+	pool(NULL), ownPool(false), parent(parent), tilesX(0), tilesY(0),
+	canvasX1(0.0), canvasY1(0.0), canvasX2(0.0), canvasY2(0.0), tileSize(256)
+{
+	cairo_matrix_init_identity(&this->drawMatrix);
+}
+
+DrawLibTiled::~DrawLibTiled()
+{
+	for(size_t i=0;i < this->workers.size(); i++)
+		delete this->workers[i];
+	this->workers.clear();
+	this->ReleaseSharedImages();
+	if(this->ownPool)
+		delete this->pool;
+}
+
+int DrawLibTiled::GetDrawableExtents(double &x1,
+	double &y1,
+	double &x2,
+	double &y2)
+{
+	if(this->parent == NULL)
+		return DrawLibCairoPango::GetDrawableExtents(x1, y1, x2, y2);
+
+	//Workers clip to the whole drawable area, so clipped geometry is the same as drawing serially
+	x1 = this->parent->canvasX1;
+	y1 = this->parent->canvasY1;
+	x2 = this->parent->canvasX2;
+	y2 = this->parent->canvasY2;
+	return 0;
+}
+
+///Bounds of quantized geometry, which are kept when it is stored
+///\return false if it has no points
+static bool QuantizedBounds(const class QuantizedContours &quantized, double &x1, double &y1, double &x2, double &y2)
+{
+	if(quantized.NumPoints() == 0)
+		return false;
+	x1 = quantized.x1;
+	y1 = quantized.y1;
+	x2 = quantized.x2;
+	y2 = quantized.y2;
+	return true;
+}
+
+///Find the extent of a command in user space, including the width of strokes
+///and enough room for any text. Text is not measured, as that would cost about
+///as much as drawing it, so a bound is made from the font size and length.
+///\return false if the command should be drawn on every tile. The box is empty,
+///with x1 > x2, if the command draws nothing.
+bool DrawLibTiled::CmdBounds(class BaseCmd &cmd, double &x1, double &y1, double &x2, double &y2)
+{
+	bool found = false;
+	double margin = 0.0;
+	switch(cmd.type)
+	{
+	case CMD_POLYGONS:
+		{
+			const class DrawPolygonsCmd &polygonsCmd = (class DrawPolygonsCmd &)cmd;
+			if(polygonsCmd.IsQuantized())
+			{
+				found = QuantizedBounds(polygonsCmd.quantized, x1, y1, x2, y2);
+				break;
+			}
+			const std::vector<Polygon> &polygons = polygonsCmd.polygons;
+			for(size_t i=0;i < polygons.size(); i++)
+			{
+				const Contour &outer = polygons[i].first;
+				for(size_t j=0;j < outer.size(); j++)
+				{
+					const Point &pt = outer[j];
+					if(!found || pt.first < x1) x1 = pt.first;
+					if(!found || pt.first > x2) x2 = pt.first;
+					if(!found || pt.second < y1) y1 = pt.second;
+					if(!found || pt.second > y2) y2 = pt.second;
+					found = true;
+				}
+			}
+			break;
+		}
+	case CMD_LINES:
+		{
+			const class DrawLinesCmd &linesCmd = (class DrawLinesCmd &)cmd;
+			if(linesCmd.IsQuantized())
+				found = QuantizedBounds(linesCmd.quantized, x1, y1, x2, y2);
+			for(size_t i=0;i < linesCmd.lines.size(); i++)
+			{
+				const Contour &line = linesCmd.lines[i];
+				for(size_t j=0;j < line.size(); j++)
+				{
+					const Point &pt = line[j];
+					if(!found || pt.first < x1) x1 = pt.first;
+					if(!found || pt.first > x2) x2 = pt.first;
+					if(!found || pt.second < y1) y1 = pt.second;
+					if(!found || pt.second > y2) y2 = pt.second;
+					found = true;
+				}
+			}
+			margin = 0.5 * linesCmd.properties.lineWidth * 10.0; //Widest miter at the cairo default limit
+			break;
+		}
+	case CMD_TEXT:
+		{
+			const class DrawTextCmd &textCmd = (class DrawTextCmd &)cmd;
+			double em = textCmd.properties.fontSize * 96.0 / 72.0; //Pango sizes are points at 96 dpi
+			for(size_t i=0;i < textCmd.textStrs.size(); i++)
+			{
+				//Text of any alignment and angle fits in a circle of its length plus height
+				const class TextLabel &label = textCmd.textStrs[i];
+				double radius = (label.text.size() + 3) * em;
+				if(!found || label.x - radius < x1) x1 = label.x - radius;
+				if(!found || label.x + radius > x2) x2 = label.x + radius;
+				if(!found || label.y - radius < y1) y1 = label.y - radius;
+				if(!found || label.y + radius > y2) y2 = label.y + radius;
+				found = true;
+			}
+			margin = textCmd.properties.lineWidth;
+			break;
+		}
+	case CMD_TWISTED_TEXT:
+		{
+			//Text can run beyond the end of its path, so allow its full length around the path
+			const class DrawTwistedTextCmd &textCmd = (class DrawTwistedTextCmd &)cmd;
+			double em = textCmd.properties.fontSize * 96.0 / 72.0;
+			for(size_t i=0;i < textCmd.textStrs.size(); i++)
+			{
+				const class TwistedTextLabel &label = textCmd.textStrs[i];
+				const class TwistedPath &path = label.path;
+				double radius = (label.text.size() + 3) * em;
+				double cx = 0.0, cy = 0.0;
+				const double *c = path.coords.size() > 0 ? &path.coords[0] : NULL;
+				for(size_t j=0;j < path.verbs.size(); j++)
+				{
+					TwistedCurveCmdType ty = path.verbs[j];
+					int arity = TwistedCurveCmdArity(ty);
+					bool relative = ty == RelLineTo || ty == RelCurveTo;
+					//Control points bound a Bezier curve
+					for(int k=0;k < arity; k+=2)
+					{
+						double x = relative ? cx + c[k] : c[k];
+						double y = relative ? cy + c[k+1] : c[k+1];
+						if(!found || x - radius < x1) x1 = x - radius;
+						if(!found || x + radius > x2) x2 = x + radius;
+						if(!found || y - radius < y1) y1 = y - radius;
+						if(!found || y + radius > y2) y2 = y + radius;
+						found = true;
+					}
+					cx = relative ? cx + c[arity-2] : c[arity-2];
+					cy = relative ? cy + c[arity-1] : c[arity-1];
+					c += arity;
+				}
+			}
+			margin = textCmd.properties.lineWidth;
+			break;
+		}
+	case CMD_INSTANCES:
+		{
+			class DrawInstancesCmd &instancesCmd = (class DrawInstancesCmd &)cmd;
+			bool filled = instancesCmd.polygons.size() > 0;
+			double px1=0.0, py1=0.0, px2=0.0, py2=0.0;
+			bool protoFound = false;
+			size_t numRings = filled ? instancesCmd.polygons.size() : instancesCmd.lines.size();
+			for(size_t i=0;i < numRings; i++)
+			{
+				const Contour &ring = filled ? instancesCmd.polygons[i].first : instancesCmd.lines[i];
+				for(size_t j=0;j < ring.size(); j++)
+				{
+					const Point &pt = ring[j];
+					if(!protoFound || pt.first < px1) px1 = pt.first;
+					if(!protoFound || pt.first > px2) px2 = pt.first;
+					if(!protoFound || pt.second < py1) py1 = pt.second;
+					if(!protoFound || pt.second > py2) py2 = pt.second;
+					protoFound = true;
+				}
+			}
+			if(!protoFound)
+				break;
+			if(!filled)
+			{
+				//Strokes are scaled with each instance
+				double strokeMargin = 0.5 * instancesCmd.lineProperties.lineWidth * 10.0;
+				px1 -= strokeMargin; py1 -= strokeMargin;
+				px2 += strokeMargin; py2 += strokeMargin;
+			}
+
+			for(size_t i=0;i < instancesCmd.NumInstances(); i++)
+			{
+				class AffineTransform transform = instancesCmd.GetTransform(i);
+				if(!transform.IsInvertible())
+					continue; //Not drawn, see DrawLibCairo::DrawCmdInstances
+				double bx[4] = {px1, px2, px2, px1};
+				double by[4] = {py1, py1, py2, py2};
+				for(int k=0;k < 4;k++)
+				{
+					transform.Apply(bx[k], by[k]);
+					if(!found || bx[k] < x1) x1 = bx[k];
+					if(!found || bx[k] > x2) x2 = bx[k];
+					if(!found || by[k] < y1) y1 = by[k];
+					if(!found || by[k] > y2) y2 = by[k];
+					found = true;
+				}
+			}
+			break;
+		}
+	default:
+		return false; //Resources are loaded on every tile
+	}
+
+	if(!found)
+	{
+		//Nothing is drawn, which is shown by an empty box
+		x1 = y1 = 0.0;
+		x2 = y2 = -1.0;
+		return true;
+	}
+	x1 -= margin;
+	y1 -= margin;
+	x2 += margin;
+	y2 += margin;
+	return true;
+}
+
+///Put the index of each command in the list of every tile it touches
+void DrawLibTiled::BinCommands(int width, int height)
+{
+	int size = max(this->tileSize, 16);
+	this->tilesX = (width + size - 1) / size;
+	this->tilesY = (height + size - 1) / size;
+	size_t numTiles = (size_t)this->tilesX * this->tilesY;
+	this->tileCmds.resize(numTiles);
+	for(size_t i=0;i < numTiles; i++)
+		this->tileCmds[i].clear();
+	this->tileCost.assign(numTiles, 0);
+
+	for(size_t i=0;i < cmds.size(); i++)
+	{
+		class BaseCmd *baseCmd = cmds[i];
+		int tx1 = 0, ty1 = 0, tx2 = this->tilesX - 1, ty2 = this->tilesY - 1;
+		double x1 = 0.0, y1 = 0.0, x2 = 0.0, y2 = 0.0;
+		if(this->CmdBounds(*baseCmd, x1, y1, x2, y2))
+		{
+			if(x1 > x2 || y1 > y2)
+				continue;
+
+			//Bounding box in device pixels, with a pixel more for antialiasing
+			double bx[4] = {x1, x2, x2, x1};
+			double by[4] = {y1, y1, y2, y2};
+			double dx1 = 0.0, dy1 = 0.0, dx2 = 0.0, dy2 = 0.0;
+			for(int k=0;k < 4;k++)
+			{
+				cairo_matrix_transform_point(&this->drawMatrix, &bx[k], &by[k]);
+				if(k == 0 || bx[k] < dx1) dx1 = bx[k];
+				if(k == 0 || bx[k] > dx2) dx2 = bx[k];
+				if(k == 0 || by[k] < dy1) dy1 = by[k];
+				if(k == 0 || by[k] > dy2) dy2 = by[k];
+			}
+			dx1 -= 1.0; dy1 -= 1.0;
+			dx2 += 1.0; dy2 += 1.0;
+			if(dx2 < 0.0 || dy2 < 0.0 || dx1 > width || dy1 > height)
+				continue;
+
+			tx1 = max(0, (int)floor(dx1 / size));
+			ty1 = max(0, (int)floor(dy1 / size));
+			tx2 = min(this->tilesX - 1, (int)floor(dx2 / size));
+			ty2 = min(this->tilesY - 1, (int)floor(dy2 / size));
+		}
+
+		class CmdMemoryUsage usage;
+		baseCmd->GetMemoryUsage(usage);
+		size_t cost = 1 + usage.vertices;
+		for(int ty = ty1; ty <= ty2; ty++)
+		{
+			for(int tx = tx1; tx <= tx2; tx++)
+			{
+				size_t tile = (size_t)ty * this->tilesX + tx;
+				this->tileCmds[tile].push_back(i);
+				this->tileCost[tile] += cost;
+			}
+		}
+	}
+}
+
+///Load every image used by the commands once, so workers share them rather
+///than each reading the files again for every tile
+void DrawLibTiled::LoadSharedImages()
+{
+	for(size_t i=0;i < cmds.size(); i++)
+	{
+		if(cmds[i]->type != CMD_LOAD_RESOURCES)
+			continue;
+		const std::map<std::string, std::string> &mapping = ((class LoadImageResourcesCmd *)cmds[i])->loadIdToFilenameMapping;
+		for(std::map<std::string, std::string>::const_iterator it = mapping.begin(); it != mapping.end(); it++)
+		{
+			if(this->sharedImages.find(it->second) != this->sharedImages.end())
+				continue;
+			cairo_surface_t *surf = NULL;
+			#ifdef CAIRO_HAS_PNG_FUNCTIONS
+			surf = cairo_image_surface_create_from_png(it->second.c_str());
+			#endif //CAIRO_HAS_PNG_FUNCTIONS
+			this->sharedImages[it->second] = surf;
+		}
+	}
+
+	//Each tile starts with the resources loaded before this Draw
+	for(std::map<std::string, cairo_surface_t *>::iterator it = this->imageResources.begin();
+		it != this->imageResources.end();
+		it++)
+		this->startImages[it->first] = cairo_surface_reference(it->second);
+}
+
+void DrawLibTiled::ReleaseSharedImages()
+{
+	for(std::map<std::string, cairo_surface_t *>::iterator it = this->sharedImages.begin();
+		it != this->sharedImages.end();
+		it++)
+		cairo_surface_destroy(it->second);
+	this->sharedImages.clear();
+	for(std::map<std::string, cairo_surface_t *>::iterator it = this->startImages.begin();
+		it != this->startImages.end();
+		it++)
+		cairo_surface_destroy(it->second);
+	this->startImages.clear();
+}
+
+void DrawLibTiled::LoadResources(class LoadImageResourcesCmd &resourcesCmd)
+{
+	const class DrawLibTiled *root = this->parent != NULL ? this->parent : this;
+	for(std::map<std::string, std::string>::const_iterator it = resourcesCmd.loadIdToFilenameMapping.begin();
+		it != resourcesCmd.loadIdToFilenameMapping.end();
+		it++)
+	{
+		std::map<std::string, cairo_surface_t *>::const_iterator shared = root->sharedImages.find(it->second);
+		cairo_surface_t *surf = NULL;
+		if(shared != root->sharedImages.end())
+			surf = cairo_surface_reference(shared->second);
+		else
+		{
+			#ifdef CAIRO_HAS_PNG_FUNCTIONS
+			surf = cairo_image_surface_create_from_png(it->second.c_str());
+			#endif //CAIRO_HAS_PNG_FUNCTIONS
+		}
+
+		std::map<std::string, cairo_surface_t *>::iterator existing = this->imageResources.find(it->first);
+		if(existing != this->imageResources.end())
+		{
+			cairo_surface_destroy(existing->second);
+			existing->second = surf;
+		}
+		else
+			this->imageResources[it->first] = surf;
+	}
+}
+
+///Replay the commands of one tile on this worker
+void DrawLibTiled::DrawTile(size_t tile)
+{
+	const class DrawLibTiled &p = *this->parent;
+	int size = max(p.tileSize, 16);
+	int x = (int)(tile % p.tilesX) * size;
+	int y = (int)(tile / p.tilesX) * size;
+	int width = min(size, cairo_image_surface_get_width(p.surface) - x);
+	int height = min(size, cairo_image_surface_get_height(p.surface) - y);
+
+	//Start from the resources as they were before the Draw
+	for(std::map<std::string, cairo_surface_t *>::iterator it = this->imageResources.begin();
+		it != this->imageResources.end();
+		it++)
+		cairo_surface_destroy(it->second);
+	this->imageResources.clear();
+	for(std::map<std::string, cairo_surface_t *>::const_iterator it = p.startImages.begin();
+		it != p.startImages.end();
+		it++)
+		this->imageResources[it->first] = cairo_surface_reference(it->second);
+
+	cairo_surface_t *tileSurface = cairo_surface_create_for_rectangle(p.surface, x, y, width, height);
+	cairo_destroy(this->cr);
+	this->surface = tileSurface;
+	this->cr = cairo_create(tileSurface);
+
+	//Same user space as the parent, offset to the tile origin
+	cairo_matrix_t tileMatrix;
+	cairo_matrix_init_translate(&tileMatrix, -x, -y);
+	cairo_matrix_multiply(&tileMatrix, &p.drawMatrix, &tileMatrix);
+	cairo_set_matrix(this->cr, &tileMatrix);
+	this->pixelSize = p.pixelSize;
+	this->detailLevel = p.detailLevel;
+	this->clipGeometry = p.clipGeometry;
+	this->clipMarginPixels = p.clipMarginPixels;
+
+	const std::vector<size_t> &cmdIds = p.tileCmds[tile];
+	for(size_t i=0;i < cmdIds.size(); i++)
+		this->DrawCmd(*p.cmds[cmdIds[i]]);
+
+	cairo_surface_flush(tileSurface);
+	cairo_destroy(this->cr);
+	this->cr = cairo_create(p.surface);
+	this->surface = p.surface;
+	cairo_surface_destroy(tileSurface);
+}
+
+void DrawLibTiled::DrawTileTask(size_t taskId, int workerIndex, void *userData)
+{
+	class DrawLibTiled *drawLib = (class DrawLibTiled *)userData;
+	drawLib->workers[workerIndex]->DrawTile(taskId);
+}
+
+void DrawLibTiled::Draw()
+{
+	if(this->parent != NULL || cairo_surface_get_type(this->surface) != CAIRO_SURFACE_TYPE_IMAGE)
+	{
+		DrawLibCairoPango::Draw();
+		return;
+	}
+	if(this->pool == NULL)
+	{
+		this->pool = new class WorkStealingPool();
+		this->ownPool = true;
+	}
+	int numThreads = this->pool->GetNumThreads();
+	int width = cairo_image_surface_get_width(this->surface);
+	int height = cairo_image_surface_get_height(this->surface);
+	if(numThreads < 2 || width <= 0 || height <= 0)
+	{
+		DrawLibCairoPango::Draw();
+		return;
+	}
+
+	double frameStart = this->collectStats ? DrawStatsClock() : 0.0;
+	cairo_save(this->cr);
+	this->BeginDraw();
+	cairo_get_matrix(this->cr, &this->drawMatrix);
+	DrawLibCairoPango::GetDrawableExtents(this->canvasX1, this->canvasY1, this->canvasX2, this->canvasY2);
+	cairo_restore(this->cr);
+	this->BinCommands(width, height);
+
+	this->LoadSharedImages();
+	while(this->workers.size() < (size_t)numThreads)
+		this->workers.push_back(new class DrawLibTiled(this->surface, this));
+	cairo_surface_flush(this->surface);
+
+	//Busiest tiles first, so they do not hold up the end of the batch
+	std::vector<std::pair<size_t, size_t> > order;
+	for(size_t i=0;i < this->tileCmds.size(); i++)
+		if(this->tileCmds[i].size() > 0)
+			order.push_back(std::pair<size_t, size_t>(this->tileCost[i], i));
+	sort(order.rbegin(), order.rend());
+	std::vector<size_t> taskIds(order.size());
+	for(size_t i=0;i < order.size(); i++)
+		taskIds[i] = order[i].second;
+
+	try
+	{
+		this->pool->Run(taskIds, DrawLibTiled::DrawTileTask, this);
+	}
+	catch(...)
+	{
+		cairo_surface_mark_dirty(this->surface);
+		this->ReleaseSharedImages();
+		throw;
+	}
+	cairo_surface_mark_dirty(this->surface);
+
+	//Keep resources in step with the commands, as when drawing serially
+	for(size_t i=0;i < cmds.size(); i++)
+	{
+		if(cmds[i]->type == CMD_LOAD_RESOURCES)
+			this->LoadResources(*(class LoadImageResourcesCmd *)cmds[i]);
+		else if(cmds[i]->type == CMD_UNLOAD_RESOURCES)
+			this->UnloadResources(*(class UnloadImageResourcesCmd *)cmds[i]);
+	}
+	this->ReleaseSharedImages();
+
+	if(this->collectStats)
+		this->stats.AddFrame(frameStart, DrawStatsClock());
+}
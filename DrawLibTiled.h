@@ -0,0 +1,54 @@
+#ifndef _DRAW_LIB_TILED_H
+#define _DRAW_LIB_TILED_H
+
+#include "drawlibcairo.h"
+#include "WorkStealingPool.h"
+
+///Draw on an image surface in square tiles spread over a work stealing pool.
+///Each command is binned to the tiles its bounding box touches, then workers
+///take tiles and replay only their commands, in order, on a cairo context of a
+///sub-surface. Geometry is clipped to the whole drawable area as when drawing
+///serially, so the output is the same as DrawLibCairoPango. Other surface types,
+///and pools of one thread, are drawn serially. Only frame times are collected
+///in the stats when drawing in tiles.
+class DrawLibTiled : public DrawLibCairoPango
+{
+protected:
+	class WorkStealingPool *pool;
+	bool ownPool;
+	const class DrawLibTiled *parent; //Set on the per worker instances
+	std::vector<class DrawLibTiled *> workers;
+	std::vector<std::vector<size_t> > tileCmds; //Indices of the commands touching each tile
+	std::vector<size_t> tileCost; //Estimated work of each tile
+	int tilesX, tilesY;
+	cairo_matrix_t drawMatrix; //User to device matrix of the current Draw
+	double canvasX1, canvasY1, canvasX2, canvasY2; //Drawable area in user space
+	std::map<std::string, cairo_surface_t *> sharedImages; //Filename to image, loaded once per Draw
+	std::map<std::string, cairo_surface_t *> startImages; //Resources loaded before the current Draw
+
+	DrawLibTiled(cairo_surface_t *surface, const class DrawLibTiled *parent);
+
+	bool CmdBounds(class BaseCmd &cmd, double &x1, double &y1, double &x2, double &y2);
+	void BinCommands(int width, int height);
+	void LoadSharedImages();
+	void ReleaseSharedImages();
+	void DrawTile(size_t tile);
+	static void DrawTileTask(size_t taskId, int workerIndex, void *userData);
+
+	virtual void LoadResources(class LoadImageResourcesCmd &resourcesCmd);
+public:
+	int tileSize; //Width and height of tiles in pixels
+
+	///Draw with the threads of pool, or a pool the size of the hardware
+	///concurrency if NULL. The pool must outlive this object.
+	DrawLibTiled(cairo_surface_t *surface, class WorkStealingPool *pool = NULL);
+	virtual ~DrawLibTiled();
+
+	int GetDrawableExtents(double &x1,
+		double &y1,
+		double &x2,
+		double &y2);
+	void Draw();
+};
+
+#endif //_DRAW_LIB_TILED_H
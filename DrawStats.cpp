@@ -0,0 +1,129 @@
+#include <chrono>
+#include <ios>
+#include "DrawStats.h"
+using namespace std;
+
+CmdTypeStats::CmdTypeStats()
+{
+	this->Clear();
+}
+
+void CmdTypeStats::Clear()
+{
+	count = 0;
+	seconds = 0.0;
+	vertices = 0;
+	glyphs = 0;
+}
+
+// *************************************
+
+DrawStats::DrawStats()
+{
+	this->Clear();
+}
+
+DrawStats::~DrawStats()
+{}
+
+void DrawStats::Clear()
+{
+	cmdTypes.clear();
+	frames = 0;
+	seconds = 0.0;
+	maskSurfaceCreations = 0;
+	patternCreations = 0;
+	lastFrameSeconds = 0.0;
+	frameTrace.clear();
+}
+
+class CmdTypeStats &DrawStats::ForType(CmdTypes type)
+{
+	if((size_t)type >= cmdTypes.size())
+		cmdTypes.resize(type+1);
+	return cmdTypes[type];
+}
+
+void DrawStats::AddCmd(CmdTypes type, double frameStart, double cmdStart, double cmdEnd,
+	size_t vertices, size_t glyphs, bool trace)
+{
+	class CmdTypeStats &typeStats = this->ForType(type);
+	typeStats.count ++;
+	typeStats.seconds += cmdEnd - cmdStart;
+	typeStats.vertices += vertices;
+	typeStats.glyphs += glyphs;
+
+	if(trace)
+	{
+		class DrawTraceEvent ev;
+		ev.type = type;
+		ev.start = cmdStart - frameStart;
+		ev.duration = cmdEnd - cmdStart;
+		ev.vertices = vertices;
+		ev.glyphs = glyphs;
+		frameTrace.push_back(ev);
+	}
+}
+
+void DrawStats::AddFrame(double frameStart, double frameEnd)
+{
+	frames ++;
+	lastFrameSeconds = frameEnd - frameStart;
+	seconds += lastFrameSeconds;
+}
+
+void DrawStats::WriteChromeTrace(std::ostream &out) const
+{
+	ios_base::fmtflags flags = out.flags();
+	streamsize precision = out.precision();
+	out.setf(ios_base::fixed, ios_base::floatfield);
+	out.precision(3);
+
+	//Times are in microseconds
+	out << "{\"traceEvents\": [" << endl;
+	out << "{\"name\": \"frame\", \"cat\": \"draw\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": 0.000, \"dur\": "
+		<< lastFrameSeconds * 1e6 << ", \"args\": {\"frame\": " << frames << "}}";
+	for(size_t i=0;i < frameTrace.size(); i++)
+	{
+		const class DrawTraceEvent &ev = frameTrace[i];
+		out << "," << endl;
+		out << "{\"name\": \"" << CmdTypeName(ev.type) << "\", \"cat\": \"draw\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": "
+			<< ev.start * 1e6 << ", \"dur\": " << ev.duration * 1e6
+			<< ", \"args\": {\"vertices\": " << ev.vertices << ", \"glyphs\": " << ev.glyphs << "}}";
+	}
+	out << endl << "], \"displayTimeUnit\": \"ms\"}" << endl;
+
+	out.flags(flags);
+	out.precision(precision);
+}
+
+// *************************************
+
+double DrawStatsClock()
+{
+	return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const char *CmdTypeName(CmdTypes type)
+{
+	switch(type)
+	{
+	case CMD_POLYGONS: return "polygons";
+	case CMD_LINES: return "lines";
+	case CMD_TEXT: return "text";
+	case CMD_TWISTED_TEXT: return "twisted_text";
+	case CMD_LOAD_RESOURCES: return "load_resources";
+	case CMD_UNLOAD_RESOURCES: return "unload_resources";
+	case CMD_INSTANCES: return "instances";
+	default: return "base";
+	}
+}
+
+size_t CountCharacters(const std::string &text)
+{
+	size_t count = 0;
+	for(size_t i=0;i < text.size(); i++)
+		if(((unsigned char)text[i] & 0xC0) != 0x80)
+			count ++;
+	return count;
+}
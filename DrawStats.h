@@ -0,0 +1,65 @@
+#ifndef _DRAW_STATS_H
+#define _DRAW_STATS_H
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include "drawlib.h"
+
+///Counters for one type of command
+class CmdTypeStats
+{
+public:
+	size_t count; //Commands drawn
+	double seconds; //Wall time spent drawing them
+	size_t vertices; //Points passed to the drawing library
+	size_t glyphs; //Glyphs shaped, or characters where the glyphs are not known
+
+	CmdTypeStats();
+	void Clear();
+};
+
+///One command drawn during a traced frame
+class DrawTraceEvent
+{
+public:
+	CmdTypes type;
+	double start, duration; //Seconds from the start of the frame
+	size_t vertices, glyphs;
+};
+
+///Timing and counters collected while drawing. They accumulate over
+///frames until Clear is called.
+class DrawStats
+{
+public:
+	std::vector<class CmdTypeStats> cmdTypes; //Indexed by CmdTypes
+	size_t frames;
+	double seconds; //Wall time of all frames
+	size_t maskSurfaceCreations;
+	size_t patternCreations;
+	double lastFrameSeconds;
+	std::vector<class DrawTraceEvent> frameTrace; //Commands of the last frame, if traced
+
+	DrawStats();
+	virtual ~DrawStats();
+	void Clear();
+
+	class CmdTypeStats &ForType(CmdTypes type);
+	///Record a drawn command. Times are from DrawStatsClock.
+	void AddCmd(CmdTypes type, double frameStart, double cmdStart, double cmdEnd,
+		size_t vertices, size_t glyphs, bool trace);
+	void AddFrame(double frameStart, double frameEnd);
+
+	///Write the last traced frame as Chrome trace event JSON, which can be
+	///loaded in chrome://tracing or Perfetto
+	void WriteChromeTrace(std::ostream &out) const;
+};
+
+///Monotonic wall clock in seconds
+double DrawStatsClock();
+const char *CmdTypeName(CmdTypes type);
+///Number of UTF-8 code points in a string
+size_t CountCharacters(const std::string &text);
+
+#endif //_DRAW_STATS_H
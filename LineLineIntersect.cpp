@@ -3,7 +3,12 @@
 #include <iostream>
 #include <cmath>
 #include <assert.h>
+#include <stdlib.h>
 #include "LineLineIntersect.h"
+#include "CpuFeatures.h"
+#ifdef DRAWLIB_X86_SIMD
+#include <immintrin.h>
+#endif
 using namespace std;
 
 /** Calculate determinant of matrix:
@@ -50,6 +55,293 @@ bool LineLineIntersect(double x1, double y1, //Line 1 start
 	return true; //All OK
 }
 
+// *************************************
+
+/** Line-line intersection for the batch functions. Performs the same
+	operations in the same order as the SIMD versions so all give identical
+	results.
+*/
+static inline bool LineLineIntersectKernel(double x1, double y1, double x2, double y2,
+	double detL1, double x3, double y3, double x4, double y4,
+	bool segmentsOnly, double &ixOut, double &iyOut)
+{
+	double x1mx2 = x1 - x2;
+	double y1my2 = y1 - y2;
+	double x3mx4 = x3 - x4;
+	double y3my4 = y3 - y4;
+	double detL2 = x3*y4 - y3*x4;
+	double denom = x1mx2*y3my4 - y1my2*x3mx4;
+	double ix = (detL1*x3mx4 - x1mx2*detL2) / denom;
+	double iy = (detL1*y3my4 - y1my2*detL2) / denom;
+	bool found = denom != 0.0 && ix - ix == 0.0 && iy - iy == 0.0;
+
+	if(segmentsOnly)
+	{
+		double x1mx3 = x1 - x3;
+		double y1my3 = y1 - y3;
+		double t = (x1mx3*y3my4 - y1my3*x3mx4) / denom;
+		double u = (y1my2*x1mx3 - x1mx2*y1my3) / denom;
+		found = found && t >= 0.0 && t <= 1.0 && u >= 0.0 && u <= 1.0;
+	}
+
+	ixOut = found ? ix : NAN;
+	iyOut = found ? iy : NAN;
+	return found;
+}
+
+static size_t LineLineIntersectBatchScalar(double x1, double y1, double x2, double y2,
+	const double *x3, const double *y3, const double *x4, const double *y4, size_t start, size_t count,
+	bool segmentsOnly, unsigned char *foundOut, double *ixOut, double *iyOut)
+{
+	double detL1 = x1*y2 - y1*x2;
+	size_t numFound = 0;
+	for(size_t i = start; i < count; i++)
+	{
+		bool found = LineLineIntersectKernel(x1, y1, x2, y2, detL1, x3[i], y3[i], x4[i], y4[i],
+			segmentsOnly, ixOut[i], iyOut[i]);
+		foundOut[i] = found;
+		numFound += found;
+	}
+	return numFound;
+}
+
+#ifdef DRAWLIB_X86_SIMD
+
+///Process pairs of candidates with SSE2, returning how many were done
+static size_t LineLineIntersectBatchSse2(double x1, double y1, double x2, double y2,
+	const double *x3, const double *y3, const double *x4, const double *y4, size_t count,
+	bool segmentsOnly, unsigned char *foundOut, double *ixOut, double *iyOut, size_t &numFoundOut)
+	__attribute__((target("sse2")));
+
+static size_t LineLineIntersectBatchSse2(double x1, double y1, double x2, double y2,
+	const double *x3, const double *y3, const double *x4, const double *y4, size_t count,
+	bool segmentsOnly, unsigned char *foundOut, double *ixOut, double *iyOut, size_t &numFoundOut)
+{
+	const __m128d vx1 = _mm_set1_pd(x1);
+	const __m128d vy1 = _mm_set1_pd(y1);
+	const __m128d x1mx2 = _mm_set1_pd(x1 - x2);
+	const __m128d y1my2 = _mm_set1_pd(y1 - y2);
+	const __m128d detL1 = _mm_set1_pd(x1*y2 - y1*x2);
+	const __m128d zero = _mm_setzero_pd();
+	const __m128d one = _mm_set1_pd(1.0);
+	const __m128d nan = _mm_set1_pd(NAN);
+
+	size_t numFound = 0;
+	size_t i = 0;
+	for(; i + 2 <= count; i += 2)
+	{
+		__m128d vx3 = _mm_loadu_pd(x3 + i);
+		__m128d vy3 = _mm_loadu_pd(y3 + i);
+		__m128d vx4 = _mm_loadu_pd(x4 + i);
+		__m128d vy4 = _mm_loadu_pd(y4 + i);
+
+		__m128d x3mx4 = _mm_sub_pd(vx3, vx4);
+		__m128d y3my4 = _mm_sub_pd(vy3, vy4);
+		__m128d detL2 = _mm_sub_pd(_mm_mul_pd(vx3, vy4), _mm_mul_pd(vy3, vx4));
+		__m128d denom = _mm_sub_pd(_mm_mul_pd(x1mx2, y3my4), _mm_mul_pd(y1my2, x3mx4));
+		__m128d ix = _mm_div_pd(_mm_sub_pd(_mm_mul_pd(detL1, x3mx4), _mm_mul_pd(x1mx2, detL2)), denom);
+		__m128d iy = _mm_div_pd(_mm_sub_pd(_mm_mul_pd(detL1, y3my4), _mm_mul_pd(y1my2, detL2)), denom);
+
+		__m128d found = _mm_cmpneq_pd(denom, zero);
+		found = _mm_and_pd(found, _mm_cmpeq_pd(_mm_sub_pd(ix, ix), zero));
+		found = _mm_and_pd(found, _mm_cmpeq_pd(_mm_sub_pd(iy, iy), zero));
+
+		if(segmentsOnly)
+		{
+			__m128d x1mx3 = _mm_sub_pd(vx1, vx3);
+			__m128d y1my3 = _mm_sub_pd(vy1, vy3);
+			__m128d t = _mm_div_pd(_mm_sub_pd(_mm_mul_pd(x1mx3, y3my4), _mm_mul_pd(y1my3, x3mx4)), denom);
+			__m128d u = _mm_div_pd(_mm_sub_pd(_mm_mul_pd(y1my2, x1mx3), _mm_mul_pd(x1mx2, y1my3)), denom);
+			found = _mm_and_pd(found, _mm_cmpge_pd(t, zero));
+			found = _mm_and_pd(found, _mm_cmple_pd(t, one));
+			found = _mm_and_pd(found, _mm_cmpge_pd(u, zero));
+			found = _mm_and_pd(found, _mm_cmple_pd(u, one));
+		}
+
+		_mm_storeu_pd(ixOut + i, _mm_or_pd(_mm_and_pd(found, ix), _mm_andnot_pd(found, nan)));
+		_mm_storeu_pd(iyOut + i, _mm_or_pd(_mm_and_pd(found, iy), _mm_andnot_pd(found, nan)));
+
+		int mask = _mm_movemask_pd(found);
+		foundOut[i] = mask & 1;
+		foundOut[i+1] = (mask >> 1) & 1;
+		numFound += __builtin_popcount(mask);
+	}
+	numFoundOut = numFound;
+	return i;
+}
+
+///Process groups of four candidates with AVX, returning how many were done
+static size_t LineLineIntersectBatchAvx(double x1, double y1, double x2, double y2,
+	const double *x3, const double *y3, const double *x4, const double *y4, size_t count,
+	bool segmentsOnly, unsigned char *foundOut, double *ixOut, double *iyOut, size_t &numFoundOut)
+	__attribute__((target("avx")));
+
+static size_t LineLineIntersectBatchAvx(double x1, double y1, double x2, double y2,
+	const double *x3, const double *y3, const double *x4, const double *y4, size_t count,
+	bool segmentsOnly, unsigned char *foundOut, double *ixOut, double *iyOut, size_t &numFoundOut)
+{
+	const __m256d vx1 = _mm256_set1_pd(x1);
+	const __m256d vy1 = _mm256_set1_pd(y1);
+	const __m256d x1mx2 = _mm256_set1_pd(x1 - x2);
+	const __m256d y1my2 = _mm256_set1_pd(y1 - y2);
+	const __m256d detL1 = _mm256_set1_pd(x1*y2 - y1*x2);
+	const __m256d zero = _mm256_setzero_pd();
+	const __m256d one = _mm256_set1_pd(1.0);
+	const __m256d nan = _mm256_set1_pd(NAN);
+
+	size_t numFound = 0;
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4)
+	{
+		__m256d vx3 = _mm256_loadu_pd(x3 + i);
+		__m256d vy3 = _mm256_loadu_pd(y3 + i);
+		__m256d vx4 = _mm256_loadu_pd(x4 + i);
+		__m256d vy4 = _mm256_loadu_pd(y4 + i);
+
+		__m256d x3mx4 = _mm256_sub_pd(vx3, vx4);
+		__m256d y3my4 = _mm256_sub_pd(vy3, vy4);
+		__m256d detL2 = _mm256_sub_pd(_mm256_mul_pd(vx3, vy4), _mm256_mul_pd(vy3, vx4));
+		__m256d denom = _mm256_sub_pd(_mm256_mul_pd(x1mx2, y3my4), _mm256_mul_pd(y1my2, x3mx4));
+		__m256d ix = _mm256_div_pd(_mm256_sub_pd(_mm256_mul_pd(detL1, x3mx4), _mm256_mul_pd(x1mx2, detL2)), denom);
+		__m256d iy = _mm256_div_pd(_mm256_sub_pd(_mm256_mul_pd(detL1, y3my4), _mm256_mul_pd(y1my2, detL2)), denom);
+
+		__m256d found = _mm256_cmp_pd(denom, zero, _CMP_NEQ_OQ);
+		found = _mm256_and_pd(found, _mm256_cmp_pd(_mm256_sub_pd(ix, ix), zero, _CMP_EQ_OQ));
+		found = _mm256_and_pd(found, _mm256_cmp_pd(_mm256_sub_pd(iy, iy), zero, _CMP_EQ_OQ));
+
+		if(segmentsOnly)
+		{
+			__m256d x1mx3 = _mm256_sub_pd(vx1, vx3);
+			__m256d y1my3 = _mm256_sub_pd(vy1, vy3);
+			__m256d t = _mm256_div_pd(_mm256_sub_pd(_mm256_mul_pd(x1mx3, y3my4), _mm256_mul_pd(y1my3, x3mx4)), denom);
+			__m256d u = _mm256_div_pd(_mm256_sub_pd(_mm256_mul_pd(y1my2, x1mx3), _mm256_mul_pd(x1mx2, y1my3)), denom);
+			found = _mm256_and_pd(found, _mm256_cmp_pd(t, zero, _CMP_GE_OQ));
+			found = _mm256_and_pd(found, _mm256_cmp_pd(t, one, _CMP_LE_OQ));
+			found = _mm256_and_pd(found, _mm256_cmp_pd(u, zero, _CMP_GE_OQ));
+			found = _mm256_and_pd(found, _mm256_cmp_pd(u, one, _CMP_LE_OQ));
+		}
+
+		_mm256_storeu_pd(ixOut + i, _mm256_blendv_pd(nan, ix, found));
+		_mm256_storeu_pd(iyOut + i, _mm256_blendv_pd(nan, iy, found));
+
+		int mask = _mm256_movemask_pd(found);
+		foundOut[i] = mask & 1;
+		foundOut[i+1] = (mask >> 1) & 1;
+		foundOut[i+2] = (mask >> 2) & 1;
+		foundOut[i+3] = (mask >> 3) & 1;
+		numFound += __builtin_popcount(mask);
+	}
+	numFoundOut = numFound;
+	return i;
+}
+
+#endif //DRAWLIB_X86_SIMD
+
+size_t LineLineIntersectBatch(double x1, double y1, //Line 1 start
+	double x2, double y2, //Line 1 end
+	const double *x3, const double *y3, //Other line starts
+	const double *x4, const double *y4, //Other line ends
+	size_t count,
+	bool segmentsOnly,
+	unsigned char *foundOut, double *ixOut, double *iyOut) //Output 
+{
+	size_t done = 0, numFound = 0;
+#ifdef DRAWLIB_X86_SIMD
+	SimdLevel level = GetSimdLevel();
+	if(level >= SIMD_AVX)
+		done = LineLineIntersectBatchAvx(x1, y1, x2, y2, x3, y3, x4, y4, count,
+			segmentsOnly, foundOut, ixOut, iyOut, numFound);
+	else if(level == SIMD_SSE2)
+		done = LineLineIntersectBatchSse2(x1, y1, x2, y2, x3, y3, x4, y4, count,
+			segmentsOnly, foundOut, ixOut, iyOut, numFound);
+#endif
+	//Remaining candidates
+	numFound += LineLineIntersectBatchScalar(x1, y1, x2, y2, x3, y3, x4, y4, done, count,
+		segmentsOnly, foundOut, ixOut, iyOut);
+	return numFound;
+}
+
+// *************************************
+
+///Sign of the area of triangle a, b, c. Exact for small integer coordinates.
+inline int Orientation(double ax, double ay, double bx, double by, double cx, double cy)
+{
+	double det = (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+	return (det > 0.0) - (det < 0.0);
+}
+
+bool SegmentSegmentIntersect(double x1, double y1, //Segment 1 start
+	double x2, double y2, //Segment 1 end
+	double x3, double y3, //Segment 2 start
+	double x4, double y4, //Segment 2 end
+	double &ixOut, double &iyOut) //Output 
+{
+	int o1 = Orientation(x1, y1, x2, y2, x3, y3);
+	int o2 = Orientation(x1, y1, x2, y2, x4, y4);
+	int o3 = Orientation(x3, y3, x4, y4, x1, y1);
+	int o4 = Orientation(x3, y3, x4, y4, x2, y2);
+
+	ixOut = NAN;
+	iyOut = NAN;
+	if(o1 == 0 && o2 == 0)
+	{
+		//Collinear, so compare extents along the major axis
+		bool useX = fabs(x2 - x1) + fabs(x4 - x3) >= fabs(y2 - y1) + fabs(y4 - y3);
+		double a1 = useX ? x1 : y1, a2 = useX ? x2 : y2;
+		double b1 = useX ? x3 : y3, b2 = useX ? x4 : y4;
+		if(a1 > a2) {double tmp = a1; a1 = a2; a2 = tmp;}
+		if(b1 > b2) {double tmp = b1; b1 = b2; b2 = tmp;}
+		if(a2 < b1 || b2 < a1)
+			return false;
+
+		//Start of overlap is an end point of one of the segments
+		double start = a1 > b1 ? a1 : b1;
+		if(start == (useX ? x1 : y1)) {ixOut = x1; iyOut = y1;}
+		else if(start == (useX ? x2 : y2)) {ixOut = x2; iyOut = y2;}
+		else if(start == (useX ? x3 : y3)) {ixOut = x3; iyOut = y3;}
+		else {ixOut = x4; iyOut = y4;}
+		return true;
+	}
+
+	if(o1 * o2 > 0 || o3 * o4 > 0)
+		return false;
+
+	//Use exact end points where segments touch
+	if(o1 == 0) {ixOut = x3; iyOut = y3; return true;}
+	if(o2 == 0) {ixOut = x4; iyOut = y4; return true;}
+	if(o3 == 0) {ixOut = x1; iyOut = y1; return true;}
+	if(o4 == 0) {ixOut = x2; iyOut = y2; return true;}
+
+	return LineLineIntersect(x1, y1, x2, y2, x3, y3, x4, y4, ixOut, iyOut);
+}
+
+///Check the batch version agrees with the single line version, with the
+///candidate repeated enough times to use every code path
+static void CheckLineLineIntersectBatch(double x1, double y1, double x2, double y2,
+	double x3, double y3, double x4, double y4, bool expected, double ix, double iy)
+{
+	const size_t count = 11;
+	double x3s[count], y3s[count], x4s[count], y4s[count], ixs[count], iys[count];
+	unsigned char found[count];
+	for(size_t i = 0; i < count; i++)
+	{
+		x3s[i] = x3; y3s[i] = y3;
+		x4s[i] = x4; y4s[i] = y4;
+	}
+
+	size_t numFound = LineLineIntersectBatch(x1, y1, x2, y2, x3s, y3s, x4s, y4s, count, false, found, ixs, iys);
+	assert(numFound == (expected ? count : 0));
+	for(size_t i = 0; i < count; i++)
+	{
+		assert(found[i] == expected);
+		if(expected)
+		{
+			assert(ixs[i] == ix);
+			assert(iys[i] == iy);
+		}
+	}
+}
+
 void LineLineIntersectTests()
 {
 	// **Simple crossing diagonal lines**
@@ -65,6 +357,7 @@ void LineLineIntersectTests()
 	double ix = -1.0, iy = -1.0;
 	bool result = LineLineIntersect(x1, y1, x2, y2, x3, y3, x4, y4, ix, iy);
 	cout << "result " <<  result << "," << ix << "," << iy << endl;
+	CheckLineLineIntersectBatch(x1, y1, x2, y2, x3, y3, x4, y4, result, ix, iy);
 
 	double eps = 1e-6;
 	assert(result == true);
@@ -81,6 +374,7 @@ void LineLineIntersectTests()
 	ix = -1.0; iy = -1.0;
 	result = LineLineIntersect(x1, y1, x2, y2, x3, y3, x4, y4, ix, iy);
 	cout << "result " <<  result << "," << ix << "," << iy << endl;
+	CheckLineLineIntersectBatch(x1, y1, x2, y2, x3, y3, x4, y4, result, ix, iy);
 	assert(result == false);
 	
 	x1=0.0; y1=0.0;
@@ -91,6 +385,7 @@ void LineLineIntersectTests()
 	ix = -1.0; iy = -1.0;
 	result = LineLineIntersect(x1, y1, x2, y2, x3, y3, x4, y4, ix, iy);
 	cout << "result " <<  result << "," << ix << "," << iy << endl;
+	CheckLineLineIntersectBatch(x1, y1, x2, y2, x3, y3, x4, y4, result, ix, iy);
 	assert(result == false);
 
 	// ** One horizontal line, one diagonal **
@@ -103,6 +398,7 @@ void LineLineIntersectTests()
 	ix = -1.0; iy = -1.0;
 	result = LineLineIntersect(x1, y1, x2, y2, x3, y3, x4, y4, ix, iy);
 	cout << "result " <<  result << "," << ix << "," << iy << endl;
+	CheckLineLineIntersectBatch(x1, y1, x2, y2, x3, y3, x4, y4, result, ix, iy);
 	assert(result == true);
 	assert(fabs(ix - 3.0) < eps);
 	assert(fabs(iy - 3.0) < eps);
@@ -117,6 +413,7 @@ void LineLineIntersectTests()
 	ix = -1.0; iy = -1.0;
 	result = LineLineIntersect(x1, y1, x2, y2, x3, y3, x4, y4, ix, iy);
 	cout << "result " <<  result << "," << ix << "," << iy << endl;
+	CheckLineLineIntersectBatch(x1, y1, x2, y2, x3, y3, x4, y4, result, ix, iy);
 	assert(result == true);
 	assert(fabs(ix - 6.0) < eps);
 	assert(fabs(iy - 6.0) < eps);
@@ -131,6 +428,7 @@ void LineLineIntersectTests()
 	ix = -1.0; iy = -1.0;
 	result = LineLineIntersect(x1, y1, x2, y2, x3, y3, x4, y4, ix, iy);
 	cout << "result " <<  result << "," << ix << "," << iy << endl;
+	CheckLineLineIntersectBatch(x1, y1, x2, y2, x3, y3, x4, y4, result, ix, iy);
 	assert(result == false);
 
 	// ** Degenerate line **
@@ -143,6 +441,57 @@ void LineLineIntersectTests()
 	ix = -1.0; iy = -1.0;
 	result = LineLineIntersect(x1, y1, x2, y2, x3, y3, x4, y4, ix, iy);
 	cout << "result " <<  result << "," << ix << "," << iy << endl;
+	CheckLineLineIntersectBatch(x1, y1, x2, y2, x3, y3, x4, y4, result, ix, iy);
+	assert(result == false);
+
+	// ** Batch of bounded segments against one segment **
+
+	double bx3[5] = {0.0, 0.0, 5.0, 20.0, 0.0};
+	double by3[5] = {10.0, 14.0, 0.0, 0.0, 0.0};
+	double bx4[5] = {10.0, 14.0, 5.0, 20.0, 10.0};
+	double by4[5] = {0.0, 0.0, 10.0, 10.0, 10.0};
+	double bix[5], biy[5];
+	unsigned char bfound[5];
+	size_t bnum = LineLineIntersectBatch(0.0, 0.0, 6.0, 6.0, bx3, by3, bx4, by4, 5, true, bfound, bix, biy);
+	assert(bnum == 2);
+	assert(bfound[0] && !bfound[1] && bfound[2] && !bfound[3] && !bfound[4]);
+	assert(fabs(bix[0] - 5.0) < eps && fabs(biy[0] - 5.0) < eps);
+	assert(fabs(bix[2] - 5.0) < eps && fabs(biy[2] - 5.0) < eps);
+
+	// ** Bounded segments that would cross if extended **
+
+	x1=0.0; y1=0.0;
+	x2=4.0; y2=4.0;
+	x3=0.0; y3=10.0;
+	x4=10.0; y4=0.0;
+
+	result = SegmentSegmentIntersect(x1, y1, x2, y2, x3, y3, x4, y4, ix, iy);
+	assert(result == false);
+	x2=6.0; y2=6.0;
+	result = SegmentSegmentIntersect(x1, y1, x2, y2, x3, y3, x4, y4, ix, iy);
+	assert(result == true);
+	assert(fabs(ix - 5.0) < eps);
+	assert(fabs(iy - 5.0) < eps);
+
+	// ** Segments touching at an end point **
+
+	x1=0.0; y1=0.0;
+	x2=5.0; y2=5.0;
+	result = SegmentSegmentIntersect(x1, y1, x2, y2, x3, y3, x4, y4, ix, iy);
+	assert(result == true);
+	assert(ix == 5.0 && iy == 5.0);
+
+	// ** Collinear segments **
+
+	x1=0.0; y1=3.0;
+	x2=5.0; y2=3.0;
+	x3=4.0; y3=3.0;
+	x4=10.0; y4=3.0;
+	result = SegmentSegmentIntersect(x1, y1, x2, y2, x3, y3, x4, y4, ix, iy);
+	assert(result == true);
+	assert(ix == 4.0 && iy == 3.0);
+	x3=6.0;
+	result = SegmentSegmentIntersect(x1, y1, x2, y2, x3, y3, x4, y4, ix, iy);
 	assert(result == false);
 
 }
@@ -1,5 +1,6 @@
 #ifndef _LINE_LINE_INTERSECT_H
 #define _LINE_LINE_INTERSECT_H
+#include <stddef.h>
 
 ///Calculate intersection of two lines.
 ///\return true if found, false if not found or error
@@ -9,6 +10,29 @@ bool LineLineIntersect(double x1, double y1, //Line 1 start
 	double x4, double y4, //Line 2 end
 	double &ixOut, double &iyOut); //Output 
 
+///Calculate intersections of one line with many others, given as separate
+///arrays of start and end coordinates. Uses AVX or SSE2 when the processor
+///supports them. If segmentsOnly is set, only intersections that lie within
+///both segments are found. Points are NAN where nothing was found.
+///\return number of intersections found
+size_t LineLineIntersectBatch(double x1, double y1, //Line 1 start
+	double x2, double y2, //Line 1 end
+	const double *x3, const double *y3, //Other line starts
+	const double *x4, const double *y4, //Other line ends
+	size_t count,
+	bool segmentsOnly,
+	unsigned char *foundOut, double *ixOut, double *iyOut); //Output 
+
+///Calculate intersection of two bounded line segments. Touching end points
+///count as an intersection. Collinear overlapping segments give the first
+///point of the overlap.
+///\return true if the segments intersect
+bool SegmentSegmentIntersect(double x1, double y1, //Segment 1 start
+	double x2, double y2, //Segment 1 end
+	double x3, double y3, //Segment 2 start
+	double x4, double y4, //Segment 2 end
+	double &ixOut, double &iyOut); //Output 
+
 void LineLineIntersectTests();
 
 #endif //_LINE_LINE_INTERSECT_H
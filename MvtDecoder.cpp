@@ -0,0 +1,713 @@
+//Mapbox Vector Tile decoding. Only the few protobuf wire types used by tiles
+//are read, so no protobuf library is needed.
+//https://developers.google.com/protocol-buffers/docs/encoding
+
+#include "MvtDecoder.h"
+#include <string.h>
+#include <stdexcept>
+#include <iostream>
+#include <assert.h>
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+enum PbWireType
+{
+	PB_VARINT = 0,
+	PB_FIXED64 = 1,
+	PB_BYTES = 2,
+	PB_FIXED32 = 5
+};
+
+enum MvtCommand
+{
+	MVT_MOVE_TO = 1,
+	MVT_LINE_TO = 2,
+	MVT_CLOSE_PATH = 7
+};
+
+static void MvtFail()
+{
+	throw runtime_error("Malformed vector tile");
+}
+
+static uint64_t PbVarint(const unsigned char *&p, const unsigned char *end)
+{
+	uint64_t val = 0;
+	for(int shift = 0; shift < 64; shift += 7)
+	{
+		if(p >= end)
+			MvtFail();
+		unsigned char byte = *p++;
+		val |= (uint64_t)(byte & 0x7f) << shift;
+		if((byte & 0x80) == 0)
+			return val;
+	}
+	MvtFail();
+	return 0;
+}
+
+static int64_t PbZigzag(uint64_t val)
+{
+	return (int64_t)(val >> 1) ^ -(int64_t)(val & 1);
+}
+
+static uint64_t PbFixed(const unsigned char *&p, const unsigned char *end, int size)
+{
+	if(end - p < size)
+		MvtFail();
+	uint64_t val = 0;
+	for(int i = 0; i < size; i++)
+		val |= (uint64_t)p[i] << (8 * i);
+	p += size;
+	return val;
+}
+
+///Read a length delimited field, leaving p after it
+static void PbBytes(const unsigned char *&p, const unsigned char *end,
+	const unsigned char *&startOut, const unsigned char *&endOut)
+{
+	uint64_t len = PbVarint(p, end);
+	if(len > (uint64_t)(end - p))
+		MvtFail();
+	startOut = p;
+	endOut = p + len;
+	p = endOut;
+}
+
+static void PbSkip(const unsigned char *&p, const unsigned char *end, int wireType)
+{
+	const unsigned char *start = NULL, *stop = NULL;
+	switch(wireType)
+	{
+	case PB_VARINT: PbVarint(p, end); break;
+	case PB_FIXED64: PbFixed(p, end, 8); break;
+	case PB_BYTES: PbBytes(p, end, start, stop); break;
+	case PB_FIXED32: PbFixed(p, end, 4); break;
+	default: MvtFail();
+	}
+}
+
+static void PbKey(const unsigned char *&p, const unsigned char *end, uint64_t &fieldOut, int &wireTypeOut)
+{
+	uint64_t key = PbVarint(p, end);
+	fieldOut = key >> 3;
+	wireTypeOut = (int)(key & 7);
+}
+
+static void DecodeValue(const unsigned char *p, const unsigned char *end, class MvtValue &valueOut)
+{
+	valueOut = MvtValue();
+	while(p < end)
+	{
+		uint64_t field = 0;
+		int wireType = 0;
+		PbKey(p, end, field, wireType);
+		if(field == 1 && wireType == PB_BYTES)
+		{
+			const unsigned char *start = NULL, *stop = NULL;
+			PbBytes(p, end, start, stop);
+			valueOut.type = MVT_STRING;
+			valueOut.str = (const char *)start;
+			valueOut.strLen = stop - start;
+		}
+		else if(field == 2 && wireType == PB_FIXED32)
+		{
+			uint32_t bits = (uint32_t)PbFixed(p, end, 4);
+			float val = 0.0f;
+			memcpy(&val, &bits, sizeof(val));
+			valueOut.type = MVT_NUMBER;
+			valueOut.number = val;
+		}
+		else if(field == 3 && wireType == PB_FIXED64)
+		{
+			uint64_t bits = PbFixed(p, end, 8);
+			double val = 0.0;
+			memcpy(&val, &bits, sizeof(val));
+			valueOut.type = MVT_NUMBER;
+			valueOut.number = val;
+		}
+		else if(field >= 4 && field <= 7 && wireType == PB_VARINT)
+		{
+			uint64_t val = PbVarint(p, end);
+			valueOut.type = field == 7 ? MVT_BOOL : MVT_NUMBER;
+			if(field == 4)
+				valueOut.number = (double)(int64_t)val;
+			else if(field == 6)
+				valueOut.number = (double)PbZigzag(val);
+			else
+				valueOut.number = (double)val;
+		}
+		else
+			PbSkip(p, end, wireType);
+	}
+}
+
+// *************************************
+
+MvtValue::MvtValue() : type(MVT_NUMBER), str(NULL), strLen(0), number(0.0)
+{}
+
+MvtFeature::MvtFeature() : id(0), type(MVT_UNKNOWN), tags(NULL), tagsEnd(NULL)
+{}
+
+const class MvtValue *MvtFeature::Find(const char *key) const
+{
+	size_t keyLen = strlen(key);
+	const unsigned char *p = this->tags;
+	while(p < this->tagsEnd)
+	{
+		uint64_t k = PbVarint(p, this->tagsEnd);
+		uint64_t v = PbVarint(p, this->tagsEnd);
+		if(k >= this->keys.size() || v >= this->values.size())
+			MvtFail();
+		if(this->keys[k].second == keyLen && memcmp(this->keys[k].first, key, keyLen) == 0)
+			return &this->values[v];
+	}
+	return NULL;
+}
+
+bool MvtFeature::GetString(const char *key, std::string &valueOut) const
+{
+	const class MvtValue *value = this->Find(key);
+	if(value == NULL || value->type != MVT_STRING)
+		return false;
+	valueOut.assign(value->str, value->strLen);
+	return true;
+}
+
+bool MvtFeature::GetNumber(const char *key, double &valueOut) const
+{
+	const class MvtValue *value = this->Find(key);
+	if(value == NULL || value->type == MVT_STRING)
+		return false;
+	valueOut = value->number;
+	return true;
+}
+
+MvtStyle::MvtStyle() : fill(true), outline(false), stroke(true)
+{}
+
+// *************************************
+
+MvtDecoder::MvtDecoder(class LocalStore &store, MvtStyleCallback styleCallback, void *userData) :
+	store(store), styleCallback(styleCallback), userData(userData), featurePolygons(0),
+	pendingPolygons(NULL), pendingLines(NULL), pendingText(NULL),
+	transform(AffineTransform::Scaling(256.0, 256.0))
+{
+	if(styleCallback == NULL)
+		throw invalid_argument("Style callback is NULL");
+}
+
+MvtDecoder::~MvtDecoder()
+{
+	delete this->pendingPolygons;
+	delete this->pendingLines;
+	delete this->pendingText;
+}
+
+void MvtDecoder::Flush()
+{
+	//In drawing order. Empty commands are dropped.
+	if(this->pendingPolygons != NULL && this->pendingPolygons->polygons.size() > 0)
+		this->store.AdoptCmd(this->pendingPolygons);
+	else
+		delete this->pendingPolygons;
+	this->pendingPolygons = NULL;
+
+	if(this->pendingLines != NULL && this->pendingLines->lines.size() > 0)
+		this->store.AdoptCmd(this->pendingLines);
+	else
+		delete this->pendingLines;
+	this->pendingLines = NULL;
+
+	if(this->pendingText != NULL && this->pendingText->textStrs.size() > 0)
+		this->store.AdoptCmd(this->pendingText);
+	else
+		delete this->pendingText;
+	this->pendingText = NULL;
+}
+
+template<class T> static bool SameProperties(const T &a, const T &b)
+{
+	return !(a < b) && !(b < a);
+}
+
+///Make the pending commands those the current style needs, keeping them if
+///they already are so consecutive features are batched together
+void MvtDecoder::PrepareCmds(bool polygons, bool lines, bool text)
+{
+	const class MvtStyle &st = this->style;
+	bool same = (polygons == (this->pendingPolygons != NULL))
+		&& (lines == (this->pendingLines != NULL))
+		&& (text == (this->pendingText != NULL))
+		&& (!polygons || SameProperties(this->pendingPolygons->properties, st.shapeProperties))
+		&& (!lines || SameProperties(this->pendingLines->properties, st.lineProperties))
+		&& (!text || SameProperties(this->pendingText->properties, st.textProperties));
+	if(same)
+		return;
+
+	this->Flush();
+	if(polygons)
+		this->pendingPolygons = new class DrawPolygonsCmd(std::vector<Polygon>(), st.shapeProperties);
+	if(lines)
+		this->pendingLines = new class DrawLinesCmd(Contours(), st.lineProperties);
+	if(text)
+		this->pendingText = new class DrawTextCmd(std::vector<class TextLabel>(), st.textProperties);
+}
+
+void MvtDecoder::Decode(const char *data, size_t size)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	const unsigned char *end = p + size;
+	try
+	{
+		while(p < end)
+		{
+			uint64_t field = 0;
+			int wireType = 0;
+			PbKey(p, end, field, wireType);
+			if(field == 3 && wireType == PB_BYTES)
+			{
+				const unsigned char *layer = NULL, *layerEnd = NULL;
+				PbBytes(p, end, layer, layerEnd);
+				this->DecodeLayer(layer, layerEnd);
+			}
+			else
+				PbSkip(p, end, wireType);
+		}
+	}
+	catch(...)
+	{
+		this->Flush();
+		throw;
+	}
+	this->Flush();
+}
+
+void MvtDecoder::DecodeFile(const char *filename)
+{
+#ifdef _WIN32
+	std::ifstream in(filename, std::ios::binary);
+	if(!in)
+		throw runtime_error(std::string("Could not open ") + filename);
+	std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	this->Decode(data.size() > 0 ? &data[0] : NULL, data.size());
+#else
+	int fd = open(filename, O_RDONLY);
+	if(fd < 0)
+		throw runtime_error(std::string("Could not open ") + filename);
+	struct stat st;
+	if(fstat(fd, &st) != 0)
+	{
+		close(fd);
+		throw runtime_error(std::string("Could not read ") + filename);
+	}
+	size_t size = st.st_size;
+	if(size == 0)
+	{
+		close(fd);
+		return;
+	}
+	void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(data == MAP_FAILED)
+		throw runtime_error(std::string("Could not map ") + filename);
+	try
+	{
+		this->Decode((const char *)data, size);
+	}
+	catch(...)
+	{
+		munmap(data, size);
+		throw;
+	}
+	munmap(data, size);
+#endif
+}
+
+void MvtDecoder::DecodeLayer(const unsigned char *data, const unsigned char *end)
+{
+	//Keys and values usually follow the features, so are read first
+	class MvtFeature &ft = this->feature;
+	ft.layerName.clear();
+	ft.keys.clear();
+	ft.values.clear();
+	uint64_t extent = 4096;
+	const unsigned char *p = data;
+	while(p < end)
+	{
+		uint64_t field = 0;
+		int wireType = 0;
+		PbKey(p, end, field, wireType);
+		const unsigned char *start = NULL, *stop = NULL;
+		if(field == 1 && wireType == PB_BYTES)
+		{
+			PbBytes(p, end, start, stop);
+			ft.layerName.assign((const char *)start, stop - start);
+		}
+		else if(field == 3 && wireType == PB_BYTES)
+		{
+			PbBytes(p, end, start, stop);
+			ft.keys.push_back(std::pair<const char *, size_t>((const char *)start, stop - start));
+		}
+		else if(field == 4 && wireType == PB_BYTES)
+		{
+			PbBytes(p, end, start, stop);
+			ft.values.push_back(MvtValue());
+			DecodeValue(start, stop, ft.values.back());
+		}
+		else if(field == 5 && wireType == PB_VARINT)
+			extent = PbVarint(p, end);
+		else
+			PbSkip(p, end, wireType);
+	}
+	if(extent == 0)
+		MvtFail();
+	this->layerTransform = this->transform * AffineTransform::Scaling(1.0 / extent, 1.0 / extent);
+
+	p = data;
+	while(p < end)
+	{
+		uint64_t field = 0;
+		int wireType = 0;
+		PbKey(p, end, field, wireType);
+		if(field == 2 && wireType == PB_BYTES)
+		{
+			const unsigned char *start = NULL, *stop = NULL;
+			PbBytes(p, end, start, stop);
+			this->DecodeFeature(start, stop);
+		}
+		else
+			PbSkip(p, end, wireType);
+	}
+}
+
+void MvtDecoder::DecodeFeature(const unsigned char *data, const unsigned char *end)
+{
+	class MvtFeature &ft = this->feature;
+	ft.id = 0;
+	ft.type = MVT_UNKNOWN;
+	ft.tags = NULL;
+	ft.tagsEnd = NULL;
+	const unsigned char *geometry = NULL, *geometryEnd = NULL;
+	const unsigned char *p = data;
+	while(p < end)
+	{
+		uint64_t field = 0;
+		int wireType = 0;
+		PbKey(p, end, field, wireType);
+		if(field == 1 && wireType == PB_VARINT)
+			ft.id = PbVarint(p, end);
+		else if(field == 2 && wireType == PB_BYTES)
+			PbBytes(p, end, ft.tags, ft.tagsEnd);
+		else if(field == 3 && wireType == PB_VARINT)
+		{
+			uint64_t type = PbVarint(p, end);
+			ft.type = type <= MVT_POLYGON ? (MvtGeomType)type : MVT_UNKNOWN;
+		}
+		else if(field == 4 && wireType == PB_BYTES)
+			PbBytes(p, end, geometry, geometryEnd);
+		else
+			PbSkip(p, end, wireType);
+	}
+	if(ft.type == MVT_UNKNOWN || geometry == NULL)
+		return;
+
+	this->style = MvtStyle();
+	if(!this->styleCallback(ft, this->style, this->userData))
+		return;
+	bool polygons = ft.type == MVT_POLYGON && this->style.fill;
+	bool lines = (ft.type == MVT_POLYGON && this->style.outline) || (ft.type == MVT_LINESTRING && this->style.stroke);
+	bool text = ft.type == MVT_POINT && this->style.label.size() > 0;
+	if(!polygons && !lines && !text)
+		return;
+	this->PrepareCmds(polygons, lines, text);
+	this->featurePolygons = 0;
+	this->AddGeometry(geometry, geometryEnd);
+}
+
+///Read the command integers of a feature geometry. Rings are gathered in
+///tile units, with their area, then transformed as a whole.
+void MvtDecoder::AddGeometry(const unsigned char *geometry, const unsigned char *end)
+{
+	bool isPoint = this->feature.type == MVT_POINT;
+	int64_t x = 0, y = 0, startX = 0, startY = 0;
+	double area = 0.0; //Twice the area of the ring so far, which only needs its sign
+	bool inRing = false;
+	const unsigned char *p = geometry;
+	while(p < end)
+	{
+		uint64_t cmdInt = PbVarint(p, end);
+		uint64_t cmd = cmdInt & 7, count = cmdInt >> 3;
+		if(cmd == MVT_MOVE_TO || cmd == MVT_LINE_TO)
+		{
+			if(cmd == MVT_LINE_TO && !inRing)
+				MvtFail();
+			for(uint64_t i = 0; i < count; i++)
+			{
+				int64_t prevX = x, prevY = y;
+				//Wrap rather than overflow on corrupt data
+				x = (int64_t)((uint64_t)x + (uint64_t)PbZigzag(PbVarint(p, end)));
+				y = (int64_t)((uint64_t)y + (uint64_t)PbZigzag(PbVarint(p, end)));
+				if(isPoint)
+				{
+					if(cmd == MVT_MOVE_TO)
+						this->AddPoint((double)x, (double)y);
+					continue;
+				}
+				if(cmd == MVT_MOVE_TO)
+				{
+					if(inRing)
+						this->FinishRing(area, false);
+					this->ring.clear();
+					area = 0.0;
+					startX = x; startY = y;
+					inRing = true;
+				}
+				else
+					area += (double)prevX * y - (double)x * prevY;
+				this->ring.push_back(Point((double)x, (double)y));
+			}
+		}
+		else if(cmd == MVT_CLOSE_PATH)
+		{
+			if(!inRing)
+				MvtFail();
+			area += (double)x * startY - (double)startX * y;
+			this->FinishRing(area, true);
+			inRing = false;
+		}
+		else
+			MvtFail();
+	}
+	if(inRing)
+		this->FinishRing(area, false);
+}
+
+void MvtDecoder::FinishRing(double area, bool closed)
+{
+	Contour &pts = this->ring;
+	if(this->feature.type == MVT_LINESTRING)
+	{
+		if(pts.size() < 2)
+			return;
+		TransformPoints(this->layerTransform, &pts[0], pts.size());
+		this->pendingLines->lines.push_back(Contour());
+		this->pendingLines->lines.back().swap(pts);
+		return;
+	}
+
+	//Polygons: exterior rings have a positive area in tile coordinates, and are
+	//followed by their holes
+	if(!closed || area == 0.0 || pts.size() < 3)
+		return;
+	TransformPoints(this->layerTransform, &pts[0], pts.size());
+	if(this->pendingLines != NULL)
+	{
+		this->pendingLines->lines.push_back(Contour());
+		Contour &outline = this->pendingLines->lines.back();
+		if(this->pendingPolygons != NULL)
+			outline = pts;
+		else
+			outline.swap(pts);
+		//Rings do not repeat their first point. The line properties may also
+		//be used by open line strings, so the outline is closed itself.
+		if(!this->pendingLines->properties.closedLoop)
+			outline.push_back(outline[0]);
+	}
+	if(this->pendingPolygons != NULL)
+	{
+		std::vector<Polygon> &polygons = this->pendingPolygons->polygons;
+		if(area > 0 || this->featurePolygons == 0)
+		{
+			polygons.push_back(Polygon());
+			polygons.back().first.swap(pts);
+			this->featurePolygons++;
+		}
+		else
+		{
+			polygons.back().second.push_back(Contour());
+			polygons.back().second.back().swap(pts);
+		}
+	}
+}
+
+void MvtDecoder::AddPoint(double x, double y)
+{
+	this->layerTransform.Apply(x, y);
+	this->pendingText->textStrs.push_back(TextLabel(this->style.label.c_str(), x, y));
+}
+
+// *************************************
+
+static void MvtTestVarint(std::string &out, uint64_t val)
+{
+	while(val >= 0x80)
+	{
+		out.push_back((char)(val | 0x80));
+		val >>= 7;
+	}
+	out.push_back((char)val);
+}
+
+static void MvtTestBytes(std::string &out, int field, const std::string &bytes)
+{
+	MvtTestVarint(out, (field << 3) | PB_BYTES);
+	MvtTestVarint(out, bytes.size());
+	out += bytes;
+}
+
+static void MvtTestVarintField(std::string &out, int field, uint64_t val)
+{
+	MvtTestVarint(out, (field << 3) | PB_VARINT);
+	MvtTestVarint(out, val);
+}
+
+///Append a geometry command and its points, which are relative to the point before
+static void MvtTestCommand(std::string &geometry, int cmd, const int *coords, int count)
+{
+	MvtTestVarint(geometry, (count << 3) | cmd);
+	for(int i = 0; i < count * 2; i++)
+		MvtTestVarint(geometry, ((uint32_t)coords[i] << 1) ^ (uint32_t)(coords[i] >> 31));
+}
+
+///Append a closed ring, starting from the cursor moved by the first point
+static void MvtTestRing(std::string &geometry, const int *coords, int count)
+{
+	MvtTestCommand(geometry, MVT_MOVE_TO, coords, 1);
+	MvtTestCommand(geometry, MVT_LINE_TO, coords + 2, count - 1);
+	MvtTestVarint(geometry, (1 << 3) | MVT_CLOSE_PATH);
+}
+
+static std::string MvtTestFeature(MvtGeomType type, const std::string &tags, const std::string &geometry)
+{
+	std::string feature;
+	MvtTestBytes(feature, 2, tags);
+	MvtTestVarintField(feature, 3, type);
+	MvtTestBytes(feature, 4, geometry);
+	return feature;
+}
+
+static bool MvtTestStyle(const class MvtFeature &feature, class MvtStyle &styleOut, void *)
+{
+	std::string kind;
+	feature.GetString("kind", kind);
+	double lanes = 0.0;
+	if(kind == "water")
+	{
+		styleOut.shapeProperties = ShapeProperties(0.0, 0.0, 1.0);
+		styleOut.outline = true;
+		styleOut.lineProperties = LineProperties(0.0, 0.0, 0.5, 2.0);
+	}
+	else if(kind == "road" && feature.GetNumber("lanes", lanes))
+		styleOut.lineProperties = LineProperties(1.0, 1.0, 0.0, lanes);
+	feature.GetString("name", styleOut.label);
+	return kind != "skip";
+}
+
+///Gives the tests access to the decoded commands
+class MvtTestStore : public LocalStore
+{
+public:
+	size_t NumCmds() const {return this->cmds.size();}
+	const class BaseCmd &Cmd(size_t i) const {return *this->cmds[i];}
+};
+
+void MvtDecoderTests()
+{
+	//Tags are key and value numbers: kind=water, kind=road lanes=2, name=Town, kind=skip
+	std::string layer;
+	MvtTestBytes(layer, 1, "test");
+
+	// ** Polygon with a hole, then a second polygon **
+	std::string geometry;
+	int outer[] = {0,0, 10,0, 0,10, -10,0}; //Clockwise with y down, so exterior
+	MvtTestRing(geometry, outer, 4);
+	int hole[] = {2,-8, 0,6, 6,0, 0,-6}; //Anticlockwise, so a hole
+	MvtTestRing(geometry, hole, 4);
+	int triangle[] = {4,-2, 10,0, 0,10};
+	MvtTestRing(geometry, triangle, 3);
+	std::string tags;
+	MvtTestVarint(tags, 0); MvtTestVarint(tags, 0);
+	MvtTestBytes(layer, 2, MvtTestFeature(MVT_POLYGON, tags, geometry));
+
+	// ** Line string with a number attribute **
+	geometry.clear();
+	int road[] = {100,100, 50,0, 0,50};
+	MvtTestCommand(geometry, MVT_MOVE_TO, road, 1);
+	MvtTestCommand(geometry, MVT_LINE_TO, road + 2, 2);
+	tags.clear();
+	MvtTestVarint(tags, 0); MvtTestVarint(tags, 1);
+	MvtTestVarint(tags, 1); MvtTestVarint(tags, 2);
+	MvtTestBytes(layer, 2, MvtTestFeature(MVT_LINESTRING, tags, geometry));
+	std::string skipped = MvtTestFeature(MVT_LINESTRING, std::string("\x00\x04", 2), geometry);
+	MvtTestBytes(layer, 2, skipped);
+
+	// ** Labelled point **
+	geometry.clear();
+	int town[] = {5,5};
+	MvtTestCommand(geometry, MVT_MOVE_TO, town, 1);
+	tags.clear();
+	MvtTestVarint(tags, 2); MvtTestVarint(tags, 3);
+	MvtTestBytes(layer, 2, MvtTestFeature(MVT_POINT, tags, geometry));
+
+	MvtTestBytes(layer, 3, "kind");
+	MvtTestBytes(layer, 3, "lanes");
+	MvtTestBytes(layer, 3, "name");
+	const char *strs[] = {"water", "road", NULL, "Town", "skip"};
+	for(int i = 0; i < 5; i++)
+	{
+		std::string value;
+		if(strs[i] != NULL)
+			MvtTestBytes(value, 1, strs[i]);
+		else
+			MvtTestVarintField(value, 6, 4); //sint 2
+		MvtTestBytes(layer, 4, value);
+	}
+	MvtTestVarintField(layer, 5, 256); //Extent, so tile units are store units
+	std::string tile;
+	MvtTestBytes(tile, 3, layer);
+
+	class MvtTestStore store;
+	class MvtDecoder decoder(store, MvtTestStyle);
+	decoder.Decode(tile.data(), tile.size());
+	assert(store.NumCmds() == 4);
+
+	//Exterior rings start polygons and holes are added to them
+	assert(store.Cmd(0).type == CMD_POLYGONS);
+	const std::vector<Polygon> &polygons = ((const class DrawPolygonsCmd &)store.Cmd(0)).polygons;
+	assert(polygons.size() == 2);
+	assert(polygons[0].first.size() == 4 && polygons[0].second.size() == 1);
+	assert(polygons[0].second[0][0] == Point(2.0, 2.0));
+	assert(polygons[1].first.size() == 3 && polygons[1].second.size() == 0);
+	assert(polygons[1].first[0] == Point(12.0, 0.0));
+
+	//Every ring is outlined, and closed as the line properties are open
+	assert(store.Cmd(1).type == CMD_LINES);
+	const class DrawLinesCmd &outlines = (const class DrawLinesCmd &)store.Cmd(1);
+	assert(!outlines.properties.closedLoop && outlines.properties.lineWidth == 2.0);
+	assert(outlines.lines.size() == 3);
+	assert(outlines.lines[0].size() == 5 && outlines.lines[0][4] == outlines.lines[0][0]);
+	assert(outlines.lines[1].size() == 5 && outlines.lines[1][4] == Point(2.0, 2.0));
+	assert(outlines.lines[2].size() == 4 && outlines.lines[2][3] == Point(12.0, 0.0));
+
+	//Lines are left open, styled from a number attribute
+	assert(store.Cmd(2).type == CMD_LINES);
+	const class DrawLinesCmd &roads = (const class DrawLinesCmd &)store.Cmd(2);
+	assert(roads.properties.lineWidth == 2.0 && roads.properties.b == 0.0);
+	assert(roads.lines.size() == 1 && roads.lines[0].size() == 3);
+	assert(roads.lines[0][2] == Point(150.0, 150.0));
+
+	assert(store.Cmd(3).type == CMD_TEXT);
+	const class DrawTextCmd &labels = (const class DrawTextCmd &)store.Cmd(3);
+	assert(labels.textStrs.size() == 1 && labels.textStrs[0].text == "Town");
+	assert(labels.textStrs[0].x == 5.0 && labels.textStrs[0].y == 5.0);
+	std::cout << "mvt commands " << store.NumCmds() << std::endl;
+}
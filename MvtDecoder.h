@@ -0,0 +1,119 @@
+#ifndef _MVT_DECODER_H
+#define _MVT_DECODER_H
+
+#include "drawlib.h"
+
+enum MvtGeomType
+{
+	MVT_UNKNOWN,
+	MVT_POINT,
+	MVT_LINESTRING,
+	MVT_POLYGON
+};
+
+enum MvtValueType
+{
+	MVT_STRING,
+	MVT_NUMBER,
+	MVT_BOOL
+};
+
+///Attribute value of a vector tile feature. Strings point into the tile data.
+class MvtValue
+{
+public:
+	MvtValueType type;
+	const char *str;
+	size_t strLen;
+	double number; //Numbers of every encoding, and 0 or 1 for bools
+
+	MvtValue();
+};
+
+///Feature of a vector tile, as passed to the style callback. It refers to the
+///tile data and the decoder, so is only valid during the callback.
+class MvtFeature
+{
+public:
+	std::string layerName;
+	uint64_t id;
+	MvtGeomType type;
+	const unsigned char *tags, *tagsEnd; //Packed key and value numbers
+	std::vector<std::pair<const char *, size_t> > keys; //Of the layer
+	std::vector<class MvtValue> values; //Of the layer
+
+	MvtFeature();
+
+	///\return value of an attribute, or NULL if the feature does not have it
+	const class MvtValue *Find(const char *key) const;
+	///\return false if the attribute is missing or is not a string
+	bool GetString(const char *key, std::string &valueOut) const;
+	///\return false if the attribute is missing or is a string
+	bool GetNumber(const char *key, double &valueOut) const;
+};
+
+///How to draw a feature, filled in by the style callback
+class MvtStyle
+{
+public:
+	bool fill; //Fill polygons with shapeProperties
+	bool outline; //Stroke the rings of polygons with lineProperties
+	bool stroke; //Draw lines with lineProperties
+	class ShapeProperties shapeProperties;
+	class LineProperties lineProperties;
+	std::string label; //Drawn at each point with textProperties, if not empty
+	class TextProperties textProperties;
+
+	MvtStyle();
+};
+
+///Choose the style of a feature. styleOut starts as the default MvtStyle.
+///\return false to skip the feature
+typedef bool (*MvtStyleCallback)(const class MvtFeature &feature, class MvtStyle &styleOut, void *userData);
+
+///Decode Mapbox Vector Tiles straight into the commands of a store.
+///https://github.com/mapbox/vector-tile-spec/tree/master/2.1
+///Geometry is read from the protobuf data into the rings of the commands
+///without building feature objects. Consecutive features with the same
+///style share one command, so their fills are drawn before their outlines.
+class MvtDecoder
+{
+protected:
+	class LocalStore &store;
+	MvtStyleCallback styleCallback;
+	void *userData;
+	class MvtFeature feature;
+	class MvtStyle style;
+	size_t featurePolygons; //Polygons of the pending command that belong to the current feature
+	class DrawPolygonsCmd *pendingPolygons;
+	class DrawLinesCmd *pendingLines;
+	class DrawTextCmd *pendingText;
+	Contour ring; //Working space for the ring being read
+	class AffineTransform layerTransform; //From the units of the current layer
+
+	void DecodeLayer(const unsigned char *data, const unsigned char *end);
+	void DecodeFeature(const unsigned char *data, const unsigned char *end);
+	void AddGeometry(const unsigned char *geometry, const unsigned char *end);
+	void FinishRing(double area, bool closed);
+	void AddPoint(double x, double y);
+	void PrepareCmds(bool polygons, bool lines, bool text);
+	void Flush();
+
+public:
+	///Maps tile coordinates, after scaling the layer extent to one, to the
+	///coordinates of the store. Defaults to a 256 unit square.
+	class AffineTransform transform;
+
+	MvtDecoder(class LocalStore &store, MvtStyleCallback styleCallback, void *userData = NULL);
+	virtual ~MvtDecoder();
+
+	///Decode a tile held in memory, such as a memory mapped file. Throws
+	///std::runtime_error if the tile is malformed, keeping what was added before.
+	void Decode(const char *data, size_t size);
+	///Decode a tile file, which is memory mapped while it is read
+	void DecodeFile(const char *filename);
+};
+
+void MvtDecoderTests();
+
+#endif //_MVT_DECODER_H
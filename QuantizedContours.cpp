@@ -0,0 +1,289 @@
+//Fixed point storage of polygon rings and lines. A Point takes 16 bytes, but
+//differences between neighbouring points at a fraction of a pixel usually fit
+//in 16 bits, so a point takes 4 bytes, or 8 bytes for coarser data.
+
+#include "drawlib.h"
+#include <math.h>
+#include <limits>
+#include <stdexcept>
+#include <iostream>
+#include <assert.h>
+using namespace std;
+
+QuantizedContours::QuantizedContours() : originX(0.0), originY(0.0), step(0.0),
+	x1(0.0), y1(0.0), x2(0.0), y2(0.0)
+{}
+
+QuantizedContours::~QuantizedContours()
+{}
+
+void QuantizedContours::Clear()
+{
+	originX = 0.0; originY = 0.0; step = 0.0;
+	x1 = 0.0; y1 = 0.0; x2 = 0.0; y2 = 0.0;
+	//Swap to release the memory, which clear does not
+	std::vector<unsigned int>().swap(ringSizes);
+	std::vector<unsigned int>().swap(polygonRings);
+	std::vector<int16_t>().swap(deltas16);
+	std::vector<int32_t>().swap(deltas32);
+}
+
+bool QuantizedContours::Empty() const
+{
+	return ringSizes.size() == 0;
+}
+
+size_t QuantizedContours::NumPoints() const
+{
+	if(deltas16.size() > 0)
+		return deltas16.size() / 2;
+	return deltas32.size() / 2;
+}
+
+size_t QuantizedContours::MemoryBytes() const
+{
+	return ringSizes.capacity() * sizeof(unsigned int) + polygonRings.capacity() * sizeof(unsigned int)
+		+ deltas16.capacity() * sizeof(int16_t) + deltas32.capacity() * sizeof(int32_t);
+}
+
+///Quantize rings in order into q, which must be empty except for polygonRings
+static bool QuantizeRings(const std::vector<const Contour *> &rings, double step, class QuantizedContours &q)
+{
+	if(!(step > 0.0))
+		throw invalid_argument("Quantization step must be positive");
+
+	double bx1 = 0.0, by1 = 0.0, bx2 = 0.0, by2 = 0.0;
+	size_t numPoints = 0;
+	for(size_t i=0;i < rings.size(); i++)
+	{
+		const Contour &ring = *rings[i];
+		for(size_t j=0;j < ring.size(); j++)
+		{
+			const Point &pt = ring[j];
+			if(numPoints == 0 || pt.first < bx1) bx1 = pt.first;
+			if(numPoints == 0 || pt.first > bx2) bx2 = pt.first;
+			if(numPoints == 0 || pt.second < by1) by1 = pt.second;
+			if(numPoints == 0 || pt.second > by2) by2 = pt.second;
+			numPoints++;
+		}
+	}
+
+	//Every stored value is between zero and the span, so checking the span
+	//covers the differences too. This also rejects infinite and NaN values.
+	double maxUnits = (double)numeric_limits<int32_t>::max() - 1.0;
+	double spanX = (bx2 - bx1) / step, spanY = (by2 - by1) / step;
+	if(!(spanX < maxUnits && spanY < maxUnits))
+		return false;
+
+	q.step = step;
+	q.originX = bx1;
+	q.originY = by1;
+	q.ringSizes.resize(rings.size());
+	q.deltas32.resize(numPoints * 2);
+	bool fits16 = true;
+	int32_t prevX = 0, prevY = 0, maxX = 0, maxY = 0;
+	size_t k = 0;
+	for(size_t i=0;i < rings.size(); i++)
+	{
+		const Contour &ring = *rings[i];
+		q.ringSizes[i] = ring.size();
+		for(size_t j=0;j < ring.size(); j++)
+		{
+			int32_t x = (int32_t)floor((ring[j].first - bx1) / step + 0.5);
+			int32_t y = (int32_t)floor((ring[j].second - by1) / step + 0.5);
+			int32_t dx = x - prevX, dy = y - prevY;
+			if(dx < numeric_limits<int16_t>::min() || dx > numeric_limits<int16_t>::max()
+				|| dy < numeric_limits<int16_t>::min() || dy > numeric_limits<int16_t>::max())
+				fits16 = false;
+			q.deltas32[k++] = dx;
+			q.deltas32[k++] = dy;
+			prevX = x; prevY = y;
+			maxX = max(maxX, x); maxY = max(maxY, y);
+		}
+	}
+
+	//Bounds of the stored points, which may be up to half a step outside the originals
+	q.x1 = bx1; q.y1 = by1;
+	q.x2 = bx1 + maxX * step; q.y2 = by1 + maxY * step;
+
+	if(fits16)
+	{
+		q.deltas16.assign(q.deltas32.begin(), q.deltas32.end());
+		std::vector<int32_t>().swap(q.deltas32);
+	}
+	return true;
+}
+
+bool QuantizedContours::Quantize(const std::vector<Polygon> &polygons, double step)
+{
+	this->Clear();
+	std::vector<const Contour *> rings;
+	this->polygonRings.resize(polygons.size());
+	for(size_t i=0;i < polygons.size(); i++)
+	{
+		rings.push_back(&polygons[i].first);
+		for(size_t j=0;j < polygons[i].second.size(); j++)
+			rings.push_back(&polygons[i].second[j]);
+		this->polygonRings[i] = polygons[i].second.size() + 1;
+	}
+	if(!QuantizeRings(rings, step, *this))
+	{
+		this->Clear();
+		return false;
+	}
+	return true;
+}
+
+bool QuantizedContours::Quantize(const Contours &lines, double step)
+{
+	this->Clear();
+	std::vector<const Contour *> rings;
+	for(size_t i=0;i < lines.size(); i++)
+		rings.push_back(&lines[i]);
+	if(!QuantizeRings(rings, step, *this))
+	{
+		this->Clear();
+		return false;
+	}
+	return true;
+}
+
+///Expand the next ring, continuing the running position from the ring before
+template <class T> static void DequantizeRing(const class QuantizedContours &q, const std::vector<T> &deltas,
+	size_t &pos, int32_t &x, int32_t &y, size_t numPoints, Contour &ringOut)
+{
+	ringOut.resize(numPoints);
+	for(size_t i=0;i < numPoints; i++)
+	{
+		x += deltas[pos++];
+		y += deltas[pos++];
+		ringOut[i].first = q.originX + x * q.step;
+		ringOut[i].second = q.originY + y * q.step;
+	}
+}
+
+template <class T> static void DequantizePolygons(const class QuantizedContours &q, const std::vector<T> &deltas,
+	std::vector<Polygon> &polygonsOut)
+{
+	size_t pos = 0, ring = 0;
+	int32_t x = 0, y = 0;
+	polygonsOut.resize(q.polygonRings.size());
+	for(size_t i=0;i < q.polygonRings.size(); i++)
+	{
+		Polygon &polygon = polygonsOut[i];
+		DequantizeRing(q, deltas, pos, x, y, q.ringSizes[ring++], polygon.first);
+		polygon.second.resize(q.polygonRings[i] - 1);
+		for(size_t j=0;j < polygon.second.size(); j++)
+			DequantizeRing(q, deltas, pos, x, y, q.ringSizes[ring++], polygon.second[j]);
+	}
+}
+
+template <class T> static void DequantizeLines(const class QuantizedContours &q, const std::vector<T> &deltas,
+	Contours &linesOut)
+{
+	size_t pos = 0;
+	int32_t x = 0, y = 0;
+	linesOut.resize(q.ringSizes.size());
+	for(size_t i=0;i < q.ringSizes.size(); i++)
+		DequantizeRing(q, deltas, pos, x, y, q.ringSizes[i], linesOut[i]);
+}
+
+void QuantizedContours::Dequantize(std::vector<Polygon> &polygonsOut) const
+{
+	if(deltas16.size() > 0)
+		DequantizePolygons(*this, deltas16, polygonsOut);
+	else
+		DequantizePolygons(*this, deltas32, polygonsOut);
+}
+
+void QuantizedContours::Dequantize(Contours &linesOut) const
+{
+	if(deltas16.size() > 0)
+		DequantizeLines(*this, deltas16, linesOut);
+	else
+		DequantizeLines(*this, deltas32, linesOut);
+}
+
+// *************************************
+
+///Largest distance along either axis between matching points of two sets of rings
+static double MaxRingError(const Contours &a, const Contours &b)
+{
+	assert(a.size() == b.size());
+	double maxError = 0.0;
+	for(size_t i=0;i < a.size(); i++)
+	{
+		assert(a[i].size() == b[i].size());
+		for(size_t j=0;j < a[i].size(); j++)
+		{
+			maxError = max(maxError, fabs(a[i][j].first - b[i][j].first));
+			maxError = max(maxError, fabs(a[i][j].second - b[i][j].second));
+		}
+	}
+	return maxError;
+}
+
+void QuantizedContoursTests()
+{
+	// ** Polygons round trip within half a step, in 16 bits **
+	std::vector<Polygon> polygons(2);
+	for(int i = 0; i < 50; i++)
+		polygons[0].first.push_back(Point(100.0 + 40.0 * cos(i * 0.1257), -20.0 + 40.0 * sin(i * 0.1257)));
+	polygons[0].second.resize(1);
+	for(int i = 0; i < 10; i++)
+		polygons[0].second[0].push_back(Point(100.0 + 5.0 * cos(i * 0.628), -20.0 - 5.0 * sin(i * 0.628)));
+	polygons[1].first.push_back(Point(300.3, 0.1));
+	polygons[1].first.push_back(Point(310.7, 0.1));
+	polygons[1].first.push_back(Point(305.5, 9.9));
+
+	class QuantizedContours q;
+	double step = 1.0 / 16.0;
+	assert(q.Quantize(polygons, step));
+	assert(!q.Empty() && q.NumPoints() == 63);
+	assert(q.deltas16.size() == 126 && q.deltas32.size() == 0);
+	std::vector<Polygon> expanded;
+	q.Dequantize(expanded);
+	assert(expanded.size() == 2);
+	assert(expanded[0].second.size() == 1 && expanded[1].second.size() == 0);
+	Contours rings, expandedRings;
+	for(size_t i=0;i < polygons.size(); i++)
+	{
+		rings.push_back(polygons[i].first);
+		rings.insert(rings.end(), polygons[i].second.begin(), polygons[i].second.end());
+		expandedRings.push_back(expanded[i].first);
+		expandedRings.insert(expandedRings.end(), expanded[i].second.begin(), expanded[i].second.end());
+	}
+	double error = MaxRingError(rings, expandedRings);
+	cout << "quantized error " << error << " bytes " << q.MemoryBytes() << endl;
+	assert(error <= step * 0.5 + 1e-9);
+
+	// ** Differences too large for 16 bits switch to 32 bits **
+	Contours lines(2);
+	lines[0].push_back(Point(0.0, 0.0));
+	lines[0].push_back(Point(5000.25, 1.0));
+	lines[1].push_back(Point(-3000.0, 2500.5));
+	lines[1].push_back(Point(-2999.0, 2500.0));
+	step = 0.125;
+	assert(q.Quantize(lines, step));
+	assert(q.polygonRings.size() == 0 && q.ringSizes.size() == 2);
+	assert(q.deltas16.size() == 0 && q.deltas32.size() == 8);
+	Contours expandedLines;
+	q.Dequantize(expandedLines);
+	assert(MaxRingError(lines, expandedLines) <= step * 0.5 + 1e-9);
+
+	// ** Too fine a step is refused, leaving nothing stored **
+	assert(!q.Quantize(lines, 1e-6));
+	assert(q.Empty() && q.NumPoints() == 0);
+	lines[0][1].first = numeric_limits<double>::infinity();
+	assert(!q.Quantize(lines, 1.0));
+	bool thrown = false;
+	try
+	{
+		q.Quantize(lines, 0.0);
+	}
+	catch(invalid_argument &)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+}
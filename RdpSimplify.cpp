@@ -6,36 +6,57 @@
 #include <utility>
 #include <vector>
 #include <stdexcept>
+#include <algorithm>
+#include <assert.h>
 #include "RdpSimplify.h"
+#include "WorkStealingPool.h"
 using namespace std;
 
-double PerpendicularDistance(const Point &pt, const Point &lineStart, const Point &lineEnd)
+/** Find the point between first and last (exclusive) that is furthest from
+	the line between them. Distances are compared as the squared cross product
+	with the chord direction, which is the squared perpendicular distance scaled by
+	the squared chord length. This avoids any square root or division in the loop.
+	\return index of furthest point, or first if there are no points in between
+*/
+static size_t FurthestFromChord(const Point *pts, size_t first, size_t last,
+	double &scaledDist2Out, double &chordLen2Out)
 {
-	double dx = lineEnd.first - lineStart.first;
-	double dy = lineEnd.second - lineStart.second;
+	const double x0 = pts[first].first;
+	const double y0 = pts[first].second;
+	const double dx = pts[last].first - x0;
+	const double dy = pts[last].second - y0;
+	const double chordLen2 = dx*dx + dy*dy;
 
-	//Normalise
-	double mag = pow(pow(dx,2.0)+pow(dy,2.0),0.5);
-	if(mag > 0.0)
+	double dmax = 0.0;
+	size_t index = first;
+	if(chordLen2 > 0.0)
 	{
-		dx /= mag; dy /= mag;
+		for(size_t i = first+1; i < last; i++)
+		{
+			double cross = dx * (pts[i].second - y0) - dy * (pts[i].first - x0);
+			double d = cross * cross;
+			bool better = d > dmax;
+			dmax = better ? d : dmax;
+			index = better ? i : index;
+		}
+	}
+	else
+	{
+		//Start and end coincide, so use distance from the start point
+		for(size_t i = first+1; i < last; i++)
+		{
+			double pvx = pts[i].first - x0;
+			double pvy = pts[i].second - y0;
+			double d = pvx * pvx + pvy * pvy;
+			bool better = d > dmax;
+			dmax = better ? d : dmax;
+			index = better ? i : index;
+		}
 	}
 
-	double pvx = pt.first - lineStart.first;
-	double pvy = pt.second - lineStart.second;
-
-	//Get dot product (project pv onto normalized direction)
-	double pvdot = dx * pvx + dy * pvy;
-
-	//Scale line direction vector
-	double dsx = pvdot * dx;
-	double dsy = pvdot * dy;
-
-	//Subtract this from pv
-	double ax = pvx - dsx;
-	double ay = pvy - dsy;
-
-	return pow(pow(ax,2.0)+pow(ay,2.0),0.5);
+	scaledDist2Out = dmax;
+	chordLen2Out = chordLen2;
+	return index;
 }
 
 void RamerDouglasPeucker(const Contour &pointList, double epsilon, Contour &out)
@@ -43,43 +64,197 @@ void RamerDouglasPeucker(const Contour &pointList, double epsilon, Contour &out)
 	if(pointList.size()<2)
 		throw invalid_argument("Not enough points to simplify");
 
-	// Find the point with the maximum distance from line between start and end
-	double dmax = 0.0;
-	size_t index = 0;
-	size_t end = pointList.size()-1;
-	for(size_t i = 1; i < end; i++)
+	const size_t n = pointList.size();
+	const Point *pts = &pointList[0];
+	double eps2 = epsilon > 0.0 ? epsilon * epsilon : 0.0;
+
+	//Mark points to keep, processing sections from an explicit stack
+	vector<bool> keep(n, false);
+	keep[0] = true;
+	keep[n-1] = true;
+	size_t keepCount = 2;
+
+	vector<pair<size_t, size_t> > stack;
+	stack.push_back(pair<size_t, size_t>(0, n-1));
+	while(stack.size() > 0)
 	{
-		double d = PerpendicularDistance(pointList[i], pointList[0], pointList[end]);
-		if (d > dmax)
+		size_t first = stack.back().first;
+		size_t last = stack.back().second;
+		stack.pop_back();
+		if(last - first < 2)
+			continue;
+
+		double dist2 = 0.0, chordLen2 = 0.0;
+		size_t index = FurthestFromChord(pts, first, last, dist2, chordLen2);
+
+		// If max distance is greater than epsilon, split at that point
+		double limit = chordLen2 > 0.0 ? eps2 * chordLen2 : eps2;
+		if(index != first && dist2 > limit)
 		{
-			index = i;
-			dmax = d;
+			keep[index] = true;
+			keepCount++;
+			stack.push_back(pair<size_t, size_t>(index, last));
+			stack.push_back(pair<size_t, size_t>(first, index));
 		}
 	}
 
-	// If max distance is greater than epsilon, recursively simplify
-	if(dmax > epsilon)
+	// Build the result list
+	if(&out == &pointList)
 	{
-		// Recursive call
-		vector<Point> recResults1;
-		vector<Point> recResults2;
-		vector<Point> firstLine(pointList.begin(), pointList.begin()+index+1);
-		vector<Point> lastLine(pointList.begin()+index, pointList.end());
-		RamerDouglasPeucker(firstLine, epsilon, recResults1);
-		RamerDouglasPeucker(lastLine, epsilon, recResults2);
- 
-		// Build the result list
-		out.assign(recResults1.begin(), recResults1.end()-1);
-		out.insert(out.end(), recResults2.begin(), recResults2.end());
-		if(out.size()<2)
-			throw runtime_error("Problem assembling output");
-	} 
-	else 
+		//Compact in place
+		size_t j = 0;
+		for(size_t i = 0; i < n; i++)
+			if(keep[i])
+				out[j++] = out[i];
+		out.resize(j);
+	}
+	else
 	{
-		//Just return start and end points
 		out.clear();
-		out.push_back(pointList[0]);
-		out.push_back(pointList[end]);
+		out.reserve(keepCount);
+		for(size_t i = 0; i < n; i++)
+			if(keep[i])
+				out.push_back(pts[i]);
+	}
+}
+
+// ****************************************
+
+///Check if every point lies within epsilon of the first point, in which case
+///simplification can only leave the end points
+static bool WithinTolerance(const Contour &contour, double epsilon)
+{
+	double eps2 = epsilon * epsilon;
+	double x0 = contour[0].first;
+	double y0 = contour[0].second;
+	for(size_t i = 1; i < contour.size(); i++)
+	{
+		double dx = contour[i].first - x0;
+		double dy = contour[i].second - y0;
+		if(dx*dx + dy*dy > eps2)
+			return false;
+	}
+	return true;
+}
+
+class RdpBatchJob
+{
+public:
+	const std::vector<Contour *> *contours;
+	double epsilon;
+};
+
+static void RdpBatchTask(size_t taskId, int, void *userData)
+{
+	class RdpBatchJob *job = (class RdpBatchJob *)userData;
+	Contour &contour = *(*job->contours)[taskId];
+
+	if(WithinTolerance(contour, job->epsilon))
+	{
+		//Same result as the full algorithm, without the bookkeeping
+		contour[1] = contour[contour.size()-1];
+		contour.resize(2);
+		return;
+	}
+	RamerDouglasPeucker(contour, job->epsilon, contour);
+}
+
+static bool LargerContourFirst(const pair<size_t, size_t> &a, const pair<size_t, size_t> &b)
+{
+	return a.first > b.first;
+}
+
+void RamerDouglasPeuckerBatch(const std::vector<Contour *> &contours, double epsilon, class WorkStealingPool *pool)
+{
+	//Largest contours are scheduled first so that a single huge one does
+	//not start last and hold up the batch
+	vector<pair<size_t, size_t> > sizes;
+	for(size_t i = 0; i < contours.size(); i++)
+		if(contours[i]->size() > 2)
+			sizes.push_back(pair<size_t, size_t>(contours[i]->size(), i));
+	if(sizes.size() == 0)
+		return;
+	stable_sort(sizes.begin(), sizes.end(), LargerContourFirst);
+
+	vector<size_t> taskIds;
+	taskIds.reserve(sizes.size());
+	for(size_t i = 0; i < sizes.size(); i++)
+		taskIds.push_back(sizes[i].second);
+
+	class RdpBatchJob job;
+	job.contours = &contours;
+	job.epsilon = epsilon;
+
+	if(pool != NULL)
+		pool->Run(taskIds, RdpBatchTask, &job);
+	else
+	{
+		class WorkStealingPool tmpPool;
+		tmpPool.Run(taskIds, RdpBatchTask, &job);
 	}
 }
 
+void RamerDouglasPeuckerBatch(Contours &contours, double epsilon, class WorkStealingPool *pool)
+{
+	vector<Contour *> ptrs;
+	ptrs.reserve(contours.size());
+	for(size_t i = 0; i < contours.size(); i++)
+		ptrs.push_back(&contours[i]);
+	RamerDouglasPeuckerBatch(ptrs, epsilon, pool);
+}
+
+void RamerDouglasPeuckerTests()
+{
+	// ** Noisy line with one corner **
+	Contour line;
+	line.push_back(Point(0.0, 0.0));
+	line.push_back(Point(1.0, 0.01));
+	line.push_back(Point(2.0, -0.01));
+	line.push_back(Point(3.0, 0.0));
+	line.push_back(Point(3.01, 1.0));
+	line.push_back(Point(2.99, 2.0));
+	line.push_back(Point(3.0, 3.0));
+
+	Contour out;
+	RamerDouglasPeucker(line, 0.1, out);
+	cout << "rdp points " << out.size() << endl;
+	assert(out.size() == 3);
+	assert(out[0] == line[0]);
+	assert(out[1] == line[3]);
+	assert(out[2] == line[6]);
+
+	// ** Zero tolerance keeps every point off a straight line **
+	RamerDouglasPeucker(line, 0.0, out);
+	assert(out.size() == line.size());
+
+	// ** Closed ring where start and end coincide **
+	Contour ring;
+	ring.push_back(Point(0.0, 0.0));
+	ring.push_back(Point(5.0, 0.01));
+	ring.push_back(Point(10.0, 0.0));
+	ring.push_back(Point(10.0, 10.0));
+	ring.push_back(Point(0.0, 10.0));
+	ring.push_back(Point(0.0, 0.0));
+	RamerDouglasPeucker(ring, 0.5, out);
+	assert(out.size() == 5);
+	assert(out[1] == ring[2]);
+
+	// ** Simplify in place **
+	Contour inPlace(line);
+	RamerDouglasPeucker(inPlace, 1.0, inPlace);
+	assert(inPlace.size() == 3);
+	assert(inPlace[1] == line[3]);
+
+	// ** Batch simplification matches single calls **
+	Contours batch;
+	batch.push_back(line);
+	batch.push_back(ring);
+	batch.push_back(Contour(1, Point(1.0, 1.0)));
+	class WorkStealingPool pool(2);
+	RamerDouglasPeuckerBatch(batch, 0.5, &pool);
+	RamerDouglasPeucker(line, 0.5, out);
+	assert(batch[0] == out);
+	RamerDouglasPeucker(ring, 0.5, out);
+	assert(batch[1] == out);
+	assert(batch[2].size() == 1);
+}
@@ -2,7 +2,16 @@
 #define _RDP_SIMPLIFY_H
 #include "drawlib.h"
 
+///Simplify a line to within epsilon of the original. out may be the same object as pointList.
 void RamerDouglasPeucker(const Contour &pointList, double epsilon, Contour &out);
 
+///Simplify many contours in place, spread over a thread pool. Contours with
+///fewer than three points are left alone. If pool is NULL, a temporary pool
+///is created for the call.
+void RamerDouglasPeuckerBatch(const std::vector<Contour *> &contours, double epsilon, class WorkStealingPool *pool = NULL);
+void RamerDouglasPeuckerBatch(Contours &contours, double epsilon, class WorkStealingPool *pool = NULL);
+
+void RamerDouglasPeuckerTests();
+
 #endif //_RDP_SIMPLIFY_H
 
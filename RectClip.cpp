@@ -0,0 +1,214 @@
+//Clipping of geometry to rectangles, so that only visible parts are drawn
+//https://en.wikipedia.org/wiki/Sutherland%E2%80%93Hodgman_algorithm
+//https://en.wikipedia.org/wiki/Liang%E2%80%93Barsky_algorithm
+
+#include <vector>
+#include "RectClip.h"
+using namespace std;
+
+enum ClipEdge
+{
+	CLIP_LEFT,
+	CLIP_RIGHT,
+	CLIP_TOP,
+	CLIP_BOTTOM
+};
+
+inline bool InsideEdge(const Point &pt, ClipEdge edge, double value)
+{
+	switch(edge)
+	{
+	case CLIP_LEFT: return pt.first >= value;
+	case CLIP_RIGHT: return pt.first <= value;
+	case CLIP_TOP: return pt.second >= value;
+	default: return pt.second <= value;
+	}
+}
+
+inline Point EdgeIntersect(const Point &a, const Point &b, ClipEdge edge, double value)
+{
+	if(edge == CLIP_LEFT || edge == CLIP_RIGHT)
+	{
+		double t = (value - a.first) / (b.first - a.first);
+		return Point(value, a.second + t * (b.second - a.second));
+	}
+	double t = (value - a.second) / (b.second - a.second);
+	return Point(a.first + t * (b.first - a.first), value);
+}
+
+///Clip a closed ring against one edge of the rectangle
+static void ClipRingToEdge(const Contour &in, ClipEdge edge, double value, Contour &out)
+{
+	out.clear();
+	size_t n = in.size();
+	if(n == 0)
+		return;
+
+	const Point *prev = &in[n-1];
+	bool prevInside = InsideEdge(*prev, edge, value);
+	for(size_t i = 0; i < n; i++)
+	{
+		const Point &cur = in[i];
+		bool curInside = InsideEdge(cur, edge, value);
+		if(curInside != prevInside)
+			out.push_back(EdgeIntersect(*prev, cur, edge, value));
+		if(curInside)
+			out.push_back(cur);
+		prev = &cur;
+		prevInside = curInside;
+	}
+}
+
+///Find the range of the segment a to b within the rectangle, as fractions along the segment
+///\return false if no part is inside
+static bool LiangBarsky(const Point &a, const Point &b, double x1, double y1, double x2, double y2,
+	double &t0Out, double &t1Out)
+{
+	double dx = b.first - a.first;
+	double dy = b.second - a.second;
+	double p[4] = {-dx, dx, -dy, dy};
+	double q[4] = {a.first - x1, x2 - a.first, a.second - y1, y2 - a.second};
+	double t0 = 0.0, t1 = 1.0;
+	for(int i = 0; i < 4; i++)
+	{
+		if(p[i] == 0.0)
+		{
+			if(q[i] < 0.0)
+				return false; //Parallel and outside
+			continue;
+		}
+		double r = q[i] / p[i];
+		if(p[i] < 0.0)
+		{
+			if(r > t1) return false;
+			if(r > t0) t0 = r;
+		}
+		else
+		{
+			if(r < t0) return false;
+			if(r < t1) t1 = r;
+		}
+	}
+	t0Out = t0;
+	t1Out = t1;
+	return true;
+}
+
+inline Point Lerp(const Point &a, const Point &b, double t)
+{
+	return Point(a.first + t * (b.first - a.first), a.second + t * (b.second - a.second));
+}
+
+bool ClipRingToRect(const Contour &ring, double x1, double y1, double x2, double y2,
+	Contour &out, Contour &scratch)
+{
+	if(ring.size() == 0)
+		return false;
+
+	double minx = ring[0].first, maxx = minx;
+	double miny = ring[0].second, maxy = miny;
+	for(size_t i = 1; i < ring.size(); i++)
+	{
+		const Point &pt = ring[i];
+		if(pt.first < minx) minx = pt.first;
+		if(pt.first > maxx) maxx = pt.first;
+		if(pt.second < miny) miny = pt.second;
+		if(pt.second > maxy) maxy = pt.second;
+	}
+
+	if(minx >= x1 && maxx <= x2 && miny >= y1 && maxy <= y2)
+		return false; //Entirely inside
+	if(maxx < x1 || minx > x2 || maxy < y1 || miny > y2)
+	{
+		out.clear(); //Entirely outside
+		return true;
+	}
+
+	//Only clip against the edges the ring crosses
+	const Contour *current = &ring;
+	Contour *buffers[2] = {&out, &scratch};
+	int next = 0;
+	if(minx < x1)
+	{
+		ClipRingToEdge(*current, CLIP_LEFT, x1, *buffers[next]);
+		current = buffers[next]; next = 1 - next;
+	}
+	if(maxx > x2)
+	{
+		ClipRingToEdge(*current, CLIP_RIGHT, x2, *buffers[next]);
+		current = buffers[next]; next = 1 - next;
+	}
+	if(miny < y1)
+	{
+		ClipRingToEdge(*current, CLIP_TOP, y1, *buffers[next]);
+		current = buffers[next]; next = 1 - next;
+	}
+	if(maxy > y2)
+	{
+		ClipRingToEdge(*current, CLIP_BOTTOM, y2, *buffers[next]);
+		current = buffers[next]; next = 1 - next;
+	}
+
+	if(current != &out)
+		out.swap(scratch);
+	return true;
+}
+
+bool ClipLineToRect(const Contour &line, bool closedLoop, double x1, double y1, double x2, double y2,
+	Contours &piecesOut)
+{
+	size_t n = line.size();
+	if(n == 0)
+		return false;
+
+	double minx = line[0].first, maxx = minx;
+	double miny = line[0].second, maxy = miny;
+	for(size_t i = 1; i < n; i++)
+	{
+		const Point &pt = line[i];
+		if(pt.first < minx) minx = pt.first;
+		if(pt.first > maxx) maxx = pt.first;
+		if(pt.second < miny) miny = pt.second;
+		if(pt.second > maxy) maxy = pt.second;
+	}
+
+	piecesOut.clear();
+	if(minx >= x1 && maxx <= x2 && miny >= y1 && maxy <= y2)
+		return false; //Entirely inside
+	if(maxx < x1 || minx > x2 || maxy < y1 || miny > y2 || n < 2)
+		return true; //Entirely outside
+
+	size_t numSegs = closedLoop ? n : n-1;
+	bool pieceOpen = false;
+	for(size_t i = 0; i < numSegs; i++)
+	{
+		const Point &a = line[i];
+		const Point &b = line[(i+1) % n];
+		double t0 = 0.0, t1 = 1.0;
+		if(!LiangBarsky(a, b, x1, y1, x2, y2, t0, t1))
+		{
+			pieceOpen = false;
+			continue;
+		}
+
+		if(!pieceOpen || t0 > 0.0)
+		{
+			piecesOut.push_back(Contour());
+			piecesOut.back().push_back(t0 > 0.0 ? Lerp(a, b, t0) : a);
+			pieceOpen = true;
+		}
+		piecesOut.back().push_back(t1 < 1.0 ? Lerp(a, b, t1) : b);
+		if(t1 < 1.0)
+			pieceOpen = false;
+	}
+
+	//Join the piece that runs into the first point of a loop with the one leaving it
+	if(closedLoop && pieceOpen && piecesOut.size() > 1 && piecesOut[0][0] == line[0])
+	{
+		Contour &last = piecesOut.back();
+		last.insert(last.end(), piecesOut[0].begin()+1, piecesOut[0].end());
+		piecesOut[0].swap(last);
+		piecesOut.pop_back();
+	}
+	return true;
+}
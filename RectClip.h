@@ -0,0 +1,20 @@
+#ifndef _RECT_CLIP_H
+#define _RECT_CLIP_H
+#include "drawlib.h"
+
+///Clip a closed ring to the rectangle x1,y1 to x2,y2 using Sutherland-Hodgman.
+///Ring orientation is kept. scratch is working space that can be reused between calls.
+///\return false if the ring is entirely inside so it can be used unchanged, true
+///if the clipped ring was written to out (which is empty if nothing is inside)
+bool ClipRingToRect(const Contour &ring, double x1, double y1, double x2, double y2,
+	Contour &out, Contour &scratch);
+
+///Clip a line to a rectangle using Liang-Barsky, splitting it into the pieces
+///that are inside. If closedLoop is set, the segment from the last point back to
+///the first is included, and pieces are joined where they meet at the first point.
+///\return false if the line is entirely inside so it can be used unchanged, true
+///if the visible pieces were written to piecesOut (which is empty if nothing is inside)
+bool ClipLineToRect(const Contour &line, bool closedLoop, double x1, double y1, double x2, double y2,
+	Contours &piecesOut);
+
+#endif //_RECT_CLIP_H
@@ -0,0 +1,220 @@
+#include "RenderQueue.h"
+#include "drawlibcairo.h"
+#include "DrawStats.h"
+#include <stdexcept>
+using namespace std;
+
+RenderResult::RenderResult() : surface(NULL), queuedSeconds(0.0), drawSeconds(0.0)
+{}
+
+// *************************************
+
+RenderQueue::RenderQueue(int numThreads, size_t maxQueued) : maxQueued(maxQueued), stopping(false)
+{
+	if(numThreads <= 0)
+		numThreads = thread::hardware_concurrency();
+	if(numThreads <= 0)
+		numThreads = 1;
+	if(this->maxQueued < 1)
+		this->maxQueued = 1;
+
+	for(int i=0; i < numThreads; i++)
+		this->threads.push_back(thread(&RenderQueue::WorkerMain, this));
+}
+
+RenderQueue::~RenderQueue()
+{
+	{
+		unique_lock<mutex> lock(this->queueMutex);
+		this->stopping = true;
+	}
+	this->notEmpty.notify_all();
+	this->notFull.notify_all();
+	for(size_t i=0; i < this->threads.size(); i++)
+		this->threads[i].join();
+}
+
+void RenderQueue::WorkerMain()
+{
+	//Each worker keeps its back end, and the images it has loaded, between jobs.
+	//It draws on this surface while idle so finished surfaces are not kept alive.
+	class DrawLibCairoPango *drawLib = NULL;
+	cairo_surface_t *idleSurface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 1, 1);
+	while(true)
+	{
+		unique_lock<mutex> lock(this->queueMutex);
+		while(!this->stopping && this->jobs.size() == 0)
+			this->notEmpty.wait(lock);
+		if(this->jobs.size() == 0)
+			break; //Stopping and all jobs are done
+		class RenderJob *job = this->jobs.front();
+		this->jobs.pop_front();
+		lock.unlock();
+		this->notFull.notify_one();
+
+		this->Render(drawLib, *job);
+		if(drawLib != NULL)
+			drawLib->SetSurface(idleSurface);
+		delete job;
+	}
+	delete drawLib;
+	cairo_surface_destroy(idleSurface);
+}
+
+void RenderQueue::Render(class DrawLibCairoPango *&drawLib, class RenderJob &job)
+{
+	class RenderResult result;
+	double start = DrawStatsClock();
+	result.queuedSeconds = start - job.submitTime;
+	exception_ptr error;
+	try
+	{
+		result.surface = cairo_image_surface_create(job.format, job.width, job.height);
+		if(cairo_surface_status(result.surface) != CAIRO_STATUS_SUCCESS)
+			throw runtime_error("Creating cairo surface failed");
+		if(drawLib == NULL)
+			drawLib = new class DrawLibCairoPango(result.surface);
+		else
+			drawLib->SetSurface(result.surface);
+
+		//Draw the commands of the store without copying them
+		drawLib->SwapCmds(*job.store);
+		drawLib->Draw();
+		drawLib->ClearDrawingCmds();
+		cairo_surface_flush(result.surface);
+	}
+	catch(std::exception &err)
+	{
+		error = current_exception();
+		result.error = err.what();
+	}
+	catch(...)
+	{
+		error = current_exception();
+		result.error = "Unknown error";
+	}
+	if(error && result.surface != NULL)
+	{
+		if(drawLib != NULL)
+			drawLib->ClearDrawingCmds();
+		cairo_surface_destroy(result.surface);
+		result.surface = NULL;
+	}
+	delete job.store;
+	job.store = NULL;
+	result.drawSeconds = DrawStatsClock() - start;
+
+	if(job.callback != NULL)
+		job.callback(result, job.userData);
+	else if(error)
+		job.promise.set_exception(error);
+	else
+		job.promise.set_value(result);
+}
+
+class RenderQueue::RenderJob *RenderQueue::NewJob(class LocalStore *store, int width, int height, cairo_format_t format)
+{
+	if(store == NULL)
+		throw invalid_argument("Store is NULL");
+	if(width <= 0 || height <= 0)
+		throw invalid_argument("Surface size must be positive");
+	class RenderJob *job = new class RenderJob();
+	job->store = store;
+	job->width = width;
+	job->height = height;
+	job->format = format;
+	job->callback = NULL;
+	job->userData = NULL;
+	job->submitTime = DrawStatsClock();
+	return job;
+}
+
+///Add a job to the queue, waiting for room if wait is set
+///\return false if the queue is full and wait is not set
+bool RenderQueue::Enqueue(class RenderJob *job, bool wait)
+{
+	unique_lock<mutex> lock(this->queueMutex);
+	while(!this->stopping && this->jobs.size() >= this->maxQueued)
+	{
+		if(!wait)
+			return false;
+		this->notFull.wait(lock);
+	}
+	if(this->stopping)
+		throw runtime_error("Render queue is stopping");
+	this->jobs.push_back(job);
+	lock.unlock();
+	this->notEmpty.notify_one();
+	return true;
+}
+
+std::future<class RenderResult> RenderQueue::Submit(class LocalStore *store, int width, int height,
+	cairo_format_t format)
+{
+	class RenderJob *job = this->NewJob(store, width, height, format);
+	std::future<class RenderResult> future = job->promise.get_future();
+	try
+	{
+		this->Enqueue(job, true);
+	}
+	catch(...)
+	{
+		delete job;
+		throw;
+	}
+	return future;
+}
+
+void RenderQueue::Submit(class LocalStore *store, int width, int height, RenderCallback callback, void *userData,
+	cairo_format_t format)
+{
+	if(callback == NULL)
+		throw invalid_argument("Callback is NULL");
+	class RenderJob *job = this->NewJob(store, width, height, format);
+	job->callback = callback;
+	job->userData = userData;
+	try
+	{
+		this->Enqueue(job, true);
+	}
+	catch(...)
+	{
+		delete job;
+		throw;
+	}
+}
+
+bool RenderQueue::TrySubmit(class LocalStore *store, int width, int height, std::future<class RenderResult> &futureOut,
+	cairo_format_t format)
+{
+	class RenderJob *job = this->NewJob(store, width, height, format);
+	std::future<class RenderResult> future = job->promise.get_future();
+	bool queued = false;
+	try
+	{
+		queued = this->Enqueue(job, false);
+	}
+	catch(...)
+	{
+		delete job;
+		throw;
+	}
+	if(!queued)
+	{
+		delete job;
+		return false;
+	}
+	futureOut = std::move(future);
+	return true;
+}
+
+size_t RenderQueue::NumQueued()
+{
+	unique_lock<mutex> lock(this->queueMutex);
+	return this->jobs.size();
+}
+
+int RenderQueue::GetNumThreads() const
+{
+	return (int)this->threads.size();
+}
@@ -0,0 +1,84 @@
+#ifndef _RENDER_QUEUE_H
+#define _RENDER_QUEUE_H
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <cairo/cairo.h>
+#include "drawlib.h"
+
+///Outcome of drawing a store. The receiver owns the surface and must destroy it.
+class RenderResult
+{
+public:
+	cairo_surface_t *surface; //NULL if drawing failed
+	std::string error; //Set if drawing failed
+	double queuedSeconds; //Time from submission until a worker took the job
+	double drawSeconds;
+
+	RenderResult();
+};
+
+///Draw finished stores on a pool of threads, each with its own
+///DrawLibCairoPango, so the submitting thread never waits for rasterization.
+///The number of waiting jobs is bounded: Submit blocks and TrySubmit fails
+///while the queue is full, which keeps memory use and latency under control.
+class RenderQueue
+{
+public:
+	///Called on the worker thread when a job has been drawn
+	typedef void (*RenderCallback)(class RenderResult &result, void *userData);
+
+protected:
+	class RenderJob
+	{
+	public:
+		class LocalStore *store;
+		int width, height;
+		cairo_format_t format;
+		std::promise<class RenderResult> promise;
+		RenderCallback callback;
+		void *userData;
+		double submitTime;
+	};
+
+	std::vector<std::thread> threads;
+	std::deque<class RenderJob *> jobs;
+	std::mutex queueMutex;
+	std::condition_variable notEmpty, notFull;
+	size_t maxQueued;
+	bool stopping;
+
+	void WorkerMain();
+	void Render(class DrawLibCairoPango *&drawLib, class RenderJob &job);
+	class RenderJob *NewJob(class LocalStore *store, int width, int height, cairo_format_t format);
+	bool Enqueue(class RenderJob *job, bool wait);
+
+public:
+	///numThreads of zero or less uses the hardware concurrency
+	RenderQueue(int numThreads = 0, size_t maxQueued = 16);
+	///Draws any jobs still queued, then stops the workers
+	virtual ~RenderQueue();
+
+	///Queue a store to be drawn on a new image surface, waiting while the
+	///queue is full. The queue takes ownership of the store and deletes it,
+	///unless an exception is thrown here.
+	std::future<class RenderResult> Submit(class LocalStore *store, int width, int height,
+		cairo_format_t format = CAIRO_FORMAT_ARGB32);
+	///As Submit, but with the result passed to callback on the worker thread
+	void Submit(class LocalStore *store, int width, int height, RenderCallback callback, void *userData,
+		cairo_format_t format = CAIRO_FORMAT_ARGB32);
+	///As Submit, but fail without taking the store if the queue is full
+	///\return false if the job was not queued
+	bool TrySubmit(class LocalStore *store, int width, int height, std::future<class RenderResult> &futureOut,
+		cairo_format_t format = CAIRO_FORMAT_ARGB32);
+
+	size_t NumQueued();
+	int GetNumThreads() const;
+};
+
+#endif //_RENDER_QUEUE_H
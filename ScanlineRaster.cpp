@@ -0,0 +1,549 @@
+//Antialiased polygon rasterization by signed area accumulation, as in
+//https://github.com/raphlinus/font-rs and stb_truetype, with the dense
+//accumulation buffer replaced by sparse cells so that spans between
+//edges can be filled in bulk.
+
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <assert.h>
+#include <stdint.h>
+#include "ScanlineRaster.h"
+#include "CpuFeatures.h"
+#ifdef DRAWLIB_X86_SIMD
+#include <immintrin.h>
+#endif
+using namespace std;
+
+static const double RASTER_MIN_COVERAGE = 0.5 / 255.0;
+
+ScanlineRasterizer::ScanlineRasterizer() : clipX1(0), clipY1(0), clipX2(0), clipY2(0),
+	minRow(0), maxRow(-1)
+{}
+
+ScanlineRasterizer::~ScanlineRasterizer()
+{}
+
+void ScanlineRasterizer::Reset(int x1, int y1, int x2, int y2)
+{
+	for(int row = this->minRow; row <= this->maxRow; row++)
+		this->rows[row].clear();
+	this->clipX1 = x1;
+	this->clipY1 = y1;
+	this->clipX2 = max(x1, x2);
+	this->clipY2 = max(y1, y2);
+	if(this->rows.size() < (size_t)(this->clipY2 - this->clipY1))
+		this->rows.resize(this->clipY2 - this->clipY1);
+	this->minRow = this->clipY2 - this->clipY1;
+	this->maxRow = -1;
+}
+
+void ScanlineRasterizer::AddRing(const Point *pts, size_t count, int orientation)
+{
+	if(count < 2)
+		return;
+
+	bool reverse = false;
+	if(orientation != 0)
+	{
+		double area2 = 0.0;
+		for(size_t i = 0, j = count-1; i < count; j = i++)
+			area2 += (pts[j].first - pts[i].first) * (pts[j].second + pts[i].second);
+		reverse = (area2 > 0.0) != (orientation > 0);
+	}
+
+	for(size_t i = 0; i < count; i++)
+	{
+		const Point &a = pts[i];
+		const Point &b = pts[(i+1) % count];
+		if(reverse)
+			this->AddEdge(b.first, b.second, a.first, a.second);
+		else
+			this->AddEdge(a.first, a.second, b.first, b.second);
+	}
+}
+
+///Split an edge where it leaves the clip rectangle on the left or right. Parts
+///to the left are moved onto the left side, where they still change the winding
+///of pixels to their right. Parts to the right cannot affect any pixel.
+void ScanlineRasterizer::AddEdge(double x0, double y0, double x1, double y1)
+{
+	if(y0 == y1 || !(y0 == y0 && y1 == y1 && x0 == x0 && x1 == x1))
+		return; //Horizontal or NaN
+	double left = this->clipX1, right = this->clipX2;
+	if(x0 >= right && x1 >= right)
+		return;
+	if(x0 >= left && x1 >= left && x0 <= right && x1 <= right)
+	{
+		this->AddClippedEdge(x0, y0, x1, y1);
+		return;
+	}
+
+	double ts[4] = {0.0, 1.0, 1.0, 1.0};
+	int numTs = 1;
+	if((x0 < left) != (x1 < left))
+		ts[numTs++] = (left - x0) / (x1 - x0);
+	if((x0 > right) != (x1 > right))
+		ts[numTs++] = (right - x0) / (x1 - x0);
+	ts[numTs++] = 1.0;
+	sort(ts, ts + numTs);
+
+	for(int i = 0; i+1 < numTs; i++)
+	{
+		double ta = ts[i], tb = ts[i+1];
+		if(tb <= ta)
+			continue;
+		double ax = x0 + ta * (x1 - x0), ay = y0 + ta * (y1 - y0);
+		double bx = x0 + tb * (x1 - x0), by = y0 + tb * (y1 - y0);
+		double mx = 0.5 * (ax + bx);
+		if(mx >= right)
+			continue;
+		if(mx <= left)
+			ax = bx = left;
+		this->AddClippedEdge(max(left, min(right, ax)), ay, max(left, min(right, bx)), by);
+	}
+}
+
+inline void ScanlineRasterizer::Deposit(int x, int row, double cover)
+{
+	if(x >= this->clipX2)
+		return;
+	this->rows[row].push_back(RasterCell(x, (float)cover));
+}
+
+void ScanlineRasterizer::AddClippedEdge(double x0, double y0, double x1, double y1)
+{
+	if(y0 == y1)
+		return;
+	double dir = 1.0;
+	if(y0 > y1)
+	{
+		swap(x0, x1);
+		swap(y0, y1);
+		dir = -1.0;
+	}
+	if(y1 <= this->clipY1 || y0 >= this->clipY2)
+		return;
+
+	double dxdy = (x1 - x0) / (y1 - y0);
+	double x = x0;
+	if(y0 < this->clipY1)
+		x += (this->clipY1 - y0) * dxdy;
+	int yStart = max((int)floor(y0), this->clipY1);
+	int yEnd = min((int)ceil(y1), this->clipY2);
+
+	for(int y = yStart; y < yEnd; y++)
+	{
+		int row = y - this->clipY1;
+		double dy = min((double)(y+1), y1) - max((double)y, y0);
+		double xNext = x + dxdy * dy;
+		double d = dy * dir;
+		double xa = min(x, xNext), xb = max(x, xNext);
+		double xaFloor = floor(xa);
+		int xai = (int)xaFloor;
+		double xbCeil = ceil(xb);
+		int xbi = (int)xbCeil;
+
+		if(xbi <= xai + 1)
+		{
+			//Edge stays within one pixel
+			double xmf = 0.5 * (x + xNext) - xaFloor;
+			this->Deposit(xai, row, d - d * xmf);
+			this->Deposit(xai + 1, row, d * xmf);
+		}
+		else
+		{
+			double s = 1.0 / (xb - xa);
+			double xaf = xa - xaFloor;
+			double a0 = 0.5 * s * (1.0 - xaf) * (1.0 - xaf);
+			double xbf = xb - xbCeil + 1.0;
+			double am = 0.5 * s * xbf * xbf;
+			this->Deposit(xai, row, d * a0);
+			if(xbi == xai + 2)
+				this->Deposit(xai + 1, row, d * (1.0 - a0 - am));
+			else
+			{
+				double a1 = s * (1.5 - xaf);
+				this->Deposit(xai + 1, row, d * (a1 - a0));
+				for(int xi = xai + 2; xi < xbi - 1; xi++)
+					this->Deposit(xi, row, d * s);
+				double a2 = a1 + (xbi - xai - 3) * s;
+				this->Deposit(xbi - 1, row, d * (1.0 - a2 - am));
+			}
+			this->Deposit(xbi, row, d * am);
+		}
+		x = xNext;
+	}
+
+	this->minRow = min(this->minRow, yStart - this->clipY1);
+	this->maxRow = max(this->maxRow, yEnd - 1 - this->clipY1);
+}
+
+// *************************************
+
+inline uint32_t BlendPixel(uint32_t dst, uint32_t src, unsigned ia)
+{
+	uint32_t out = 0;
+	for(int shift = 0; shift < 32; shift += 8)
+	{
+		unsigned t = ((dst >> shift) & 0xFF) * ia + 128;
+		unsigned v = ((src >> shift) & 0xFF) + ((t + (t >> 8)) >> 8);
+		out |= (v > 255 ? 255 : v) << shift;
+	}
+	return out;
+}
+
+///Blend a premultiplied source over a span, where ia is 255 minus the source alpha
+static void BlendSpanScalar(uint32_t *pixels, int count, uint32_t src, unsigned ia)
+{
+	if(ia == 0)
+	{
+		for(int i = 0; i < count; i++)
+			pixels[i] = src;
+		return;
+	}
+	for(int i = 0; i < count; i++)
+		pixels[i] = BlendPixel(pixels[i], src, ia);
+}
+
+#ifdef DRAWLIB_X86_SIMD
+
+///Four pixels per register, giving the same result as BlendSpanScalar
+__attribute__((target("sse2")))
+static void BlendSpanSse2(uint32_t *pixels, int count, uint32_t src, unsigned ia)
+{
+	int i = 0;
+	__m128i src4 = _mm_set1_epi32(src);
+	if(ia == 0)
+	{
+		for(; i + 4 <= count; i += 4)
+			_mm_storeu_si128((__m128i *)(pixels + i), src4);
+	}
+	else
+	{
+		__m128i zero = _mm_setzero_si128();
+		__m128i ia16 = _mm_set1_epi16(ia);
+		__m128i round = _mm_set1_epi16(128);
+		for(; i + 4 <= count; i += 4)
+		{
+			__m128i d = _mm_loadu_si128((const __m128i *)(pixels + i));
+			__m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), ia16), round);
+			__m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), ia16), round);
+			lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+			hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+			d = _mm_adds_epu8(_mm_packus_epi16(lo, hi), src4);
+			_mm_storeu_si128((__m128i *)(pixels + i), d);
+		}
+	}
+	BlendSpanScalar(pixels + i, count - i, src, ia);
+}
+
+#endif //DRAWLIB_X86_SIMD
+
+static void BlendSpan(uint32_t *pixels, int count, uint32_t src, unsigned ia, bool useSse2)
+{
+#ifdef DRAWLIB_X86_SIMD
+	if(useSse2 && count >= 4)
+	{
+		BlendSpanSse2(pixels, count, src, ia);
+		return;
+	}
+#endif
+	BlendSpanScalar(pixels, count, src, ia);
+}
+
+inline double Coverage(double acc, RasterFillRule rule)
+{
+	double a = fabs(acc);
+	if(rule == RASTER_EVEN_ODD)
+	{
+		a -= 2.0 * floor(0.5 * a);
+		return a > 1.0 ? 2.0 - a : a;
+	}
+	return a < 1.0 ? a : 1.0;
+}
+
+void ScanlineRasterizer::Fill(unsigned char *pixels, int stride, double r, double g, double b, double a,
+	RasterFillRule rule)
+{
+	bool useSse2 = GetSimdLevel() >= SIMD_SSE2;
+	double pa = 255.0 * max(0.0, min(1.0, a));
+	double pr = pa * max(0.0, min(1.0, r));
+	double pg = pa * max(0.0, min(1.0, g));
+	double pb = pa * max(0.0, min(1.0, b));
+	int lastAlpha = -1;
+	uint32_t src = 0;
+	unsigned ia = 255;
+
+	for(int row = this->minRow; row <= this->maxRow; row++)
+	{
+		std::vector<class RasterCell> &cells = this->rows[row];
+		if(cells.size() == 0)
+			continue;
+		sort(cells.begin(), cells.end());
+		uint32_t *line = (uint32_t *)(pixels + (size_t)stride * (row + this->clipY1));
+
+		double acc = 0.0;
+		size_t i = 0;
+		while(i < cells.size())
+		{
+			int x = cells[i].x;
+			for(; i < cells.size() && cells[i].x == x; i++)
+				acc += cells[i].cover;
+			int xEnd = i < cells.size() ? cells[i].x : this->clipX2;
+
+			//Coverage is constant until the next cell
+			double cov = Coverage(acc, rule);
+			if(cov < RASTER_MIN_COVERAGE || xEnd <= x)
+				continue;
+			int alpha = (int)(cov * 255.0 + 0.5);
+			if(alpha != lastAlpha)
+			{
+				double scale = alpha / 255.0;
+				unsigned sa = (unsigned)(pa * scale + 0.5);
+				src = (sa << 24) | ((unsigned)(pr * scale + 0.5) << 16)
+					| ((unsigned)(pg * scale + 0.5) << 8) | (unsigned)(pb * scale + 0.5);
+				ia = 255 - sa;
+				lastAlpha = alpha;
+			}
+			BlendSpan(line + x, xEnd - x, src, ia, useSse2);
+		}
+		cells.clear();
+	}
+	this->minRow = this->clipY2 - this->clipY1;
+	this->maxRow = -1;
+}
+
+// *************************************
+
+inline Point Offset(const Point &p, double dx, double dy)
+{
+	return Point(p.first + dx, p.second + dy);
+}
+
+static void AddCircle(const Point &center, double radius, double tolerance, Contours &ringsOut)
+{
+	int steps = 8;
+	if(tolerance < radius)
+		steps = max(8, min(256, (int)ceil(M_PI / acos(1.0 - tolerance / radius))));
+	ringsOut.push_back(Contour());
+	Contour &ring = ringsOut.back();
+	for(int i = 0; i < steps; i++)
+	{
+		double ang = 2.0 * M_PI * i / steps;
+		ring.push_back(Offset(center, radius * cos(ang), radius * sin(ang)));
+	}
+}
+
+///Fill the outside corner between two segments meeting at pt
+static void AddJoin(const Point &pt, double dx0, double dy0, double dx1, double dy1, double hw,
+	RasterLineJoin join, double miterLimit, double tolerance, Contours &ringsOut)
+{
+	double cross = dx0 * dy1 - dy0 * dx1;
+	double dot = dx0 * dx1 + dy0 * dy1;
+	if(fabs(cross) < 1e-12 && dot > 0.0)
+		return; //Straight on
+	if(join == RASTER_JOIN_ROUND)
+	{
+		AddCircle(pt, hw, tolerance, ringsOut);
+		return;
+	}
+
+	double side = cross > 0.0 ? -1.0 : 1.0;
+	double n0x = -dy0 * side, n0y = dx0 * side;
+	double n1x = -dy1 * side, n1y = dx1 * side;
+	ringsOut.push_back(Contour());
+	Contour &ring = ringsOut.back();
+	ring.push_back(pt);
+	ring.push_back(Offset(pt, n0x * hw, n0y * hw));
+
+	//The miter length relative to the line width is 2 / |n0 + n1|
+	double mx = n0x + n1x, my = n0y + n1y;
+	double m2 = mx * mx + my * my;
+	if(join == RASTER_JOIN_MITER && m2 > 0.0 && 4.0 <= miterLimit * miterLimit * m2)
+		ring.push_back(Offset(pt, mx * 2.0 * hw / m2, my * 2.0 * hw / m2));
+	ring.push_back(Offset(pt, n1x * hw, n1y * hw));
+}
+
+void LineStyleFromProperties(const class LineProperties &properties, RasterLineJoin &joinOut,
+	RasterLineCap &capOut)
+{
+	capOut = RASTER_CAP_BUTT;
+	if(properties.lineCap == "sqaure" || properties.lineCap == "square")
+		capOut = RASTER_CAP_SQUARE;
+	if(properties.lineCap == "round")
+		capOut = RASTER_CAP_ROUND;
+	joinOut = RASTER_JOIN_MITER;
+	if(properties.lineJoin == "round")
+		joinOut = RASTER_JOIN_ROUND;
+	if(properties.lineJoin == "bevel")
+		joinOut = RASTER_JOIN_BEVEL;
+}
+
+void StrokeToRings(const Contour &line, double lineWidth, bool closedLoop,
+	RasterLineJoin join, RasterLineCap cap, double miterLimit, double tolerance,
+	Contours &ringsOut)
+{
+	ringsOut.clear();
+	double hw = 0.5 * lineWidth;
+	if(hw <= 0.0)
+		return;
+
+	Contour pts;
+	pts.reserve(line.size());
+	for(size_t i = 0; i < line.size(); i++)
+		if(pts.size() == 0 || line[i] != pts.back())
+			pts.push_back(line[i]);
+	if(closedLoop && pts.size() > 1 && pts[0] == pts.back())
+		pts.pop_back();
+	size_t n = pts.size();
+	if(n == 0)
+		return;
+
+	if(n == 1)
+	{
+		//A dot is drawn for round and square caps
+		if(cap == RASTER_CAP_ROUND)
+			AddCircle(pts[0], hw, tolerance, ringsOut);
+		else if(cap == RASTER_CAP_SQUARE)
+		{
+			ringsOut.push_back(Contour());
+			ringsOut.back().push_back(Offset(pts[0], -hw, -hw));
+			ringsOut.back().push_back(Offset(pts[0], hw, -hw));
+			ringsOut.back().push_back(Offset(pts[0], hw, hw));
+			ringsOut.back().push_back(Offset(pts[0], -hw, hw));
+		}
+		return;
+	}
+
+	bool loop = closedLoop && n > 2;
+	size_t numSegs = loop ? n : n-1;
+	std::vector<Point> dirs(numSegs);
+	for(size_t i = 0; i < numSegs; i++)
+	{
+		const Point &a = pts[i];
+		const Point &b = pts[(i+1) % n];
+		double dx = b.first - a.first, dy = b.second - a.second;
+		double len = sqrt(dx * dx + dy * dy);
+		dirs[i] = Point(dx / len, dy / len);
+	}
+
+	//One rectangle per segment
+	for(size_t i = 0; i < numSegs; i++)
+	{
+		double dx = dirs[i].first, dy = dirs[i].second;
+		Point a = pts[i], b = pts[(i+1) % n];
+		if(!loop && cap == RASTER_CAP_SQUARE)
+		{
+			if(i == 0)
+				a = Offset(a, -dx * hw, -dy * hw);
+			if(i == numSegs-1)
+				b = Offset(b, dx * hw, dy * hw);
+		}
+		double nx = -dy * hw, ny = dx * hw;
+		ringsOut.push_back(Contour());
+		Contour &ring = ringsOut.back();
+		ring.push_back(Offset(a, nx, ny));
+		ring.push_back(Offset(b, nx, ny));
+		ring.push_back(Offset(b, -nx, -ny));
+		ring.push_back(Offset(a, -nx, -ny));
+	}
+
+	//Joins between segments
+	size_t firstJoin = loop ? 0 : 1;
+	size_t lastJoin = loop ? n : n-1;
+	for(size_t i = firstJoin; i < lastJoin; i++)
+	{
+		const Point &d0 = dirs[(i + numSegs - 1) % numSegs];
+		const Point &d1 = dirs[i % numSegs];
+		AddJoin(pts[i], d0.first, d0.second, d1.first, d1.second, hw, join, miterLimit, tolerance, ringsOut);
+	}
+
+	if(!loop && cap == RASTER_CAP_ROUND)
+	{
+		AddCircle(pts[0], hw, tolerance, ringsOut);
+		AddCircle(pts[n-1], hw, tolerance, ringsOut);
+	}
+}
+
+// *************************************
+
+static double PixelAlpha(const std::vector<uint32_t> &pixels, int width, int x, int y)
+{
+	return (pixels[y * width + x] >> 24) / 255.0;
+}
+
+void ScanlineRasterizerTests()
+{
+	const int width = 40, height = 30;
+	std::vector<uint32_t> pixels(width * height, 0);
+	class ScanlineRasterizer raster;
+
+	// ** Pixel aligned square is solid inside, with exact colour **
+	raster.Reset(0, 0, width, height);
+	Contour square;
+	square.push_back(Point(5.0, 5.0));
+	square.push_back(Point(15.0, 5.0));
+	square.push_back(Point(15.0, 15.0));
+	square.push_back(Point(5.0, 15.0));
+	raster.AddRing(&square[0], square.size(), 1);
+	raster.Fill((unsigned char *)&pixels[0], width * 4, 1.0, 0.0, 0.0, 1.0, RASTER_NONZERO);
+	cout << "square pixel " << hex << pixels[10 * width + 10] << dec << endl;
+	assert(pixels[10 * width + 10] == 0xFFFF0000);
+	assert(pixels[5 * width + 5] == 0xFFFF0000);
+	assert(pixels[4 * width + 10] == 0 && pixels[10 * width + 15] == 0);
+
+	// ** Half pixel edge gives half coverage **
+	std::fill(pixels.begin(), pixels.end(), 0);
+	square[1].first = square[2].first = 15.5;
+	raster.AddRing(&square[0], square.size(), 1);
+	raster.Fill((unsigned char *)&pixels[0], width * 4, 1.0, 1.0, 1.0, 1.0, RASTER_NONZERO);
+	assert(fabs(PixelAlpha(pixels, width, 15, 10) - 0.5) < 0.01);
+
+	// ** Hole cut by non-zero with opposite orientation, and by even-odd **
+	Contour hole;
+	hole.push_back(Point(8.0, 8.0));
+	hole.push_back(Point(12.0, 8.0));
+	hole.push_back(Point(12.0, 12.0));
+	hole.push_back(Point(8.0, 12.0));
+	for(int rule = 0; rule < 2; rule++)
+	{
+		std::fill(pixels.begin(), pixels.end(), 0);
+		raster.AddRing(&square[0], square.size(), rule == 0 ? 1 : 0);
+		raster.AddRing(&hole[0], hole.size(), rule == 0 ? -1 : 0);
+		raster.Fill((unsigned char *)&pixels[0], width * 4, 0.0, 0.0, 1.0, 1.0,
+			rule == 0 ? RASTER_NONZERO : RASTER_EVEN_ODD);
+		assert(pixels[10 * width + 10] == 0);
+		assert(pixels[6 * width + 6] == 0xFF0000FF);
+	}
+
+	// ** Circle partly outside the clip has about the right area **
+	std::fill(pixels.begin(), pixels.end(), 0);
+	Contours rings;
+	AddCircle(Point(35.0, 15.0), 10.0, 0.01, rings);
+	raster.AddRing(&rings[0][0], rings[0].size(), 1);
+	raster.Fill((unsigned char *)&pixels[0], width * 4, 1.0, 1.0, 1.0, 1.0, RASTER_NONZERO);
+	double area = 0.0;
+	for(int y = 0; y < height; y++)
+		for(int x = 0; x < width; x++)
+			area += PixelAlpha(pixels, width, x, y);
+	double cut = 2.0 * M_PI / 3.0; //Angle of the part right of the clip
+	double expected = M_PI * 100.0 - 0.5 * 100.0 * (cut - sin(cut));
+	assert(fabs(area - expected) < 1.0);
+
+	// ** Stroke covers its length times its width **
+	std::fill(pixels.begin(), pixels.end(), 0);
+	Contour line;
+	line.push_back(Point(5.0, 20.0));
+	line.push_back(Point(25.0, 20.0));
+	line.push_back(Point(25.0, 28.0));
+	StrokeToRings(line, 2.0, false, RASTER_JOIN_MITER, RASTER_CAP_BUTT, 10.0, 0.1, rings);
+	for(size_t i = 0; i < rings.size(); i++)
+		raster.AddRing(&rings[i][0], rings[i].size(), 1);
+	raster.Fill((unsigned char *)&pixels[0], width * 4, 1.0, 1.0, 1.0, 1.0, RASTER_NONZERO);
+	area = 0.0;
+	for(int y = 0; y < height; y++)
+		for(int x = 0; x < width; x++)
+			area += PixelAlpha(pixels, width, x, y);
+	assert(fabs(area - (20.0 * 2.0 + 8.0 * 2.0)) < 0.5); //Miter corner fills what the overlap loses
+}
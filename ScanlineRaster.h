@@ -0,0 +1,82 @@
+#ifndef _SCANLINE_RASTER_H
+#define _SCANLINE_RASTER_H
+#include "drawlib.h"
+
+enum RasterFillRule
+{
+	RASTER_NONZERO,
+	RASTER_EVEN_ODD
+};
+
+enum RasterLineJoin
+{
+	RASTER_JOIN_MITER,
+	RASTER_JOIN_ROUND,
+	RASTER_JOIN_BEVEL
+};
+
+enum RasterLineCap
+{
+	RASTER_CAP_BUTT,
+	RASTER_CAP_ROUND,
+	RASTER_CAP_SQUARE
+};
+
+///Signed area deposited at one pixel of a scanline
+class RasterCell
+{
+public:
+	int x;
+	float cover;
+
+	RasterCell(int x, float cover) : x(x), cover(cover) {}
+	bool operator <(const RasterCell &rhs) const {return x < rhs.x;}
+};
+
+///Antialiased scanline rasterizer for premultiplied ARGB32 pixels. Edges
+///deposit their signed area into sparse per-row cell lists. Filling sorts
+///each row and blends the constant coverage spans between cells, using SSE2
+///where available.
+class ScanlineRasterizer
+{
+public:
+	ScanlineRasterizer();
+	virtual ~ScanlineRasterizer();
+
+	///Set the rectangle of pixels that can be drawn, x1,y1 inclusive to
+	///x2,y2 exclusive, and discard any edges
+	void Reset(int x1, int y1, int x2, int y2);
+	///Add a closed ring in pixel coordinates. An orientation of 1 or -1 makes
+	///the ring wind that way, so holes can be cut under the non-zero rule.
+	///0 keeps the ring as it is.
+	void AddRing(const Point *pts, size_t count, int orientation = 0);
+	void AddEdge(double x0, double y0, double x1, double y1);
+	///Blend the shape built from the added rings into the pixels with a
+	///non-premultiplied colour, then discard the edges
+	void Fill(unsigned char *pixels, int stride, double r, double g, double b, double a,
+		RasterFillRule rule);
+
+protected:
+	int clipX1, clipY1, clipX2, clipY2;
+	std::vector<std::vector<class RasterCell> > rows;
+	int minRow, maxRow;
+
+	void AddClippedEdge(double x0, double y0, double x1, double y1);
+	void Deposit(int x, int row, double cover);
+};
+
+///Join and cap styles named in line properties. The misspelt "sqaure" cap is
+///also accepted, as it is what the cairo back end checks for.
+void LineStyleFromProperties(const class LineProperties &properties, RasterLineJoin &joinOut,
+	RasterLineCap &capOut);
+
+///Outline of a stroked line as rings, which together cover the stroke when
+///added with positive orientation and filled with the non-zero rule. Each
+///ring is convex. Round joins and caps are flattened to within tolerance.
+void StrokeToRings(const Contour &line, double lineWidth, bool closedLoop,
+	RasterLineJoin join, RasterLineCap cap, double miterLimit, double tolerance,
+	Contours &ringsOut);
+
+void ScanlineRasterizerTests();
+
+#endif //_SCANLINE_RASTER_H
@@ -0,0 +1,751 @@
+//Compact binary encoding of the commands in a LocalStore, for caching display
+//lists on disk. Coordinates are rounded to multiples of a step and written as
+//zigzag varint differences from the point before, as in vector tiles:
+//https://github.com/mapbox/vector-tile-spec/tree/master/2.1
+//
+//An encoding is a header, then records until an end record:
+//  header: "DLSC", varint version, step as a little endian double
+//  record: varint tag, then its fields
+//    TAG_STRING  define the next string: varint length, bytes
+//    TAG_SHAPE   define the next shape properties, strings by number
+//    TAG_LINE    define the next line properties
+//    TAG_TEXT    define the next text properties
+//    TAG_CMD + CmdTypes  a command, with properties and names by number
+//Definitions come before their first use, so a store is written and read in
+//one pass. Encodings may be concatenated, each with its own definitions.
+
+#include "drawlib.h"
+#include <string.h>
+#include <math.h>
+#include <istream>
+#include <stdexcept>
+using namespace std;
+
+enum CodecTag
+{
+	TAG_END,
+	TAG_STRING,
+	TAG_SHAPE,
+	TAG_LINE,
+	TAG_TEXT,
+	TAG_CMD = 16
+};
+
+static const char codecMagic[4] = {'D', 'L', 'S', 'C'};
+static const unsigned codecVersion = 1;
+
+// ************* Encoding *************
+
+class StoreEncoder
+{
+public:
+	std::string &out;
+	double step;
+	std::map<std::string, size_t> strings;
+	std::map<class ShapeProperties, size_t> shapes;
+	std::map<class LineProperties, size_t> lines;
+	std::map<class TextProperties, size_t> texts;
+	int64_t cx, cy; //Last point written, in steps
+
+	StoreEncoder(std::string &out, double step) : out(out), step(step), cx(0), cy(0) {}
+
+	void Byte(unsigned char val)
+	{
+		out.push_back((char)val);
+	}
+
+	void Varint(uint64_t val)
+	{
+		while(val >= 0x80)
+		{
+			out.push_back((char)(val | 0x80));
+			val >>= 7;
+		}
+		out.push_back((char)val);
+	}
+
+	void Signed(int64_t val)
+	{
+		this->Varint(((uint64_t)val << 1) ^ (uint64_t)(val >> 63));
+	}
+
+	void Double(double val)
+	{
+		uint64_t bits = 0;
+		memcpy(&bits, &val, sizeof(bits));
+		for(int i = 0; i < 8; i++)
+			out.push_back((char)(bits >> (8 * i)));
+	}
+
+	void Text(const std::string &str)
+	{
+		this->Varint(str.size());
+		out.append(str);
+	}
+
+	// ** Dictionaries, which write a definition the first time a value is seen **
+
+	size_t StringRef(const std::string &str)
+	{
+		std::map<std::string, size_t>::iterator it = strings.find(str);
+		if(it != strings.end())
+			return it->second;
+		this->Varint(TAG_STRING);
+		this->Text(str);
+		size_t ref = strings.size();
+		strings[str] = ref;
+		return ref;
+	}
+
+	size_t ShapeRef(const class ShapeProperties &props)
+	{
+		std::map<class ShapeProperties, size_t>::iterator it = shapes.find(props);
+		if(it != shapes.end())
+			return it->second;
+		size_t imageId = this->StringRef(props.imageId);
+		this->Varint(TAG_SHAPE);
+		this->Double(props.r); this->Double(props.g); this->Double(props.b); this->Double(props.a);
+		this->Varint(imageId);
+		this->Double(props.texx); this->Double(props.texy);
+		size_t ref = shapes.size();
+		shapes[props] = ref;
+		return ref;
+	}
+
+	size_t LineRef(const class LineProperties &props)
+	{
+		std::map<class LineProperties, size_t>::iterator it = lines.find(props);
+		if(it != lines.end())
+			return it->second;
+		size_t lineJoin = this->StringRef(props.lineJoin);
+		size_t lineCap = this->StringRef(props.lineCap);
+		this->Varint(TAG_LINE);
+		this->Double(props.r); this->Double(props.g); this->Double(props.b); this->Double(props.a);
+		this->Double(props.lineWidth);
+		this->Byte(props.closedLoop);
+		this->Varint(lineJoin);
+		this->Varint(lineCap);
+		size_t ref = lines.size();
+		lines[props] = ref;
+		return ref;
+	}
+
+	size_t TextRef(const class TextProperties &props)
+	{
+		std::map<class TextProperties, size_t>::iterator it = texts.find(props);
+		if(it != texts.end())
+			return it->second;
+		size_t font = this->StringRef(props.font);
+		this->Varint(TAG_TEXT);
+		this->Double(props.lr); this->Double(props.lg); this->Double(props.lb); this->Double(props.la);
+		this->Double(props.fr); this->Double(props.fg); this->Double(props.fb); this->Double(props.fa);
+		this->Varint(font);
+		this->Double(props.fontSize);
+		this->Byte(props.outline);
+		this->Byte(props.fill);
+		this->Double(props.lineWidth);
+		this->Double(props.valign);
+		this->Double(props.halign);
+		size_t ref = texts.size();
+		texts[props] = ref;
+		return ref;
+	}
+
+	// ** Geometry **
+
+	int64_t Units(double val)
+	{
+		double units = floor(val / step + 0.5);
+		if(!(fabs(units) < 4.0e18))
+			throw invalid_argument("Coordinate is too large to encode at this step");
+		return (int64_t)units;
+	}
+
+	void Coord(double x, double y)
+	{
+		int64_t ux = this->Units(x), uy = this->Units(y);
+		this->Signed(ux - cx);
+		this->Signed(uy - cy);
+		cx = ux; cy = uy;
+	}
+
+	void Ring(const Contour &ring)
+	{
+		this->Varint(ring.size());
+		for(size_t i=0;i < ring.size(); i++)
+			this->Coord(ring[i].first, ring[i].second);
+	}
+
+	void Polygons(const std::vector<Polygon> &polygons)
+	{
+		this->Varint(polygons.size());
+		for(size_t i=0;i < polygons.size(); i++)
+		{
+			this->Varint(polygons[i].second.size());
+			this->Ring(polygons[i].first);
+			for(size_t j=0;j < polygons[i].second.size(); j++)
+				this->Ring(polygons[i].second[j]);
+		}
+	}
+
+	void Lines(const Contours &lines)
+	{
+		this->Varint(lines.size());
+		for(size_t i=0;i < lines.size(); i++)
+			this->Ring(lines[i]);
+	}
+
+	void Cmd(const class BaseCmd &baseCmd);
+};
+
+void StoreEncoder::Cmd(const class BaseCmd &baseCmd)
+{
+	//Definitions are written before the command tag
+	cx = 0; cy = 0;
+	switch(baseCmd.type)
+	{
+	case CMD_POLYGONS:
+		{
+			const class DrawPolygonsCmd &polygonsCmd = (const class DrawPolygonsCmd &)baseCmd;
+			size_t props = this->ShapeRef(polygonsCmd.properties);
+			this->Varint(TAG_CMD + CMD_POLYGONS);
+			this->Varint(props);
+			if(polygonsCmd.IsQuantized())
+			{
+				std::vector<Polygon> expanded;
+				polygonsCmd.quantized.Dequantize(expanded);
+				this->Polygons(expanded);
+			}
+			else
+				this->Polygons(polygonsCmd.polygons);
+			break;
+		}
+	case CMD_LINES:
+		{
+			const class DrawLinesCmd &linesCmd = (const class DrawLinesCmd &)baseCmd;
+			size_t props = this->LineRef(linesCmd.properties);
+			this->Varint(TAG_CMD + CMD_LINES);
+			this->Varint(props);
+			if(linesCmd.IsQuantized())
+			{
+				Contours expanded;
+				linesCmd.quantized.Dequantize(expanded);
+				this->Lines(expanded);
+			}
+			else
+				this->Lines(linesCmd.lines);
+			break;
+		}
+	case CMD_TEXT:
+		{
+			const class DrawTextCmd &textCmd = (const class DrawTextCmd &)baseCmd;
+			size_t props = this->TextRef(textCmd.properties);
+			this->Varint(TAG_CMD + CMD_TEXT);
+			this->Varint(props);
+			this->Varint(textCmd.textStrs.size());
+			for(size_t i=0;i < textCmd.textStrs.size(); i++)
+			{
+				const class TextLabel &label = textCmd.textStrs[i];
+				this->Text(label.text);
+				this->Coord(label.x, label.y);
+				this->Double(label.ang);
+			}
+			break;
+		}
+	case CMD_TWISTED_TEXT:
+		{
+			const class DrawTwistedTextCmd &textCmd = (const class DrawTwistedTextCmd &)baseCmd;
+			size_t props = this->TextRef(textCmd.properties);
+			this->Varint(TAG_CMD + CMD_TWISTED_TEXT);
+			this->Varint(props);
+			this->Varint(textCmd.textStrs.size());
+			for(size_t i=0;i < textCmd.textStrs.size(); i++)
+			{
+				const class TwistedTextLabel &label = textCmd.textStrs[i];
+				this->Text(label.text);
+				const class TwistedPath &path = label.path;
+				this->Varint(path.verbs.size());
+				for(size_t j=0;j < path.verbs.size(); j++)
+					this->Byte(path.verbs[j]);
+				//Relative commands are written the same way, as differences are small either way
+				for(size_t j=0;j + 1 < path.coords.size(); j+=2)
+					this->Coord(path.coords[j], path.coords[j+1]);
+			}
+			break;
+		}
+	case CMD_LOAD_RESOURCES:
+		{
+			const std::map<std::string, std::string> &mapping = ((const class LoadImageResourcesCmd &)baseCmd).loadIdToFilenameMapping;
+			std::vector<size_t> refs;
+			for(std::map<std::string, std::string>::const_iterator it = mapping.begin(); it != mapping.end(); it++)
+			{
+				refs.push_back(this->StringRef(it->first));
+				refs.push_back(this->StringRef(it->second));
+			}
+			this->Varint(TAG_CMD + CMD_LOAD_RESOURCES);
+			this->Varint(mapping.size());
+			for(size_t i=0;i < refs.size(); i++)
+				this->Varint(refs[i]);
+			break;
+		}
+	case CMD_UNLOAD_RESOURCES:
+		{
+			const std::vector<std::string> &unloadIds = ((const class UnloadImageResourcesCmd &)baseCmd).unloadIds;
+			std::vector<size_t> refs;
+			for(size_t i=0;i < unloadIds.size(); i++)
+				refs.push_back(this->StringRef(unloadIds[i]));
+			this->Varint(TAG_CMD + CMD_UNLOAD_RESOURCES);
+			this->Varint(refs.size());
+			for(size_t i=0;i < refs.size(); i++)
+				this->Varint(refs[i]);
+			break;
+		}
+	case CMD_INSTANCES:
+		{
+			const class DrawInstancesCmd &instancesCmd = (const class DrawInstancesCmd &)baseCmd;
+			bool filled = instancesCmd.polygons.size() > 0;
+			size_t props = filled ? this->ShapeRef(instancesCmd.shapeProperties) : this->LineRef(instancesCmd.lineProperties);
+			this->Varint(TAG_CMD + CMD_INSTANCES);
+			this->Byte(filled);
+			this->Varint(props);
+			if(filled)
+				this->Polygons(instancesCmd.polygons);
+			else
+				this->Lines(instancesCmd.lines);
+			//Transforms are written in full, as rotations and scales do not round well
+			this->Varint(instancesCmd.NumInstances());
+			for(size_t i=0;i < instancesCmd.transforms.size(); i++)
+				this->Double(instancesCmd.transforms[i]);
+			this->Varint(instancesCmd.colours.size());
+			for(size_t i=0;i < instancesCmd.colours.size(); i++)
+				this->Varint(instancesCmd.colours[i]);
+			break;
+		}
+	default:
+		this->Varint(TAG_CMD + baseCmd.type);
+		break;
+	}
+}
+
+void LocalStore::Encode(std::string &out, double step) const
+{
+	if(!(step > 0.0))
+		throw invalid_argument("Encoding step must be positive");
+	class StoreEncoder encoder(out, step);
+	out.append(codecMagic, sizeof(codecMagic));
+	encoder.Varint(codecVersion);
+	encoder.Double(step);
+	for(size_t i=0;i < cmds.size(); i++)
+		encoder.Cmd(*cmds[i]);
+	encoder.Varint(TAG_END);
+}
+
+// ************* Decoding *************
+
+///Reads from memory, or from a stream a block at a time
+class StoreDecoder
+{
+public:
+	std::istream *in;
+	const char *pos, *end;
+	std::vector<char> block;
+	double step;
+	std::vector<std::string> strings;
+	std::vector<class ShapeProperties> shapes;
+	std::vector<class LineProperties> lines;
+	std::vector<class TextProperties> texts;
+	int64_t cx, cy;
+
+	StoreDecoder(const char *data, size_t size) : in(NULL), pos(data), end(data + size), step(1.0), cx(0), cy(0) {}
+
+	StoreDecoder(std::istream &in) : in(&in), pos(NULL), end(NULL), block(64 * 1024), step(1.0), cx(0), cy(0) {}
+
+	void Fail()
+	{
+		throw runtime_error("Malformed store encoding");
+	}
+
+	///\return false at the end of the data
+	bool Fill()
+	{
+		if(pos != end)
+			return true;
+		if(in == NULL || !in->good())
+			return false;
+		in->read(&block[0], block.size());
+		pos = &block[0];
+		end = pos + in->gcount();
+		return pos != end;
+	}
+
+	unsigned char Byte()
+	{
+		if(!this->Fill())
+			this->Fail();
+		return (unsigned char)*pos++;
+	}
+
+	uint64_t Varint()
+	{
+		uint64_t val = 0;
+		for(int shift = 0; shift < 64; shift += 7)
+		{
+			unsigned char byte = this->Byte();
+			val |= (uint64_t)(byte & 0x7f) << shift;
+			if((byte & 0x80) == 0)
+				return val;
+		}
+		this->Fail();
+		return 0;
+	}
+
+	int64_t Signed()
+	{
+		uint64_t val = this->Varint();
+		return (int64_t)(val >> 1) ^ -(int64_t)(val & 1);
+	}
+
+	double Double()
+	{
+		uint64_t bits = 0;
+		for(int i = 0; i < 8; i++)
+			bits |= (uint64_t)this->Byte() << (8 * i);
+		double val = 0.0;
+		memcpy(&val, &bits, sizeof(val));
+		return val;
+	}
+
+	void Text(std::string &strOut)
+	{
+		uint64_t size = this->Varint();
+		strOut.clear();
+		while(strOut.size() < size)
+		{
+			if(!this->Fill())
+				this->Fail();
+			size_t avail = min((uint64_t)(end - pos), size - strOut.size());
+			strOut.append(pos, avail);
+			pos += avail;
+		}
+	}
+
+	///Read a number of items, reserving no more than could plausibly follow so
+	///corrupt counts do not allocate huge arrays
+	size_t Count(size_t &reserveOut)
+	{
+		uint64_t count = this->Varint();
+		if(count > (uint64_t)(size_t)-1 / 64)
+			this->Fail();
+		reserveOut = min((size_t)count, (size_t)4096);
+		if(in == NULL)
+			reserveOut = min(reserveOut, (size_t)(end - pos));
+		return count;
+	}
+
+	template<class T> const T &Ref(const std::vector<T> &dict)
+	{
+		uint64_t ref = this->Varint();
+		if(ref >= dict.size())
+			this->Fail();
+		return dict[ref];
+	}
+
+	bool Bool()
+	{
+		return this->Byte() != 0;
+	}
+
+	// ** Geometry **
+
+	void Coord(double &xOut, double &yOut)
+	{
+		//Wrap rather than overflow on corrupt data
+		cx = (int64_t)((uint64_t)cx + (uint64_t)this->Signed());
+		cy = (int64_t)((uint64_t)cy + (uint64_t)this->Signed());
+		xOut = cx * step;
+		yOut = cy * step;
+	}
+
+	void Ring(Contour &ringOut)
+	{
+		size_t reserve = 0;
+		size_t count = this->Count(reserve);
+		ringOut.clear();
+		ringOut.reserve(reserve);
+		for(size_t i=0;i < count; i++)
+		{
+			Point pt;
+			this->Coord(pt.first, pt.second);
+			ringOut.push_back(pt);
+		}
+	}
+
+	void Polygons(std::vector<Polygon> &polygonsOut)
+	{
+		size_t reserve = 0;
+		size_t count = this->Count(reserve);
+		polygonsOut.reserve(reserve);
+		for(size_t i=0;i < count; i++)
+		{
+			polygonsOut.push_back(Polygon());
+			Polygon &polygon = polygonsOut.back();
+			size_t numInners = this->Count(reserve);
+			polygon.second.reserve(reserve);
+			this->Ring(polygon.first);
+			for(size_t j=0;j < numInners; j++)
+			{
+				polygon.second.push_back(Contour());
+				this->Ring(polygon.second.back());
+			}
+		}
+	}
+
+	void Lines(Contours &linesOut)
+	{
+		size_t reserve = 0;
+		size_t count = this->Count(reserve);
+		linesOut.reserve(reserve);
+		for(size_t i=0;i < count; i++)
+		{
+			linesOut.push_back(Contour());
+			this->Ring(linesOut.back());
+		}
+	}
+
+	void Header();
+	void Definition(uint64_t tag);
+	class BaseCmd *Cmd(CmdTypes type);
+	class BaseCmd *CmdGeometry(class BaseCmd *cmd);
+};
+
+void StoreDecoder::Header()
+{
+	char magic[sizeof(codecMagic)];
+	for(size_t i=0;i < sizeof(magic); i++)
+		magic[i] = (char)this->Byte();
+	if(memcmp(magic, codecMagic, sizeof(magic)) != 0 || this->Varint() != codecVersion)
+		this->Fail();
+	step = this->Double();
+	if(!(step > 0.0))
+		this->Fail();
+	strings.clear();
+	shapes.clear();
+	lines.clear();
+	texts.clear();
+}
+
+void StoreDecoder::Definition(uint64_t tag)
+{
+	switch(tag)
+	{
+	case TAG_STRING:
+		strings.push_back(std::string());
+		this->Text(strings.back());
+		break;
+	case TAG_SHAPE:
+		{
+			class ShapeProperties props;
+			props.r = this->Double(); props.g = this->Double(); props.b = this->Double(); props.a = this->Double();
+			props.imageId = this->Ref(strings);
+			props.texx = this->Double(); props.texy = this->Double();
+			shapes.push_back(props);
+			break;
+		}
+	case TAG_LINE:
+		{
+			class LineProperties props;
+			props.r = this->Double(); props.g = this->Double(); props.b = this->Double(); props.a = this->Double();
+			props.lineWidth = this->Double();
+			props.closedLoop = this->Bool();
+			props.lineJoin = this->Ref(strings);
+			props.lineCap = this->Ref(strings);
+			lines.push_back(props);
+			break;
+		}
+	case TAG_TEXT:
+		{
+			class TextProperties props;
+			props.lr = this->Double(); props.lg = this->Double(); props.lb = this->Double(); props.la = this->Double();
+			props.fr = this->Double(); props.fg = this->Double(); props.fb = this->Double(); props.fa = this->Double();
+			props.font = this->Ref(strings);
+			props.fontSize = this->Double();
+			props.outline = this->Bool();
+			props.fill = this->Bool();
+			props.lineWidth = this->Double();
+			props.valign = (float)this->Double();
+			props.halign = (float)this->Double();
+			texts.push_back(props);
+			break;
+		}
+	default:
+		this->Fail();
+	}
+}
+
+///Read a command of a type. Geometry and labels are read straight into the
+///new command rather than copied into it.
+class BaseCmd *StoreDecoder::Cmd(CmdTypes type)
+{
+	class BaseCmd *cmd = NULL;
+	cx = 0; cy = 0;
+	size_t reserve = 0;
+	try
+	{
+		switch(type)
+		{
+		case CMD_POLYGONS:
+			{
+				class DrawPolygonsCmd *polygonsCmd = new class DrawPolygonsCmd(std::vector<Polygon>(), this->Ref(shapes));
+				cmd = polygonsCmd;
+				this->Polygons(polygonsCmd->polygons);
+				break;
+			}
+		case CMD_LINES:
+			{
+				class DrawLinesCmd *linesCmd = new class DrawLinesCmd(Contours(), this->Ref(lines));
+				cmd = linesCmd;
+				this->Lines(linesCmd->lines);
+				break;
+			}
+		case CMD_TEXT:
+			{
+				class DrawTextCmd *textCmd = new class DrawTextCmd(std::vector<class TextLabel>(), this->Ref(texts));
+				cmd = textCmd;
+				size_t count = this->Count(reserve);
+				textCmd->textStrs.reserve(reserve);
+				for(size_t i=0;i < count; i++)
+				{
+					textCmd->textStrs.push_back(TextLabel());
+					class TextLabel &label = textCmd->textStrs.back();
+					this->Text(label.text);
+					this->Coord(label.x, label.y);
+					label.ang = this->Double();
+				}
+				break;
+			}
+		case CMD_TWISTED_TEXT:
+			{
+				class DrawTwistedTextCmd *textCmd = new class DrawTwistedTextCmd(std::vector<class TwistedTextLabel>(), this->Ref(texts));
+				cmd = textCmd;
+				size_t count = this->Count(reserve);
+				textCmd->textStrs.reserve(reserve);
+				for(size_t i=0;i < count; i++)
+				{
+					textCmd->textStrs.push_back(TwistedTextLabel());
+					class TwistedTextLabel &label = textCmd->textStrs.back();
+					this->Text(label.text);
+					size_t numVerbs = this->Count(reserve);
+					label.path.verbs.reserve(reserve);
+					size_t numCoords = 0;
+					for(size_t j=0;j < numVerbs; j++)
+					{
+						unsigned char verb = this->Byte();
+						if(verb > RelCurveTo)
+							this->Fail();
+						label.path.verbs.push_back((TwistedCurveCmdType)verb);
+						numCoords += TwistedCurveCmdArity((TwistedCurveCmdType)verb);
+					}
+					label.path.coords.resize(numCoords);
+					for(size_t j=0;j < numCoords; j+=2)
+						this->Coord(label.path.coords[j], label.path.coords[j+1]);
+				}
+				break;
+			}
+		case CMD_LOAD_RESOURCES:
+			{
+				std::map<std::string, std::string> mapping;
+				size_t count = this->Count(reserve);
+				for(size_t i=0;i < count; i++)
+				{
+					const std::string &loadId = this->Ref(strings);
+					mapping[loadId] = this->Ref(strings);
+				}
+				cmd = new class LoadImageResourcesCmd(mapping);
+				break;
+			}
+		case CMD_UNLOAD_RESOURCES:
+			{
+				std::vector<std::string> unloadIds;
+				size_t count = this->Count(reserve);
+				unloadIds.reserve(reserve);
+				for(size_t i=0;i < count; i++)
+					unloadIds.push_back(this->Ref(strings));
+				cmd = new class UnloadImageResourcesCmd(unloadIds);
+				break;
+			}
+		case CMD_INSTANCES:
+			{
+				class DrawInstancesCmd *instancesCmd = NULL;
+				std::vector<double> noTransforms;
+				std::vector<unsigned int> noColours;
+				if(this->Bool())
+				{
+					instancesCmd = new class DrawInstancesCmd(std::vector<Polygon>(), this->Ref(shapes), noTransforms, noColours);
+					cmd = instancesCmd;
+					this->Polygons(instancesCmd->polygons);
+				}
+				else
+				{
+					instancesCmd = new class DrawInstancesCmd(Contours(), this->Ref(lines), noTransforms, noColours);
+					cmd = instancesCmd;
+					this->Lines(instancesCmd->lines);
+				}
+				size_t numInstances = this->Count(reserve);
+				instancesCmd->transforms.reserve(reserve * 6);
+				for(size_t i=0;i < numInstances * 6; i++)
+					instancesCmd->transforms.push_back(this->Double());
+				size_t numColours = this->Count(reserve);
+				if(numColours != 0 && numColours != numInstances)
+					this->Fail();
+				instancesCmd->colours.reserve(reserve);
+				for(size_t i=0;i < numColours; i++)
+					instancesCmd->colours.push_back((unsigned int)this->Varint());
+				break;
+			}
+		case CMD_BASE:
+			cmd = new class BaseCmd();
+			break;
+		default:
+			this->Fail();
+		}
+	}
+	catch(...)
+	{
+		delete cmd;
+		throw;
+	}
+	return cmd;
+}
+
+void LocalStore::Decode(const char *data, size_t size)
+{
+	class StoreDecoder decoder(data, size);
+	this->DecodeCmds(decoder);
+}
+
+void LocalStore::Decode(std::istream &in)
+{
+	class StoreDecoder decoder(in);
+	this->DecodeCmds(decoder);
+}
+
+void LocalStore::DecodeCmds(class StoreDecoder &decoder)
+{
+	//Concatenated encodings are read one after another
+	while(decoder.Fill())
+	{
+		decoder.Header();
+		while(true)
+		{
+			uint64_t tag = decoder.Varint();
+			if(tag == TAG_END)
+				break;
+			if(tag < TAG_CMD)
+				decoder.Definition(tag);
+			else if(tag - TAG_CMD <= CMD_INSTANCES)
+				this->AdoptCmd(decoder.Cmd((CmdTypes)(tag - TAG_CMD)));
+			else
+				decoder.Fail();
+		}
+	}
+}
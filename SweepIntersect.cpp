@@ -0,0 +1,422 @@
+//Bentley-Ottmann sweep line to find all intersections in a set of segments
+//https://en.wikipedia.org/wiki/Bentley%E2%80%93Ottmann_algorithm
+
+#include <iostream>
+#include <cmath>
+#include <set>
+#include <map>
+#include <limits>
+#include <algorithm>
+#include <assert.h>
+#include "SweepIntersect.h"
+#include "LineLineIntersect.h"
+using namespace std;
+
+SegmentIntersection::SegmentIntersection() : contour1(0), segment1(0), contour2(0), segment2(0)
+{}
+
+SegmentIntersection::SegmentIntersection(const Point &pt, size_t contour1, size_t segment1, size_t contour2, size_t segment2):
+	pt(pt), contour1(contour1), segment1(segment1), contour2(contour2), segment2(segment2)
+{}
+
+// *************************************
+
+static const size_t SWEEP_PROBE = (size_t)-1;
+static const size_t NO_SEGMENT = (size_t)-1;
+
+class SweepSegment
+{
+public:
+	Point p, q; //Left and right end points
+	Point end; //End point in the direction of the contour
+	double slope; //Infinity for vertical segments
+	size_t contour, segment;
+	size_t next; //Following segment in the same contour
+};
+
+///Current position of the sweep line
+class SweepState
+{
+public:
+	const vector<class SweepSegment> *segs;
+	Point pt;
+	double eps;
+};
+
+///Height of a segment where it crosses the sweep line. Vertical segments
+///are treated as being at the sweep point itself, within their extent.
+static double SweepY(const class SweepSegment &s, const Point &pt)
+{
+	if(s.p.first == s.q.first)
+		return max(s.p.second, min(pt.second, s.q.second));
+	if(pt.first <= s.p.first) return s.p.second;
+	if(pt.first >= s.q.first) return s.q.second;
+	double t = (pt.first - s.p.first) / (s.q.first - s.p.first);
+	return s.p.second + t * (s.q.second - s.p.second);
+}
+
+static bool SweepContains(const class SweepSegment &s, const Point &pt, double eps)
+{
+	if(pt.first < s.p.first - eps || pt.first > s.q.first + eps)
+		return false;
+	return fabs(SweepY(s, pt) - pt.second) <= eps;
+}
+
+static bool NearPoint(const Point &a, const Point &b, double eps)
+{
+	return fabs(a.first - b.first) <= eps && fabs(a.second - b.second) <= eps;
+}
+
+///Whether a segment and the next one in its contour meet only at the point
+///they share, rather than doubling back along each other
+static bool MeetOnlyAtJoin(const class SweepSegment &s, const class SweepSegment &next, double eps)
+{
+	const Point &join = s.end;
+	const Point &start = s.end == s.q ? s.p : s.q;
+	double ux = start.first - join.first, uy = start.second - join.second;
+	double vx = next.end.first - join.first, vy = next.end.second - join.second;
+	double cross = ux * vy - uy * vx;
+	double dot = ux * vx + uy * vy;
+	double maxLen = sqrt(max(ux*ux + uy*uy, vx*vx + vy*vy));
+	return fabs(cross) > eps * maxLen || dot <= 0.0;
+}
+
+///Order of segments along the sweep line, just after the sweep point. The
+///probe value sorts before every segment passing through the sweep point.
+class StatusLess
+{
+public:
+	const class SweepState *state;
+
+	StatusLess(const class SweepState *state) : state(state) {}
+
+	bool operator()(size_t a, size_t b) const
+	{
+		if(a == b)
+			return false;
+		const vector<class SweepSegment> &segs = *state->segs;
+		double ya = state->pt.second, sa = -numeric_limits<double>::infinity();
+		double yb = state->pt.second, sb = -numeric_limits<double>::infinity();
+		if(a != SWEEP_PROBE)
+		{
+			ya = SweepY(segs[a], state->pt);
+			sa = segs[a].slope;
+		}
+		if(b != SWEEP_PROBE)
+		{
+			yb = SweepY(segs[b], state->pt);
+			sb = segs[b].slope;
+		}
+
+		if(ya < yb - state->eps) return true;
+		if(yb < ya - state->eps) return false;
+		if(sa != sb) return sa < sb;
+		return a < b;
+	}
+};
+
+typedef set<size_t, class StatusLess> SweepStatus;
+
+class SweepEvent
+{
+public:
+	vector<size_t> starts, ends;
+};
+
+typedef map<Point, class SweepEvent> SweepEvents;
+
+///Queue an event if two segments meet ahead of the sweep line
+static void CheckForEvent(const vector<class SweepSegment> &segs, size_t a, size_t b,
+	const Point &pt, double eps, SweepEvents &events)
+{
+	const class SweepSegment &sa = segs[a];
+	const class SweepSegment &sb = segs[b];
+	double ix = 0.0, iy = 0.0;
+	if(!SegmentSegmentIntersect(sa.p.first, sa.p.second, sa.q.first, sa.q.second,
+		sb.p.first, sb.p.second, sb.q.first, sb.q.second, ix, iy))
+		return;
+
+	//Events are handled in order of x then y, so only those before the sweep
+	//point, or at it, have already been handled
+	Point ipt(ix, iy);
+	if(ipt < pt || NearPoint(ipt, pt, eps))
+		return;
+	events[ipt];
+}
+
+void FindSegmentIntersections(const Contours &contours, bool closedLoop,
+	std::vector<class SegmentIntersection> &intersectionsOut)
+{
+	intersectionsOut.clear();
+
+	//Build segments with left to right end points
+	vector<class SweepSegment> segs;
+	double minv = 0.0, maxv = 0.0;
+	for(size_t i = 0; i < contours.size(); i++)
+	{
+		const Contour &contour = contours[i];
+		size_t n = contour.size();
+		size_t numSegs = n >= 2 ? n-1 : 0;
+		if(closedLoop && n > 2)
+			numSegs = n;
+
+		size_t firstInContour = segs.size();
+		for(size_t j = 0; j < numSegs; j++)
+		{
+			const Point &a = contour[j];
+			const Point &b = contour[(j+1) % n];
+			minv = min(minv, min(min(a.first, a.second), min(b.first, b.second)));
+			maxv = max(maxv, max(max(a.first, a.second), max(b.first, b.second)));
+			if(a == b)
+				continue;
+
+			class SweepSegment seg;
+			seg.p = min(a, b);
+			seg.q = max(a, b);
+			seg.end = b;
+			if(seg.p.first == seg.q.first)
+				seg.slope = numeric_limits<double>::infinity();
+			else
+				seg.slope = (seg.q.second - seg.p.second) / (seg.q.first - seg.p.first);
+			seg.contour = i;
+			seg.segment = j;
+			seg.next = NO_SEGMENT;
+			if(segs.size() > firstInContour)
+				segs.back().next = segs.size();
+			segs.push_back(seg);
+		}
+		if(closedLoop && n > 2 && segs.size() - firstInContour > 1)
+			segs.back().next = firstInContour;
+	}
+
+	class SweepState state;
+	state.segs = &segs;
+	state.eps = 1e-9 * max(1.0, maxv - minv);
+
+	SweepEvents events;
+	for(size_t i = 0; i < segs.size(); i++)
+	{
+		events[segs[i].p].starts.push_back(i);
+		events[segs[i].q].ends.push_back(i);
+	}
+
+	SweepStatus status((StatusLess(&state)));
+	vector<SweepStatus::iterator> statusPos(segs.size(), status.end());
+	vector<size_t> mark(segs.size(), 0);
+	size_t eventNum = 0;
+	set<pair<size_t, size_t> > reported;
+	vector<size_t> involved, passing;
+
+	while(events.size() > 0)
+	{
+		Point pt = events.begin()->first;
+		class SweepEvent ev;
+		ev.starts.swap(events.begin()->second.starts);
+		ev.ends.swap(events.begin()->second.ends);
+		events.erase(events.begin());
+		state.pt = pt;
+		eventNum++;
+
+		//Segments ending here are known, find those passing through
+		for(size_t i = 0; i < ev.ends.size(); i++)
+			mark[ev.ends[i]] = eventNum;
+		passing.clear();
+		SweepStatus::iterator it = status.lower_bound(SWEEP_PROBE);
+		while(it != status.end() && fabs(SweepY(segs[*it], pt) - pt.second) <= state.eps)
+		{
+			if(mark[*it] != eventNum && SweepContains(segs[*it], pt, state.eps))
+				passing.push_back(*it);
+			++it;
+		}
+
+		//Report every pair meeting at this point
+		involved.assign(ev.starts.begin(), ev.starts.end());
+		involved.insert(involved.end(), ev.ends.begin(), ev.ends.end());
+		involved.insert(involved.end(), passing.begin(), passing.end());
+		for(size_t i = 0; i < involved.size(); i++)
+		{
+			for(size_t j = i+1; j < involved.size(); j++)
+			{
+				size_t a = min(involved[i], involved[j]);
+				size_t b = max(involved[i], involved[j]);
+				if(segs[a].next == b && NearPoint(segs[a].end, pt, state.eps)
+					&& MeetOnlyAtJoin(segs[a], segs[b], state.eps))
+					continue;
+				if(segs[b].next == a && NearPoint(segs[b].end, pt, state.eps)
+					&& MeetOnlyAtJoin(segs[b], segs[a], state.eps))
+					continue;
+				if(!reported.insert(pair<size_t, size_t>(a, b)).second)
+					continue;
+				intersectionsOut.push_back(SegmentIntersection(pt,
+					segs[a].contour, segs[a].segment, segs[b].contour, segs[b].segment));
+			}
+		}
+
+		//Remove segments ending or passing here, then reinsert the passing ones
+		//in their order after this point
+		for(size_t i = 0; i < ev.ends.size(); i++)
+		{
+			size_t s = ev.ends[i];
+			if(statusPos[s] != status.end())
+			{
+				status.erase(statusPos[s]);
+				statusPos[s] = status.end();
+			}
+		}
+		for(size_t i = 0; i < passing.size(); i++)
+			status.erase(statusPos[passing[i]]);
+
+		passing.insert(passing.end(), ev.starts.begin(), ev.starts.end());
+		for(size_t i = 0; i < passing.size(); i++)
+			statusPos[passing[i]] = status.insert(passing[i]).first;
+
+		//Check new neighbours for intersections ahead
+		if(passing.size() == 0)
+		{
+			it = status.lower_bound(SWEEP_PROBE);
+			if(it != status.end() && it != status.begin())
+			{
+				SweepStatus::iterator below = it;
+				--below;
+				CheckForEvent(segs, *below, *it, pt, state.eps, events);
+			}
+			continue;
+		}
+
+		size_t lowest = *min_element(passing.begin(), passing.end(), status.key_comp());
+		size_t highest = *max_element(passing.begin(), passing.end(), status.key_comp());
+		SweepStatus::iterator lowIt = statusPos[lowest];
+		if(lowIt != status.begin())
+		{
+			SweepStatus::iterator below = lowIt;
+			--below;
+			CheckForEvent(segs, *below, lowest, pt, state.eps, events);
+		}
+		SweepStatus::iterator above = statusPos[highest];
+		++above;
+		if(above != status.end())
+			CheckForEvent(segs, highest, *above, pt, state.eps, events);
+	}
+}
+
+///Small deterministic generator for the tests
+static double SweepTestRandom(unsigned &state, double lo, double hi)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return lo + (hi - lo) * (state / 4294967296.0);
+}
+
+void FindSegmentIntersectionsTests()
+{
+	// ** Two crossing lines and one apart **
+	Contours lines;
+	Contour line1;
+	line1.push_back(Point(0.0, 0.0));
+	line1.push_back(Point(10.0, 10.0));
+	lines.push_back(line1);
+	Contour line2;
+	line2.push_back(Point(0.0, 10.0));
+	line2.push_back(Point(10.0, 0.0));
+	lines.push_back(line2);
+	Contour line3;
+	line3.push_back(Point(20.0, 0.0));
+	line3.push_back(Point(30.0, 0.0));
+	lines.push_back(line3);
+
+	std::vector<class SegmentIntersection> found;
+	FindSegmentIntersections(lines, false, found);
+	cout << "intersections " << found.size() << endl;
+	assert(found.size() == 1);
+	assert(found[0].contour1 == 0 && found[0].contour2 == 1);
+	assert(fabs(found[0].pt.first - 5.0) < 1e-6);
+	assert(fabs(found[0].pt.second - 5.0) < 1e-6);
+
+	// ** Self intersecting bow tie, as a closed loop **
+	Contours bowTie;
+	Contour ring;
+	ring.push_back(Point(0.0, 0.0));
+	ring.push_back(Point(10.0, 10.0));
+	ring.push_back(Point(10.0, 0.0));
+	ring.push_back(Point(0.0, 10.0));
+	bowTie.push_back(ring);
+	FindSegmentIntersections(bowTie, true, found);
+	assert(found.size() == 1);
+	assert(found[0].segment1 == 0 && found[0].segment2 == 2);
+
+	// ** Simple square has no self intersections **
+	bowTie[0][1] = Point(10.0, 0.0);
+	bowTie[0][2] = Point(10.0, 10.0);
+	FindSegmentIntersections(bowTie, true, found);
+	assert(found.size() == 0);
+
+	// ** Vertical line through a vertex of a horizontal line and another crossing it **
+	Contours mixed;
+	Contour vert;
+	vert.push_back(Point(5.0, -5.0));
+	vert.push_back(Point(5.0, 5.0));
+	mixed.push_back(vert);
+	Contour horiz;
+	horiz.push_back(Point(0.0, 0.0));
+	horiz.push_back(Point(5.0, 0.0));
+	horiz.push_back(Point(9.0, 0.0));
+	mixed.push_back(horiz);
+	Contour diag;
+	diag.push_back(Point(0.0, -4.0));
+	diag.push_back(Point(9.0, 5.0));
+	mixed.push_back(diag);
+	FindSegmentIntersections(mixed, false, found);
+	assert(found.size() == 4);
+
+	// ** Closed loop doubling back over itself, after a zero length segment **
+	Contours doubled;
+	Contour there;
+	there.push_back(Point(0.0, 1.0));
+	there.push_back(Point(4.0, 3.0));
+	there.push_back(Point(4.0, 3.0));
+	doubled.push_back(there);
+	FindSegmentIntersections(doubled, true, found);
+	assert(found.size() == 1);
+	assert(found[0].segment1 == 0 && found[0].segment2 == 2);
+
+	// ** Open line turning back along itself **
+	doubled[0][2] = Point(2.0, 2.0);
+	FindSegmentIntersections(doubled, false, found);
+	assert(found.size() == 1);
+	assert(found[0].segment1 == 0 && found[0].segment2 == 1);
+
+	// ** Crossing just behind the sweep point in x, but above it **
+	Contours near(3, Contour(2));
+	near[0][0] = Point(989.044, 663.059); near[0][1] = Point(255.850, 458.308);
+	near[1][0] = Point(586.875, 551.051); near[1][1] = Point(404.560, 496.925);
+	near[2][0] = Point(569.489, 267.402); near[2][1] = Point(569.436, 949.413);
+	FindSegmentIntersections(near, false, found);
+	assert(found.size() == 3);
+
+	// ** Random segments against checking every pair **
+	unsigned state = 1;
+	for(int trial = 0; trial < 4; trial++)
+	{
+		Contours segs(1500, Contour(2));
+		for(size_t i = 0; i < segs.size(); i++)
+			for(int j = 0; j < 2; j++)
+				segs[i][j] = Point(SweepTestRandom(state, 0.0, 1000.0), SweepTestRandom(state, 0.0, 1000.0));
+		set<pair<size_t, size_t> > expected;
+		for(size_t i = 0; i < segs.size(); i++)
+			for(size_t j = i+1; j < segs.size(); j++)
+			{
+				double ix = 0.0, iy = 0.0;
+				if(SegmentSegmentIntersect(segs[i][0].first, segs[i][0].second, segs[i][1].first, segs[i][1].second,
+					segs[j][0].first, segs[j][0].second, segs[j][1].first, segs[j][1].second, ix, iy))
+					expected.insert(pair<size_t, size_t>(i, j));
+			}
+		FindSegmentIntersections(segs, false, found);
+		set<pair<size_t, size_t> > swept;
+		for(size_t i = 0; i < found.size(); i++)
+			swept.insert(pair<size_t, size_t>(found[i].contour1, found[i].contour2));
+		cout << "random crossings " << expected.size() << " found " << found.size() << endl;
+		assert(swept.size() == found.size());
+		assert(swept == expected);
+	}
+}
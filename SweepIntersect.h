@@ -0,0 +1,28 @@
+#ifndef _SWEEP_INTERSECT_H
+#define _SWEEP_INTERSECT_H
+#include "drawlib.h"
+
+///Intersection between two segments of a set of contours. Segment j of a
+///contour runs from point j to point j+1 (or back to point 0 for the closing
+///segment of a closed loop).
+class SegmentIntersection
+{
+public:
+	Point pt;
+	size_t contour1, segment1;
+	size_t contour2, segment2;
+
+	SegmentIntersection();
+	SegmentIntersection(const Point &pt, size_t contour1, size_t segment1, size_t contour2, size_t segment2);
+};
+
+///Find every pair of intersecting segments in a set of contours with a
+///Bentley-Ottmann sweep, in O((n+k) log n) time. Each pair is reported once.
+///Neighbouring segments of the same contour that only meet at their shared
+///point are not reported. Zero length segments are ignored.
+void FindSegmentIntersections(const Contours &contours, bool closedLoop,
+	std::vector<class SegmentIntersection> &intersectionsOut);
+
+void FindSegmentIntersectionsTests();
+
+#endif //_SWEEP_INTERSECT_H
@@ -0,0 +1,816 @@
+//Polygon triangulation by ear clipping with hole elimination and z-order
+//hashing, following the earcut algorithm https://github.com/mapbox/earcut
+//(ISC licence). Also see "Triangulation by Ear Clipping", David Eberly
+//https://www.geometrictools.com/Documentation/TriangulationByEarClipping.pdf
+
+#include <iostream>
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <algorithm>
+#include <assert.h>
+#include <stdint.h>
+#include "Tessellate.h"
+#include "ScanlineRaster.h"
+using namespace std;
+
+///Ring vertex in a circular doubly linked list, also linked in z-order
+class EarNode
+{
+public:
+	unsigned int i; //Vertex number in the mesh
+	double x, y;
+	EarNode *prev, *next;
+	int32_t z; //Z-order curve value
+	EarNode *prevZ, *nextZ;
+	bool steiner; //Hole of a single point
+
+	EarNode(unsigned int i, double x, double y) : i(i), x(x), y(y), prev(NULL), next(NULL),
+		z(0), prevZ(NULL), nextZ(NULL), steiner(false)
+	{}
+};
+
+///Rings bigger than this use z-order hashing to find points inside ears
+static const size_t EAR_HASH_THRESHOLD = 80;
+
+class EarClipper
+{
+public:
+	std::deque<class EarNode> nodes; //Keeps node addresses fixed as it grows
+	std::vector<unsigned int> *triangles;
+	double minX, minY, invSize;
+
+	EarNode *CreateNode(unsigned int i, double x, double y)
+	{
+		this->nodes.push_back(EarNode(i, x, y));
+		return &this->nodes.back();
+	}
+
+	EarNode *InsertNode(unsigned int i, double x, double y, EarNode *last)
+	{
+		EarNode *p = this->CreateNode(i, x, y);
+		if(last == NULL)
+		{
+			p->prev = p;
+			p->next = p;
+		}
+		else
+		{
+			p->next = last->next;
+			p->prev = last;
+			last->next->prev = p;
+			last->next = p;
+		}
+		return p;
+	}
+
+	static void RemoveNode(EarNode *p)
+	{
+		p->next->prev = p->prev;
+		p->prev->next = p->next;
+		if(p->prevZ) p->prevZ->nextZ = p->nextZ;
+		if(p->nextZ) p->nextZ->prevZ = p->prevZ;
+	}
+
+	EarNode *LinkedList(const Contour &ring, unsigned int firstVertex, bool clockwise);
+	EarNode *FilterPoints(EarNode *start, EarNode *end = NULL);
+	void EarcutLinked(EarNode *ear, int pass);
+	bool IsEar(EarNode *ear);
+	bool IsEarHashed(EarNode *ear);
+	EarNode *CureLocalIntersections(EarNode *start);
+	void SplitEarcut(EarNode *start);
+	EarNode *EliminateHoles(const Contours &holes, unsigned int firstVertex, EarNode *outerNode);
+	EarNode *EliminateHole(EarNode *hole, EarNode *outerNode);
+	EarNode *FindHoleBridge(EarNode *hole, EarNode *outerNode);
+	void IndexCurve(EarNode *start);
+	EarNode *SplitPolygon(EarNode *a, EarNode *b);
+	int32_t ZOrder(double x, double y) const;
+
+	void AddTriangle(const EarNode *a, const EarNode *b, const EarNode *c)
+	{
+		this->triangles->push_back(a->i);
+		this->triangles->push_back(b->i);
+		this->triangles->push_back(c->i);
+	}
+};
+
+// ************* Geometric predicates *************
+
+///Twice the signed area of a triangle, positive if it turns one way
+inline double Area(const EarNode *p, const EarNode *q, const EarNode *r)
+{
+	return (q->y - p->y) * (r->x - q->x) - (q->x - p->x) * (r->y - q->y);
+}
+
+inline bool Equals(const EarNode *p1, const EarNode *p2)
+{
+	return p1->x == p2->x && p1->y == p2->y;
+}
+
+inline bool PointInTriangle(double ax, double ay, double bx, double by, double cx, double cy, double px, double py)
+{
+	return (cx - px) * (ay - py) >= (ax - px) * (cy - py) &&
+		(ax - px) * (by - py) >= (bx - px) * (ay - py) &&
+		(bx - px) * (cy - py) >= (cx - px) * (by - py);
+}
+
+inline int Sign(double val)
+{
+	return (val > 0.0) - (val < 0.0);
+}
+
+///For collinear p, q, r, check if q is on segment pr
+inline bool OnSegment(const EarNode *p, const EarNode *q, const EarNode *r)
+{
+	return q->x <= max(p->x, r->x) && q->x >= min(p->x, r->x) &&
+		q->y <= max(p->y, r->y) && q->y >= min(p->y, r->y);
+}
+
+static bool Intersects(const EarNode *p1, const EarNode *q1, const EarNode *p2, const EarNode *q2)
+{
+	int o1 = Sign(Area(p1, q1, p2));
+	int o2 = Sign(Area(p1, q1, q2));
+	int o3 = Sign(Area(p2, q2, p1));
+	int o4 = Sign(Area(p2, q2, q1));
+
+	if(o1 != o2 && o3 != o4) return true;
+	if(o1 == 0 && OnSegment(p1, p2, q1)) return true;
+	if(o2 == 0 && OnSegment(p1, q2, q1)) return true;
+	if(o3 == 0 && OnSegment(p2, p1, q2)) return true;
+	if(o4 == 0 && OnSegment(p2, q1, q2)) return true;
+	return false;
+}
+
+///Check if a diagonal from a to b crosses any edge of the ring
+static bool IntersectsPolygon(const EarNode *a, const EarNode *b)
+{
+	const EarNode *p = a;
+	do
+	{
+		if(p->i != a->i && p->next->i != a->i && p->i != b->i && p->next->i != b->i &&
+			Intersects(p, p->next, a, b))
+			return true;
+		p = p->next;
+	} while(p != a);
+	return false;
+}
+
+///Check if a diagonal from a to b starts inside the ring at a
+static bool LocallyInside(const EarNode *a, const EarNode *b)
+{
+	if(Area(a->prev, a, a->next) < 0.0)
+		return Area(a, b, a->next) >= 0.0 && Area(a, a->prev, b) >= 0.0;
+	return Area(a, b, a->prev) < 0.0 || Area(a, a->next, b) < 0.0;
+}
+
+///Check if the middle of a diagonal is inside the ring
+static bool MiddleInside(const EarNode *a, const EarNode *b)
+{
+	const EarNode *p = a;
+	bool inside = false;
+	double px = 0.5 * (a->x + b->x), py = 0.5 * (a->y + b->y);
+	do
+	{
+		if(((p->y > py) != (p->next->y > py)) && p->next->y != p->y &&
+			(px < (p->next->x - p->x) * (py - p->y) / (p->next->y - p->y) + p->x))
+			inside = !inside;
+		p = p->next;
+	} while(p != a);
+	return inside;
+}
+
+static bool IsValidDiagonal(const EarNode *a, const EarNode *b)
+{
+	if(a->next->i == b->i || a->prev->i == b->i || IntersectsPolygon(a, b))
+		return false;
+	if(LocallyInside(a, b) && LocallyInside(b, a) && MiddleInside(a, b) &&
+		(Area(a->prev, a, b->prev) != 0.0 || Area(a, b->prev, b) != 0.0))
+		return true;
+	//Special case of zero length diagonals
+	return Equals(a, b) && Area(a->prev, a, a->next) > 0.0 && Area(b->prev, b, b->next) > 0.0;
+}
+
+static bool SectorContainsSector(const EarNode *m, const EarNode *p)
+{
+	return Area(m->prev, m, p->prev) < 0.0 && Area(p->next, m, m->next) < 0.0;
+}
+
+static EarNode *GetLeftmost(EarNode *start)
+{
+	EarNode *p = start, *leftmost = start;
+	do
+	{
+		if(p->x < leftmost->x || (p->x == leftmost->x && p->y < leftmost->y))
+			leftmost = p;
+		p = p->next;
+	} while(p != start);
+	return leftmost;
+}
+
+static bool CompareX(const EarNode *a, const EarNode *b)
+{
+	return a->x < b->x;
+}
+
+///Twice the signed area of a ring
+static double SignedArea(const Contour &ring)
+{
+	double sum = 0.0;
+	for(size_t i = 0, j = ring.size()-1; i < ring.size(); j = i++)
+		sum += (ring[j].first - ring[i].first) * (ring[i].second + ring[j].second);
+	return sum;
+}
+
+// ************* Ear clipping *************
+
+///Build a linked list from a ring in the given orientation
+EarNode *EarClipper::LinkedList(const Contour &ring, unsigned int firstVertex, bool clockwise)
+{
+	if(ring.size() == 0)
+		return NULL;
+	EarNode *last = NULL;
+	if(clockwise == (SignedArea(ring) > 0.0))
+	{
+		for(size_t i = 0; i < ring.size(); i++)
+			last = this->InsertNode(firstVertex + i, ring[i].first, ring[i].second, last);
+	}
+	else
+	{
+		for(size_t i = ring.size(); i-- > 0; )
+			last = this->InsertNode(firstVertex + i, ring[i].first, ring[i].second, last);
+	}
+
+	if(last != NULL && Equals(last, last->next))
+	{
+		RemoveNode(last);
+		last = last->next;
+	}
+	return last;
+}
+
+///Remove duplicate and collinear points
+EarNode *EarClipper::FilterPoints(EarNode *start, EarNode *end)
+{
+	if(start == NULL)
+		return start;
+	if(end == NULL)
+		end = start;
+
+	EarNode *p = start;
+	bool again = false;
+	do
+	{
+		again = false;
+		if(!p->steiner && (Equals(p, p->next) || Area(p->prev, p, p->next) == 0.0))
+		{
+			RemoveNode(p);
+			p = end = p->prev;
+			if(p == p->next)
+				break;
+			again = true;
+		}
+		else
+			p = p->next;
+	} while(again || p != end);
+	return end;
+}
+
+///Main ear slicing loop. Later passes repair self intersections, then split
+///the ring in two if no ears can be found.
+void EarClipper::EarcutLinked(EarNode *ear, int pass)
+{
+	if(ear == NULL)
+		return;
+	if(pass == 0 && this->invSize != 0.0)
+		this->IndexCurve(ear);
+
+	EarNode *stop = ear;
+	while(ear->prev != ear->next)
+	{
+		EarNode *prev = ear->prev;
+		EarNode *next = ear->next;
+
+		if(this->invSize != 0.0 ? this->IsEarHashed(ear) : this->IsEar(ear))
+		{
+			this->AddTriangle(prev, ear, next);
+			RemoveNode(ear);
+
+			//Skipping the next vertex leads to fewer sliver triangles
+			ear = next->next;
+			stop = next->next;
+			continue;
+		}
+
+		ear = next;
+		if(ear == stop)
+		{
+			if(pass == 0)
+				this->EarcutLinked(this->FilterPoints(ear), 1);
+			else if(pass == 1)
+			{
+				ear = this->CureLocalIntersections(this->FilterPoints(ear));
+				this->EarcutLinked(ear, 2);
+			}
+			else
+				this->SplitEarcut(ear);
+			break;
+		}
+	}
+}
+
+bool EarClipper::IsEar(EarNode *ear)
+{
+	const EarNode *a = ear->prev, *b = ear, *c = ear->next;
+	if(Area(a, b, c) >= 0.0)
+		return false; //Reflex
+
+	double x0 = min(a->x, min(b->x, c->x)), y0 = min(a->y, min(b->y, c->y));
+	double x1 = max(a->x, max(b->x, c->x)), y1 = max(a->y, max(b->y, c->y));
+
+	const EarNode *p = c->next;
+	while(p != a)
+	{
+		if(p->x >= x0 && p->x <= x1 && p->y >= y0 && p->y <= y1 &&
+			PointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, p->x, p->y) &&
+			Area(p->prev, p, p->next) >= 0.0)
+			return false;
+		p = p->next;
+	}
+	return true;
+}
+
+bool EarClipper::IsEarHashed(EarNode *ear)
+{
+	const EarNode *a = ear->prev, *b = ear, *c = ear->next;
+	if(Area(a, b, c) >= 0.0)
+		return false; //Reflex
+
+	double x0 = min(a->x, min(b->x, c->x)), y0 = min(a->y, min(b->y, c->y));
+	double x1 = max(a->x, max(b->x, c->x)), y1 = max(a->y, max(b->y, c->y));
+
+	//Only points within the z-order range of the triangle bounds can be inside
+	int32_t minZ = this->ZOrder(x0, y0);
+	int32_t maxZ = this->ZOrder(x1, y1);
+	const EarNode *p = ear->prevZ, *n = ear->nextZ;
+
+	while(p != NULL && p->z >= minZ && n != NULL && n->z <= maxZ)
+	{
+		if(p->x >= x0 && p->x <= x1 && p->y >= y0 && p->y <= y1 && p != a && p != c &&
+			PointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, p->x, p->y) && Area(p->prev, p, p->next) >= 0.0)
+			return false;
+		p = p->prevZ;
+
+		if(n->x >= x0 && n->x <= x1 && n->y >= y0 && n->y <= y1 && n != a && n != c &&
+			PointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, n->x, n->y) && Area(n->prev, n, n->next) >= 0.0)
+			return false;
+		n = n->nextZ;
+	}
+
+	while(p != NULL && p->z >= minZ)
+	{
+		if(p->x >= x0 && p->x <= x1 && p->y >= y0 && p->y <= y1 && p != a && p != c &&
+			PointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, p->x, p->y) && Area(p->prev, p, p->next) >= 0.0)
+			return false;
+		p = p->prevZ;
+	}
+
+	while(n != NULL && n->z <= maxZ)
+	{
+		if(n->x >= x0 && n->x <= x1 && n->y >= y0 && n->y <= y1 && n != a && n != c &&
+			PointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, n->x, n->y) && Area(n->prev, n, n->next) >= 0.0)
+			return false;
+		n = n->nextZ;
+	}
+	return true;
+}
+
+///Go through all polygon nodes and cure small local self intersections
+EarNode *EarClipper::CureLocalIntersections(EarNode *start)
+{
+	EarNode *p = start;
+	do
+	{
+		EarNode *a = p->prev, *b = p->next->next;
+		if(!Equals(a, b) && Intersects(a, p, p->next, b) && LocallyInside(a, b) && LocallyInside(b, a))
+		{
+			this->AddTriangle(a, p, b);
+			RemoveNode(p);
+			RemoveNode(p->next);
+			p = start = b;
+		}
+		p = p->next;
+	} while(p != start);
+	return this->FilterPoints(p);
+}
+
+///Try splitting the ring into two along a valid diagonal and triangulate them separately
+void EarClipper::SplitEarcut(EarNode *start)
+{
+	EarNode *a = start;
+	do
+	{
+		EarNode *b = a->next->next;
+		while(b != a->prev)
+		{
+			if(a->i != b->i && IsValidDiagonal(a, b))
+			{
+				EarNode *c = this->SplitPolygon(a, b);
+				a = this->FilterPoints(a, a->next);
+				c = this->FilterPoints(c, c->next);
+				this->EarcutLinked(a, 0);
+				this->EarcutLinked(c, 0);
+				return;
+			}
+			b = b->next;
+		}
+		a = a->next;
+	} while(a != start);
+}
+
+///Link every hole into the outer ring, from left to right
+EarNode *EarClipper::EliminateHoles(const Contours &holes, unsigned int firstVertex, EarNode *outerNode)
+{
+	std::vector<EarNode *> queue;
+	for(size_t i = 0; i < holes.size(); i++)
+	{
+		EarNode *list = this->LinkedList(holes[i], firstVertex, false);
+		firstVertex += holes[i].size();
+		if(list == NULL)
+			continue;
+		if(list == list->next)
+			list->steiner = true;
+		queue.push_back(GetLeftmost(list));
+	}
+	std::sort(queue.begin(), queue.end(), CompareX);
+
+	for(size_t i = 0; i < queue.size(); i++)
+		outerNode = this->EliminateHole(queue[i], outerNode);
+	return outerNode;
+}
+
+EarNode *EarClipper::EliminateHole(EarNode *hole, EarNode *outerNode)
+{
+	EarNode *bridge = this->FindHoleBridge(hole, outerNode);
+	if(bridge == NULL)
+		return outerNode;
+
+	EarNode *bridgeReverse = this->SplitPolygon(bridge, hole);
+	this->FilterPoints(bridgeReverse, bridgeReverse->next);
+	return this->FilterPoints(bridge, bridge->next);
+}
+
+///David Eberly's algorithm for finding a bridge between a hole and the outer ring
+EarNode *EarClipper::FindHoleBridge(EarNode *hole, EarNode *outerNode)
+{
+	EarNode *p = outerNode, *m = NULL;
+	double hx = hole->x, hy = hole->y;
+	double qx = -numeric_limits<double>::infinity();
+
+	//Find a segment intersected by a ray from the hole's leftmost point to the left.
+	//The segment's endpoint with lesser x will be a potential connection point.
+	do
+	{
+		if(hy <= p->y && hy >= p->next->y && p->next->y != p->y)
+		{
+			double x = p->x + (hy - p->y) * (p->next->x - p->x) / (p->next->y - p->y);
+			if(x <= hx && x > qx)
+			{
+				qx = x;
+				m = p->x < p->next->x ? p : p->next;
+				if(x == hx)
+					return m; //Hole touches the outer segment
+			}
+		}
+		p = p->next;
+	} while(p != outerNode);
+
+	if(m == NULL)
+		return NULL;
+
+	//Look for points inside the triangle of the hole point, segment intersection and
+	//endpoint. If there are none, that is the connection. Otherwise use the point
+	//with the smallest angle to the ray.
+	EarNode *stop = m;
+	double mx = m->x, my = m->y;
+	double tanMin = numeric_limits<double>::infinity();
+	p = m;
+	do
+	{
+		if(hx >= p->x && p->x >= mx && hx != p->x &&
+			PointInTriangle(hy < my ? hx : qx, hy, mx, my, hy < my ? qx : hx, hy, p->x, p->y))
+		{
+			double tanCur = fabs(hy - p->y) / (hx - p->x);
+			if(LocallyInside(p, hole) && (tanCur < tanMin || (tanCur == tanMin &&
+				(p->x > m->x || (p->x == m->x && SectorContainsSector(m, p))))))
+			{
+				m = p;
+				tanMin = tanCur;
+			}
+		}
+		p = p->next;
+	} while(p != stop);
+	return m;
+}
+
+///Link nodes in z-order, sorted with a linked list merge sort
+void EarClipper::IndexCurve(EarNode *start)
+{
+	EarNode *p = start;
+	do
+	{
+		if(p->z == 0)
+			p->z = this->ZOrder(p->x, p->y);
+		p->prevZ = p->prev;
+		p->nextZ = p->next;
+		p = p->next;
+	} while(p != start);
+	p->prevZ->nextZ = NULL;
+	p->prevZ = NULL;
+
+	EarNode *list = p;
+	int inSize = 1;
+	int numMerges = 0;
+	do
+	{
+		p = list;
+		list = NULL;
+		EarNode *tail = NULL;
+		numMerges = 0;
+		while(p != NULL)
+		{
+			numMerges++;
+			EarNode *q = p;
+			int pSize = 0;
+			for(int i = 0; i < inSize; i++)
+			{
+				pSize++;
+				q = q->nextZ;
+				if(q == NULL)
+					break;
+			}
+			int qSize = inSize;
+
+			while(pSize > 0 || (qSize > 0 && q != NULL))
+			{
+				EarNode *e = NULL;
+				if(pSize != 0 && (qSize == 0 || q == NULL || p->z <= q->z))
+				{
+					e = p;
+					p = p->nextZ;
+					pSize--;
+				}
+				else
+				{
+					e = q;
+					q = q->nextZ;
+					qSize--;
+				}
+				if(tail != NULL)
+					tail->nextZ = e;
+				else
+					list = e;
+				e->prevZ = tail;
+				tail = e;
+			}
+			p = q;
+		}
+		tail->nextZ = NULL;
+		inSize *= 2;
+	} while(numMerges > 1);
+}
+
+///Join a and b with a diagonal, making two rings. If a and b are in the same
+///ring it is split, otherwise the rings are merged.
+EarNode *EarClipper::SplitPolygon(EarNode *a, EarNode *b)
+{
+	EarNode *a2 = this->CreateNode(a->i, a->x, a->y);
+	EarNode *b2 = this->CreateNode(b->i, b->x, b->y);
+	EarNode *an = a->next;
+	EarNode *bp = b->prev;
+
+	a->next = b;
+	b->prev = a;
+	a2->next = an;
+	an->prev = a2;
+	b2->next = a2;
+	a2->prev = b2;
+	bp->next = b2;
+	b2->prev = bp;
+	return b2;
+}
+
+///Z-order of a point, from its coordinates scaled to 15 bits and interleaved
+int32_t EarClipper::ZOrder(double px, double py) const
+{
+	uint32_t x = (uint32_t)((px - this->minX) * this->invSize);
+	uint32_t y = (uint32_t)((py - this->minY) * this->invSize);
+
+	x = (x | (x << 8)) & 0x00FF00FF;
+	x = (x | (x << 4)) & 0x0F0F0F0F;
+	x = (x | (x << 2)) & 0x33333333;
+	x = (x | (x << 1)) & 0x55555555;
+
+	y = (y | (y << 8)) & 0x00FF00FF;
+	y = (y | (y << 4)) & 0x0F0F0F0F;
+	y = (y | (y << 2)) & 0x33333333;
+	y = (y | (y << 1)) & 0x55555555;
+
+	return (int32_t)(x | (y << 1));
+}
+
+// *************************************
+
+static void TessellatePolygon(class EarClipper &clipper, const Polygon &polygon, class TriangleMesh &meshOut)
+{
+	const Contour &outer = polygon.first;
+	const Contours &holes = polygon.second;
+	if(outer.size() < 3)
+		return;
+
+	unsigned int firstVertex = meshOut.vertices.size() / 2;
+	size_t numVertices = outer.size();
+	for(size_t i = 0; i < holes.size(); i++)
+		numVertices += holes[i].size();
+	for(size_t i = 0; i < outer.size(); i++)
+	{
+		meshOut.vertices.push_back((float)outer[i].first);
+		meshOut.vertices.push_back((float)outer[i].second);
+	}
+	for(size_t i = 0; i < holes.size(); i++)
+		for(size_t j = 0; j < holes[i].size(); j++)
+		{
+			meshOut.vertices.push_back((float)holes[i][j].first);
+			meshOut.vertices.push_back((float)holes[i][j].second);
+		}
+
+	clipper.nodes.clear();
+	clipper.triangles = &meshOut.indices;
+	clipper.invSize = 0.0;
+	size_t firstIndex = meshOut.indices.size();
+	EarNode *outerNode = clipper.LinkedList(outer, firstVertex, true);
+	if(outerNode == NULL || outerNode->next == outerNode->prev)
+	{
+		meshOut.vertices.resize(2 * firstVertex);
+		return;
+	}
+	if(holes.size() > 0)
+		outerNode = clipper.EliminateHoles(holes, firstVertex + outer.size(), outerNode);
+
+	//Hash points by z-order for faster ear checks on big polygons
+	if(numVertices > EAR_HASH_THRESHOLD)
+	{
+		double minX = outer[0].first, maxX = minX;
+		double minY = outer[0].second, maxY = minY;
+		for(size_t i = 1; i < outer.size(); i++)
+		{
+			minX = min(minX, outer[i].first);
+			maxX = max(maxX, outer[i].first);
+			minY = min(minY, outer[i].second);
+			maxY = max(maxY, outer[i].second);
+		}
+		double size = max(maxX - minX, maxY - minY);
+		clipper.minX = minX;
+		clipper.minY = minY;
+		clipper.invSize = size != 0.0 ? 32767.0 / size : 0.0;
+	}
+
+	clipper.EarcutLinked(outerNode, 0);
+
+	//Drop the vertices of a polygon with no area, so they are not taken as triangles
+	if(meshOut.indices.size() == firstIndex)
+		meshOut.vertices.resize(2 * firstVertex);
+}
+
+void TessellatePolygon(const Polygon &polygon, class TriangleMesh &meshOut)
+{
+	class EarClipper clipper;
+	TessellatePolygon(clipper, polygon, meshOut);
+	meshOut.built = true;
+}
+
+void TessellatePolygons(const std::vector<Polygon> &polygons, class TriangleMesh &meshOut)
+{
+	meshOut.Clear();
+	size_t numVertices = 0;
+	for(size_t i = 0; i < polygons.size(); i++)
+	{
+		numVertices += polygons[i].first.size();
+		for(size_t j = 0; j < polygons[i].second.size(); j++)
+			numVertices += polygons[i].second[j].size();
+	}
+	meshOut.vertices.reserve(2 * numVertices);
+	meshOut.indices.reserve(3 * numVertices);
+
+	class EarClipper clipper;
+	for(size_t i = 0; i < polygons.size(); i++)
+		TessellatePolygon(clipper, polygons[i], meshOut);
+	meshOut.built = true;
+}
+
+void TessellateStroke(const Contours &lines, const class LineProperties &properties, double tolerance,
+	class TriangleMesh &meshOut)
+{
+	meshOut.Clear();
+	RasterLineJoin join = RASTER_JOIN_MITER;
+	RasterLineCap cap = RASTER_CAP_BUTT;
+	LineStyleFromProperties(properties, join, cap);
+
+	//Stroke pieces are convex, so each becomes a triangle fan
+	Contours rings;
+	for(size_t i = 0; i < lines.size(); i++)
+	{
+		StrokeToRings(lines[i], properties.lineWidth, properties.closedLoop, join, cap,
+			10.0, tolerance, rings); //Miter limit is the cairo default
+		for(size_t j = 0; j < rings.size(); j++)
+		{
+			const Contour &ring = rings[j];
+			for(size_t k = 1; k + 1 < ring.size(); k++)
+			{
+				meshOut.vertices.push_back((float)ring[0].first);
+				meshOut.vertices.push_back((float)ring[0].second);
+				meshOut.vertices.push_back((float)ring[k].first);
+				meshOut.vertices.push_back((float)ring[k].second);
+				meshOut.vertices.push_back((float)ring[k+1].first);
+				meshOut.vertices.push_back((float)ring[k+1].second);
+			}
+		}
+	}
+	meshOut.built = true;
+}
+
+// *************************************
+
+///Total area of the triangles in a mesh
+static double MeshArea(const class TriangleMesh &mesh)
+{
+	double area = 0.0;
+	bool indexed = mesh.indices.size() > 0;
+	for(size_t i = 0; i < 3 * mesh.NumTriangles(); i += 3)
+	{
+		const float *a = &mesh.vertices[2 * (indexed ? mesh.indices[i] : i)];
+		const float *b = &mesh.vertices[2 * (indexed ? mesh.indices[i+1] : i+1)];
+		const float *c = &mesh.vertices[2 * (indexed ? mesh.indices[i+2] : i+2)];
+		area += 0.5 * fabs((b[0] - a[0]) * (c[1] - a[1]) - (c[0] - a[0]) * (b[1] - a[1]));
+	}
+	return area;
+}
+
+void TessellatePolygonTests()
+{
+	// ** Square with a square hole, in the same orientation as the outer **
+	Polygon square;
+	square.first.push_back(Point(0.0, 0.0));
+	square.first.push_back(Point(10.0, 0.0));
+	square.first.push_back(Point(10.0, 10.0));
+	square.first.push_back(Point(0.0, 10.0));
+	Contour hole;
+	hole.push_back(Point(2.0, 2.0));
+	hole.push_back(Point(4.0, 2.0));
+	hole.push_back(Point(4.0, 4.0));
+	hole.push_back(Point(2.0, 4.0));
+	square.second.push_back(hole);
+
+	class TriangleMesh mesh;
+	TessellatePolygon(square, mesh);
+	cout << "square with hole triangles " << mesh.NumTriangles() << endl;
+	assert(mesh.built);
+	assert(mesh.NumVertices() == 8);
+	assert(mesh.NumTriangles() == 8);
+	assert(fabs(MeshArea(mesh) - 96.0) < 1e-6);
+
+	// ** Concave star, big enough for z-order hashing, with a closing point **
+	Polygon star;
+	for(int i = 0; i < 200; i++)
+	{
+		double ang = 2.0 * M_PI * i / 200;
+		double rad = i % 2 == 0 ? 100.0 : 40.0;
+		star.first.push_back(Point(rad * cos(ang), rad * sin(ang)));
+	}
+	star.first.push_back(star.first[0]);
+	double starArea = 0.5 * fabs(SignedArea(star.first));
+	std::vector<Polygon> polygons;
+	polygons.push_back(square);
+	polygons.push_back(star);
+	TessellatePolygons(polygons, mesh);
+	assert(mesh.NumTriangles() == 8 + 198);
+	assert(fabs(MeshArea(mesh) - 96.0 - starArea) < 1e-3 * starArea);
+
+	// ** Degenerate rings give no triangles **
+	Polygon line;
+	line.first.push_back(Point(0.0, 0.0));
+	line.first.push_back(Point(1.0, 1.0));
+	line.first.push_back(Point(2.0, 2.0));
+	TessellatePolygons(std::vector<Polygon>(1, line), mesh);
+	assert(mesh.built && mesh.NumTriangles() == 0);
+
+	// ** Straight stroke with butt caps covers its length times width, with no join **
+	class LineProperties lineProps(1.0, 1.0, 1.0, 2.0);
+	TessellateStroke(Contours(1, line.first), lineProps, 0.1, mesh);
+	assert(mesh.NumTriangles() == 4);
+	assert(fabs(MeshArea(mesh) - 2.0 * sqrt(8.0)) < 1e-5);
+
+	// ** Round caps add a circle at each end **
+	lineProps.lineCap = "round";
+	TessellateStroke(Contours(1, line.first), lineProps, 0.01, mesh);
+	assert(fabs(MeshArea(mesh) - 2.0 * sqrt(8.0) - 2.0 * M_PI) < 0.1); //Flattening loses a little
+}
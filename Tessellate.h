@@ -0,0 +1,22 @@
+#ifndef _TESSELLATE_H
+#define _TESSELLATE_H
+#include "drawlib.h"
+
+///Triangulate a polygon with holes by ear clipping, adding its vertices and
+///triangles to the end of a mesh. Holes are bridged to the outer ring first.
+///Rings may be in either orientation and may repeat their first point at the end.
+void TessellatePolygon(const Polygon &polygon, class TriangleMesh &meshOut);
+
+///Triangulate polygons into one mesh, which is cleared first
+void TessellatePolygons(const std::vector<Polygon> &polygons, class TriangleMesh &meshOut);
+
+///Expand lines into triangles covering their stroke, honouring the width,
+///join, cap and closed loop settings of the line properties. The mesh is
+///cleared first and has no indices, so each three vertices are a triangle.
+///Triangles overlap where pieces of the stroke meet.
+void TessellateStroke(const Contours &lines, const class LineProperties &properties, double tolerance,
+	class TriangleMesh &meshOut);
+
+void TessellatePolygonTests();
+
+#endif //_TESSELLATE_H
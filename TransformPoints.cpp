@@ -0,0 +1,82 @@
+//Bulk affine transform of stored coordinates. A Point is a pair of doubles,
+//so an array of points is packed as x, y, x, y... and can be loaded directly
+//into vector registers.
+
+#include "drawlib.h"
+#include "CpuFeatures.h"
+#ifdef DRAWLIB_X86_SIMD
+#include <immintrin.h>
+#endif
+using namespace std;
+
+//Points must be packed without padding for the vector loads
+typedef char PointIsPackedCheck[sizeof(Point) == 2 * sizeof(double) ? 1 : -1];
+
+static void TransformPointsScalar(const class AffineTransform &tr, Point *pts, size_t start, size_t count)
+{
+	for(size_t i = start; i < count; i++)
+	{
+		double x = pts[i].first, y = pts[i].second;
+		pts[i].first = tr.xx * x + tr.xy * y + tr.x0;
+		pts[i].second = tr.yx * x + tr.yy * y + tr.y0;
+	}
+}
+
+#ifdef DRAWLIB_X86_SIMD
+
+///One point per register
+__attribute__((target("sse2")))
+static size_t TransformPointsSse2(const class AffineTransform &tr, Point *pts, size_t count)
+{
+	double *coords = &pts[0].first;
+	__m128d colX = _mm_set_pd(tr.yx, tr.xx);
+	__m128d colY = _mm_set_pd(tr.yy, tr.xy);
+	__m128d offset = _mm_set_pd(tr.y0, tr.x0);
+	for(size_t i = 0; i < count; i++)
+	{
+		__m128d p = _mm_loadu_pd(coords + 2*i);
+		__m128d xs = _mm_unpacklo_pd(p, p);
+		__m128d ys = _mm_unpackhi_pd(p, p);
+		__m128d r = _mm_add_pd(_mm_add_pd(_mm_mul_pd(xs, colX), _mm_mul_pd(ys, colY)), offset);
+		_mm_storeu_pd(coords + 2*i, r);
+	}
+	return count;
+}
+
+///Two points per register
+__attribute__((target("avx")))
+static size_t TransformPointsAvx(const class AffineTransform &tr, Point *pts, size_t count)
+{
+	double *coords = &pts[0].first;
+	__m256d colX = _mm256_set_pd(tr.yx, tr.xx, tr.yx, tr.xx);
+	__m256d colY = _mm256_set_pd(tr.yy, tr.xy, tr.yy, tr.xy);
+	__m256d offset = _mm256_set_pd(tr.y0, tr.x0, tr.y0, tr.x0);
+	size_t i = 0;
+	for(; i + 2 <= count; i += 2)
+	{
+		__m256d p = _mm256_loadu_pd(coords + 2*i);
+		__m256d xs = _mm256_movedup_pd(p);
+		__m256d ys = _mm256_permute_pd(p, 0xF);
+		__m256d r = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(xs, colX), _mm256_mul_pd(ys, colY)), offset);
+		_mm256_storeu_pd(coords + 2*i, r);
+	}
+	return i;
+}
+
+#endif //DRAWLIB_X86_SIMD
+
+void TransformPoints(const class AffineTransform &transform, Point *pts, size_t count)
+{
+	if(count == 0 || transform.IsIdentity())
+		return;
+
+	size_t done = 0;
+#ifdef DRAWLIB_X86_SIMD
+	SimdLevel level = GetSimdLevel();
+	if(level >= SIMD_AVX)
+		done = TransformPointsAvx(transform, pts, count);
+	else if(level == SIMD_SSE2)
+		done = TransformPointsSse2(transform, pts, count);
+#endif
+	TransformPointsScalar(transform, pts, done, count);
+}
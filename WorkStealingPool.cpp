@@ -0,0 +1,140 @@
+#include "WorkStealingPool.h"
+using namespace std;
+
+WorkStealingPool::WorkStealingPool(int numThreads) : generation(0), busyWorkers(0),
+	stopping(false), func(NULL), userData(NULL)
+{
+	if(numThreads <= 0)
+		numThreads = thread::hardware_concurrency();
+	if(numThreads <= 0)
+		numThreads = 1;
+
+	for(int i=0; i < numThreads; i++)
+		this->queues.push_back(new class WorkerQueue());
+
+	//Worker 0 is whichever thread calls Run
+	for(int i=1; i < numThreads; i++)
+		this->threads.push_back(thread(&WorkStealingPool::WorkerMain, this, i));
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+	{
+		unique_lock<mutex> lock(this->poolMutex);
+		this->stopping = true;
+	}
+	this->startCond.notify_all();
+	for(size_t i=0; i < this->threads.size(); i++)
+		this->threads[i].join();
+
+	for(size_t i=0; i < this->queues.size(); i++)
+		delete this->queues[i];
+	this->queues.clear();
+}
+
+int WorkStealingPool::GetNumThreads() const
+{
+	return this->queues.size();
+}
+
+void WorkStealingPool::Run(const std::vector<size_t> &taskIds, TaskFunc func, void *userData)
+{
+	if(taskIds.size() == 0)
+		return;
+
+	unique_lock<mutex> lock(this->poolMutex);
+	size_t numQueues = this->queues.size();
+	for(size_t i=0; i < taskIds.size(); i++)
+		this->queues[i % numQueues]->tasks.push_back(taskIds[i]);
+
+	this->func = func;
+	this->userData = userData;
+	this->firstError = exception_ptr();
+	this->busyWorkers = numQueues;
+	this->generation ++;
+	lock.unlock();
+	this->startCond.notify_all();
+
+	this->RunTasks(0);
+
+	lock.lock();
+	this->busyWorkers --;
+	while(this->busyWorkers > 0)
+		this->doneCond.wait(lock);
+
+	exception_ptr err = this->firstError;
+	this->firstError = exception_ptr();
+	lock.unlock();
+	if(err)
+		rethrow_exception(err);
+}
+
+void WorkStealingPool::WorkerMain(int workerIndex)
+{
+	unsigned seenGeneration = 0;
+	while(true)
+	{
+		unique_lock<mutex> lock(this->poolMutex);
+		while(!this->stopping && this->generation == seenGeneration)
+			this->startCond.wait(lock);
+		if(this->stopping)
+			return;
+		seenGeneration = this->generation;
+		lock.unlock();
+
+		this->RunTasks(workerIndex);
+
+		lock.lock();
+		this->busyWorkers --;
+		if(this->busyWorkers == 0)
+			this->doneCond.notify_all();
+	}
+}
+
+void WorkStealingPool::RunTasks(int workerIndex)
+{
+	size_t taskId = 0;
+	while(this->NextTask(workerIndex, taskId))
+	{
+		try
+		{
+			this->func(taskId, workerIndex, this->userData);
+		}
+		catch(...)
+		{
+			unique_lock<mutex> lock(this->poolMutex);
+			if(!this->firstError)
+				this->firstError = current_exception();
+		}
+	}
+}
+
+bool WorkStealingPool::NextTask(int workerIndex, size_t &taskIdOut)
+{
+	//Take from the front of our own queue
+	class WorkerQueue *own = this->queues[workerIndex];
+	{
+		unique_lock<mutex> lock(own->queueMutex);
+		if(own->tasks.size() > 0)
+		{
+			taskIdOut = own->tasks.front();
+			own->tasks.pop_front();
+			return true;
+		}
+	}
+
+	//Steal from the back of other queues
+	size_t numQueues = this->queues.size();
+	for(size_t i=1; i < numQueues; i++)
+	{
+		class WorkerQueue *victim = this->queues[(workerIndex + i) % numQueues];
+		unique_lock<mutex> lock(victim->queueMutex);
+		if(victim->tasks.size() > 0)
+		{
+			taskIdOut = victim->tasks.back();
+			victim->tasks.pop_back();
+			return true;
+		}
+	}
+	return false;
+}
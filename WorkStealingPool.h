@@ -0,0 +1,57 @@
+#ifndef _WORK_STEALING_POOL_H
+#define _WORK_STEALING_POOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+///Runs batches of indexed tasks over a fixed set of threads. Each worker
+///takes tasks from the front of its own queue and, when that is empty,
+///steals from the back of the other workers' queues.
+class WorkStealingPool
+{
+public:
+	typedef void (*TaskFunc)(size_t taskId, int workerIndex, void *userData);
+
+protected:
+	class WorkerQueue
+	{
+	public:
+		std::mutex queueMutex;
+		std::deque<size_t> tasks;
+	};
+
+	std::vector<std::thread> threads;
+	std::vector<class WorkerQueue *> queues;
+	std::mutex poolMutex;
+	std::condition_variable startCond, doneCond;
+	unsigned generation;
+	int busyWorkers;
+	bool stopping;
+	TaskFunc func;
+	void *userData;
+	std::exception_ptr firstError;
+
+	void WorkerMain(int workerIndex);
+	void RunTasks(int workerIndex);
+	bool NextTask(int workerIndex, size_t &taskIdOut);
+
+public:
+	///numThreads of zero or less uses the hardware concurrency
+	WorkStealingPool(int numThreads = 0);
+	virtual ~WorkStealingPool();
+
+	int GetNumThreads() const;
+
+	///Run func for every task id and block until all have finished. The
+	///calling thread works as worker 0. Tasks are dealt out in the given
+	///order, so put expensive tasks first. The first exception thrown by a
+	///task is rethrown here once the batch has finished. Only one thread
+	///may call Run at a time.
+	void Run(const std::vector<size_t> &taskIds, TaskFunc func, void *userData);
+};
+
+#endif //_WORK_STEALING_POOL_H
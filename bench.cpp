@@ -0,0 +1,609 @@
+//Microbenchmarks of the geometry and text kernels. Each benchmark runs on
+//seeded synthetic data and prints one JSON object per line:
+//{"name": ..., "iterations": ..., "ns_per_op": ..., "ops_per_s": ..., "allocs_per_op": ...}
+//Allocations are C++ operator new calls; memory allocated inside cairo and
+//pango is not counted.
+//
+//Usage: bench [name filter] [min seconds per benchmark]
+
+#include <new>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "drawlibcairo.h"
+#include "DrawLibRaster.h"
+#include "DrawLibTiled.h"
+#include "cairotwisted.h"
+#include "RdpSimplify.h"
+#include "LineLineIntersect.h"
+#include "BezierFit.h"
+#include "Tessellate.h"
+using namespace std;
+
+static size_t allocCount = 0;
+
+void *operator new(size_t size)
+{
+	allocCount++;
+	void *ptr = malloc(size > 0 ? size : 1);
+	if(ptr == NULL)
+		throw bad_alloc();
+	return ptr;
+}
+
+void *operator new[](size_t size)
+{
+	allocCount++;
+	void *ptr = malloc(size > 0 ? size : 1);
+	if(ptr == NULL)
+		throw bad_alloc();
+	return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+	free(ptr);
+}
+
+// *************************************
+
+///Timing and allocation counts of one run of a benchmark. The benchmark
+///function does its setup, then calls Start, runs the operation
+///iterations times and calls Stop.
+class BenchState
+{
+public:
+	size_t iterations;
+	double elapsedNs;
+	size_t allocs;
+
+	BenchState(size_t iterations) : iterations(iterations), elapsedNs(0.0), allocs(0), startAllocs(0) {}
+
+	void Start()
+	{
+		this->startAllocs = allocCount;
+		this->startTime = chrono::steady_clock::now();
+	}
+
+	void Stop()
+	{
+		chrono::steady_clock::time_point endTime = chrono::steady_clock::now();
+		this->allocs = allocCount - this->startAllocs;
+		this->elapsedNs = chrono::duration<double, nano>(endTime - this->startTime).count();
+	}
+
+private:
+	chrono::steady_clock::time_point startTime;
+	size_t startAllocs;
+};
+
+typedef void (*BenchFunc)(class BenchState &state);
+
+///Small deterministic generator, so data is the same on every platform
+class BenchRandom
+{
+public:
+	unsigned state;
+
+	BenchRandom(unsigned seed) : state(seed ? seed : 1) {}
+
+	double Uniform(double lo, double hi)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return lo + (hi - lo) * (state / 4294967296.0);
+	}
+};
+
+static volatile double benchSink = 0.0; //Keeps results from being optimized away
+
+static Contour RandomWalk(size_t numPoints, unsigned seed, double x0 = 320.0, double y0 = 240.0, double step = 4.0)
+{
+	class BenchRandom rnd(seed);
+	Contour line;
+	line.reserve(numPoints);
+	double x = x0, y = y0, ang = 0.0;
+	for(size_t i = 0; i < numPoints; i++)
+	{
+		line.push_back(Point(x, y));
+		ang += rnd.Uniform(-0.5, 0.5);
+		x += step * cos(ang);
+		y += step * sin(ang);
+	}
+	return line;
+}
+
+///Star shaped ring, which is concave but not self intersecting
+static Contour RandomStar(class BenchRandom &rnd, double cx, double cy, double radius, int numPoints)
+{
+	Contour ring;
+	for(int i = 0; i < numPoints; i++)
+	{
+		double ang = 2.0 * M_PI * i / numPoints;
+		double r = radius * rnd.Uniform(0.5, 1.0);
+		ring.push_back(Point(cx + r * cos(ang), cy + r * sin(ang)));
+	}
+	return ring;
+}
+
+static cairo_surface_t *CreateBenchSurface()
+{
+	return cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 640, 480);
+}
+
+// ************* Geometry *************
+
+static void BenchRamerDouglasPeucker(class BenchState &state)
+{
+	Contour line = RandomWalk(10000, 1);
+	Contour out;
+	state.Start();
+	for(size_t i = 0; i < state.iterations; i++)
+	{
+		RamerDouglasPeucker(line, 2.0, out);
+		benchSink = out.size();
+	}
+	state.Stop();
+}
+
+class SegmentArrays
+{
+public:
+	vector<double> x1, y1, x2, y2;
+
+	SegmentArrays(size_t count, unsigned seed)
+	{
+		class BenchRandom rnd(seed);
+		for(size_t i = 0; i < count; i++)
+		{
+			x1.push_back(rnd.Uniform(0.0, 100.0)); y1.push_back(rnd.Uniform(0.0, 100.0));
+			x2.push_back(rnd.Uniform(0.0, 100.0)); y2.push_back(rnd.Uniform(0.0, 100.0));
+		}
+	}
+};
+
+static void BenchLineLineIntersect(class BenchState &state)
+{
+	class SegmentArrays segs(1024, 2);
+	double sum = 0.0;
+	state.Start();
+	for(size_t i = 0; i < state.iterations; i++)
+	{
+		size_t j = i & 1023, k = (i * 7 + 1) & 1023;
+		double ix = 0.0, iy = 0.0;
+		if(LineLineIntersect(segs.x1[j], segs.y1[j], segs.x2[j], segs.y2[j],
+			segs.x1[k], segs.y1[k], segs.x2[k], segs.y2[k], ix, iy))
+			sum += ix;
+	}
+	state.Stop();
+	benchSink = sum;
+}
+
+static void BenchLineLineIntersectBatch(class BenchState &state)
+{
+	class SegmentArrays segs(1024, 3);
+	vector<unsigned char> found(1024);
+	vector<double> ix(1024), iy(1024);
+	size_t total = 0;
+	state.Start();
+	for(size_t i = 0; i < state.iterations; i++)
+	{
+		size_t j = i & 1023;
+		total += LineLineIntersectBatch(segs.x1[j], segs.y1[j], segs.x2[j], segs.y2[j],
+			&segs.x1[0], &segs.y1[0], &segs.x2[0], &segs.y2[0], 1024, true,
+			&found[0], &ix[0], &iy[0]);
+	}
+	state.Stop();
+	benchSink = total;
+}
+
+static void BenchFixBezierToPoints(class BenchState &state)
+{
+	Contour line = RandomWalk(200, 4);
+	class TwistedPath path;
+	state.Start();
+	for(size_t i = 0; i < state.iterations; i++)
+	{
+		FixBezierToPoints(line, path);
+		benchSink = path.Size();
+	}
+	state.Stop();
+}
+
+static void BenchTessellatePolygons(class BenchState &state)
+{
+	class BenchRandom rnd(9);
+	std::vector<Polygon> polygons;
+	for(int i = 0; i < 100; i++)
+	{
+		double cx = rnd.Uniform(0.0, 640.0), cy = rnd.Uniform(0.0, 480.0);
+		Contour hole = RandomStar(rnd, cx, cy, 15.0, 12);
+		polygons.push_back(Polygon(RandomStar(rnd, cx, cy, 60.0, 100), Contours(1, hole)));
+	}
+	class TriangleMesh mesh;
+	state.Start();
+	for(size_t i = 0; i < state.iterations; i++)
+	{
+		TessellatePolygons(polygons, mesh);
+		benchSink = mesh.NumTriangles();
+	}
+	state.Stop();
+}
+
+static void BenchTessellateStroke(class BenchState &state)
+{
+	Contours lines;
+	for(unsigned i = 0; i < 50; i++)
+		lines.push_back(RandomWalk(200, 100+i));
+	class LineProperties properties(0.0, 0.5, 0.0, 2.0);
+	properties.lineJoin = "round";
+	class TriangleMesh mesh;
+	state.Start();
+	for(size_t i = 0; i < state.iterations; i++)
+	{
+		TessellateStroke(lines, properties, 0.1, mesh);
+		benchSink = mesh.NumTriangles();
+	}
+	state.Stop();
+}
+
+// ************* Twisted text internals *************
+
+static void BenchCurveLength(class BenchState &state)
+{
+	double sum = 0.0;
+	state.Start();
+	for(size_t i = 0; i < state.iterations; i++)
+		sum += curve_length(0.0, 0.0, 30.0, 80.0 + (i & 7), 120.0, -40.0, 150.0, 20.0);
+	state.Stop();
+	benchSink = sum;
+}
+
+///Flattened path of a fitted random walk, as used for twisted text
+class FlatPath
+{
+public:
+	cairo_surface_t *surface;
+	cairo_t *cr;
+	parametrized_path_t param;
+
+	FlatPath(size_t numPoints, unsigned seed)
+	{
+		this->surface = CreateBenchSurface();
+		this->cr = cairo_create(this->surface);
+		class TwistedPath path;
+		FixBezierToPoints(RandomWalk(numPoints, seed, 20.0, 240.0, 10.0), path);
+		RunTwistedCurveCmds(this->cr, path);
+		cairo_set_tolerance(this->cr, 0.01);
+		this->param.path = cairo_copy_path_flat(this->cr);
+		cairo_new_path(this->cr);
+	}
+
+	virtual ~FlatPath()
+	{
+		cairo_path_destroy(this->param.path);
+		cairo_destroy(this->cr);
+		cairo_surface_destroy(this->surface);
+	}
+};
+
+static void BenchParametrizePath(class BenchState &state)
+{
+	class FlatPath flat(50, 5);
+	vector<parametrization_t> parametrization;
+	state.Start();
+	for(size_t i = 0; i < state.iterations; i++)
+	{
+		parametrize_path(flat.param.path, parametrization);
+		benchSink = parametrization.size();
+	}
+	state.Stop();
+}
+
+static void BenchCalcTwistedBbox(class BenchState &state)
+{
+	class FlatPath flat(50, 6);
+	parametrize_path(flat.param.path, flat.param.parametrization);
+	PangoRectangle rect;
+	rect.x = 0; rect.y = -12; rect.width = 300; rect.height = 14;
+	TwistedTriangles triangles;
+	state.Start();
+	for(size_t i = 0; i < state.iterations; i++)
+	{
+		calc_twisted_bbox(rect, flat.param, 0.0, 0.0, triangles);
+		benchSink = triangles.size();
+	}
+	state.Stop();
+}
+
+static void BenchGetTriangleBoundsText(class BenchState &state)
+{
+	cairo_surface_t *surface = CreateBenchSurface();
+	class DrawLibCairoPango drawLib(surface);
+	class TextLabel label("Benchmark label text", 100.0, 100.0, 0.3);
+	class TextProperties properties(0.0, 0.0, 0.0);
+	TwistedTriangles triangles;
+	state.Start();
+	for(size_t i = 0; i < state.iterations; i++)
+	{
+		drawLib.GetTriangleBoundsText(label, properties, triangles);
+		benchSink = triangles.size();
+	}
+	state.Stop();
+	cairo_surface_destroy(surface);
+}
+
+// ************* Drawing commands *************
+
+///Time Draw of a store holding a single command
+static void BenchDraw(class BenchState &state, class LocalStore &store, cairo_surface_t *surface)
+{
+	state.Start();
+	for(size_t i = 0; i < state.iterations; i++)
+		store.Draw();
+	cairo_surface_flush(surface);
+	state.Stop();
+}
+
+static void AddBenchPolygons(class LocalStore &store)
+{
+	class BenchRandom rnd(7);
+	std::vector<Polygon> polygons;
+	for(int i = 0; i < 100; i++)
+		polygons.push_back(Polygon(RandomStar(rnd, rnd.Uniform(0.0, 640.0), rnd.Uniform(0.0, 480.0), 40.0, 24), Contours()));
+	store.AddDrawPolygonsCmd(polygons, ShapeProperties(0.8, 0.2, 0.2));
+}
+
+static void AddBenchPolygonsHoles(class LocalStore &store)
+{
+	class BenchRandom rnd(8);
+	std::vector<Polygon> polygons;
+	for(int i = 0; i < 20; i++)
+	{
+		double cx = rnd.Uniform(0.0, 640.0), cy = rnd.Uniform(0.0, 480.0);
+		Contour hole = RandomStar(rnd, cx, cy, 15.0, 12);
+		std::reverse(hole.begin(), hole.end());
+		polygons.push_back(Polygon(RandomStar(rnd, cx, cy, 60.0, 24), Contours(1, hole)));
+	}
+	store.AddDrawPolygonsCmd(polygons, ShapeProperties(0.2, 0.2, 0.8));
+}
+
+static void AddBenchLines(class LocalStore &store)
+{
+	Contours lines;
+	for(unsigned i = 0; i < 50; i++)
+		lines.push_back(RandomWalk(200, 100+i));
+	store.AddDrawLinesCmd(lines, LineProperties(0.0, 0.5, 0.0, 2.0));
+}
+
+///The same star at 5000 random positions, as a map of point symbols
+static void AddBenchInstances(class LocalStore &store)
+{
+	class BenchRandom rnd(9);
+	std::vector<Polygon> star(1, Polygon(RandomStar(rnd, 0.0, 0.0, 5.0, 10), Contours()));
+	std::vector<double> transforms;
+	std::vector<unsigned int> colours;
+	for(int i = 0; i < 5000; i++)
+	{
+		double ang = rnd.Uniform(0.0, 2.0 * M_PI);
+		double scale = rnd.Uniform(0.5, 1.5);
+		double t[6] = {scale * cos(ang), scale * sin(ang), -scale * sin(ang), scale * cos(ang),
+			rnd.Uniform(0.0, 640.0), rnd.Uniform(0.0, 480.0)};
+		transforms.insert(transforms.end(), t, t + 6);
+		colours.push_back(PackColour(rnd.Uniform(0.0, 1.0), 0.5, 0.2));
+	}
+	store.AddDrawPolygonInstancesCmd(star, ShapeProperties(0.8, 0.2, 0.2), transforms, colours);
+}
+
+template<class DrawLibType> static void BenchDrawStore(class BenchState &state, void (*addCmds)(class LocalStore &))
+{
+	cairo_surface_t *surface = CreateBenchSurface();
+	{
+		DrawLibType drawLib(surface);
+		addCmds(drawLib);
+		BenchDraw(state, drawLib, surface);
+	}
+	cairo_surface_destroy(surface);
+}
+
+static void BenchDrawCmdPolygons(class BenchState &state)
+{
+	BenchDrawStore<class DrawLibCairoPango>(state, AddBenchPolygons);
+}
+
+static void BenchDrawCmdPolygonsHoles(class BenchState &state)
+{
+	BenchDrawStore<class DrawLibCairoPango>(state, AddBenchPolygonsHoles);
+}
+
+static void BenchDrawCmdLines(class BenchState &state)
+{
+	BenchDrawStore<class DrawLibCairoPango>(state, AddBenchLines);
+}
+
+static void BenchRasterCmdPolygons(class BenchState &state)
+{
+	BenchDrawStore<class DrawLibRaster>(state, AddBenchPolygons);
+}
+
+static void BenchRasterCmdPolygonsHoles(class BenchState &state)
+{
+	BenchDrawStore<class DrawLibRaster>(state, AddBenchPolygonsHoles);
+}
+
+static void BenchRasterCmdLines(class BenchState &state)
+{
+	BenchDrawStore<class DrawLibRaster>(state, AddBenchLines);
+}
+
+static void BenchDrawCmdInstances(class BenchState &state)
+{
+	BenchDrawStore<class DrawLibCairoPango>(state, AddBenchInstances);
+}
+
+static void BenchTiledCmdPolygons(class BenchState &state)
+{
+	BenchDrawStore<class DrawLibTiled>(state, AddBenchPolygons);
+}
+
+static void BenchTiledCmdLines(class BenchState &state)
+{
+	BenchDrawStore<class DrawLibTiled>(state, AddBenchLines);
+}
+
+static void BenchDrawCmdText(class BenchState &state)
+{
+	cairo_surface_t *surface = CreateBenchSurface();
+	class DrawLibCairoPango drawLib(surface);
+	class BenchRandom rnd(9);
+	std::vector<class TextLabel> labels;
+	for(int i = 0; i < 20; i++)
+		labels.push_back(TextLabel("Benchmark label", rnd.Uniform(0.0, 600.0), rnd.Uniform(0.0, 460.0), rnd.Uniform(-0.5, 0.5)));
+	drawLib.AddDrawTextCmd(labels, TextProperties(0.0, 0.0, 0.0));
+	BenchDraw(state, drawLib, surface);
+	cairo_surface_destroy(surface);
+}
+
+static void BenchDrawCmdTwistedText(class BenchState &state)
+{
+	cairo_surface_t *surface = CreateBenchSurface();
+	class DrawLibCairoPango drawLib(surface);
+	std::vector<class TwistedTextLabel> labels;
+	for(unsigned i = 0; i < 5; i++)
+	{
+		class TwistedPath path;
+		FixBezierToPoints(RandomWalk(40, 200+i, 20.0, 80.0 * (i+1), 12.0), path);
+		labels.push_back(TwistedTextLabel("Benchmark twisted label text", path));
+	}
+	drawLib.AddDrawTwistedTextCmd(labels, TextProperties(0.0, 0.0, 0.0));
+	BenchDraw(state, drawLib, surface);
+	cairo_surface_destroy(surface);
+}
+
+// ************* Store encoding *************
+
+static void AddBenchEncodingCmds(class LocalStore &store)
+{
+	AddBenchPolygons(store);
+	AddBenchPolygonsHoles(store);
+	AddBenchLines(store);
+}
+
+static void BenchEncodeStore(class BenchState &state)
+{
+	class LocalStore store;
+	AddBenchEncodingCmds(store);
+	std::string encoded;
+	state.Start();
+	for(size_t i = 0; i < state.iterations; i++)
+	{
+		encoded.clear();
+		store.Encode(encoded);
+	}
+	state.Stop();
+	benchSink = encoded.size();
+}
+
+static void BenchDecodeStore(class BenchState &state)
+{
+	class LocalStore store;
+	AddBenchEncodingCmds(store);
+	std::string encoded;
+	store.Encode(encoded);
+	state.Start();
+	for(size_t i = 0; i < state.iterations; i++)
+	{
+		store.ClearDrawingCmds();
+		store.Decode(encoded.data(), encoded.size());
+	}
+	state.Stop();
+	benchSink = store.GetMemoryUsage().vertices;
+}
+
+// *************************************
+
+class BenchEntry
+{
+public:
+	const char *name;
+	BenchFunc func;
+};
+
+static const class BenchEntry benchmarks[] = {
+	{"rdp_random_walk_10k", BenchRamerDouglasPeucker},
+	{"line_line_intersect", BenchLineLineIntersect},
+	{"line_line_intersect_batch_1024", BenchLineLineIntersectBatch},
+	{"fix_bezier_to_points_200", BenchFixBezierToPoints},
+	{"tessellate_polygons_100x112", BenchTessellatePolygons},
+	{"tessellate_stroke_50x200", BenchTessellateStroke},
+	{"curve_length", BenchCurveLength},
+	{"parametrize_path", BenchParametrizePath},
+	{"calc_twisted_bbox", BenchCalcTwistedBbox},
+	{"get_triangle_bounds_text", BenchGetTriangleBoundsText},
+	{"draw_cmd_polygons", BenchDrawCmdPolygons},
+	{"draw_cmd_polygons_holes", BenchDrawCmdPolygonsHoles},
+	{"draw_cmd_lines", BenchDrawCmdLines},
+	{"draw_cmd_instances_5000", BenchDrawCmdInstances},
+	{"draw_cmd_text", BenchDrawCmdText},
+	{"draw_cmd_twisted_text", BenchDrawCmdTwistedText},
+	{"raster_cmd_polygons", BenchRasterCmdPolygons},
+	{"raster_cmd_polygons_holes", BenchRasterCmdPolygonsHoles},
+	{"raster_cmd_lines", BenchRasterCmdLines},
+	{"tiled_cmd_polygons", BenchTiledCmdPolygons},
+	{"tiled_cmd_lines", BenchTiledCmdLines},
+	{"encode_store", BenchEncodeStore},
+	{"decode_store", BenchDecodeStore},
+	{NULL, NULL}
+};
+
+///Run with more iterations until the timed part takes at least minSeconds
+static void RunBenchmark(const class BenchEntry &entry, double minSeconds)
+{
+	double minNs = minSeconds * 1e9;
+	size_t iterations = 1;
+	while(true)
+	{
+		class BenchState state(iterations);
+		entry.func(state);
+		if(state.elapsedNs >= minNs || iterations >= ((size_t)1 << 40))
+		{
+			double nsPerOp = state.elapsedNs / iterations;
+			printf("{\"name\": \"%s\", \"iterations\": %lu, \"ns_per_op\": %.2f, \"ops_per_s\": %.2f, \"allocs_per_op\": %.3f}\n",
+				entry.name, (unsigned long)iterations, nsPerOp,
+				nsPerOp > 0.0 ? 1e9 / nsPerOp : 0.0,
+				(double)state.allocs / iterations);
+			fflush(stdout);
+			return;
+		}
+
+		//Aim a little past the minimum time, growing at most 100 times per step
+		double estimate = state.elapsedNs > 0.0 ? 1.2 * iterations * minNs / state.elapsedNs : 100.0 * iterations;
+		size_t next = (size_t)min(estimate, 100.0 * iterations);
+		iterations = max(next, iterations + 1);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const char *filter = argc > 1 ? argv[1] : "";
+	double minSeconds = argc > 2 ? atof(argv[2]) : 0.5;
+
+	for(int i = 0; benchmarks[i].name != NULL; i++)
+	{
+		if(strstr(benchmarks[i].name, filter) == NULL)
+			continue;
+		RunBenchmark(benchmarks[i], minSeconds);
+	}
+	return 0;
+}
@@ -177,7 +177,7 @@ two_points_distance (cairo_path_data_t *a, cairo_path_data_t *b)
  * code just flattens the curve using cairo and adds the length
  * of segments.
  */
-static double
+double
 curve_length (double x0, double y0,
 				double x1, double y1,
 				double x2, double y2,
@@ -226,8 +226,6 @@ curve_length (double x0, double y0,
 }
 
 
-typedef double parametrization_t;
-
 /* Compute parametrization info.	That is, for each part of the 
  * cairo path, tags it with its length.
  */
@@ -303,12 +301,6 @@ transform_path (cairo_path_t *path, transform_point_func_t f, void *closure)
 	}
 }
 
-/* Simple struct to hold a path and its parametrization */
-typedef struct {
-	cairo_path_t *path;
-	std::vector<parametrization_t> parametrization;
-} parametrized_path_t;
-
 /* Project a point X,Y onto a parameterized path.	The final point is
  * where you get if you walk on the path forward from the beginning for X
  * units, then stop there and walk another Y units perpendicular to the
@@ -705,13 +697,13 @@ draw_twisted (cairo_t *cr,
 	cairo_restore (cr);
 }
 
-void RunTwistedCurveCmds(cairo_t *cr, const std::vector<TwistedCurveCmd> &cmds)
+void RunTwistedCurveCmds(cairo_t *cr, const class TwistedPath &path)
 {
-	for(size_t i = 0; i < cmds.size(); i++)
+	const double *vals = path.coords.size() > 0 ? &path.coords[0] : NULL;
+	for(size_t i = 0; i < path.verbs.size(); i++)
 	{
-		TwistedCurveCmd cmd = cmds[i];
-		const std::vector<double> &vals = cmd.second;
-		switch(cmd.first)
+		TwistedCurveCmdType cmdType = path.verbs[i];
+		switch(cmdType)
 		{
 		case MoveTo:
 			cairo_move_to (cr, vals[0], vals[1]);
@@ -729,13 +721,13 @@ void RunTwistedCurveCmds(cairo_t *cr, const std::vector<TwistedCurveCmd> &cmds)
 			cairo_rel_curve_to (cr, vals[0], vals[1], vals[2], vals[3], vals[4], vals[5]);
 			break;
 		}
-
+		vals += TwistedCurveCmdArity(cmdType);
 	}
 
 }
 
 void draw_formatted_twisted_text (cairo_t *cr, const std::string &text, 
-	const std::vector<TwistedCurveCmd> &cmds,
+	const class TwistedPath &cmds,
 	const class TextProperties &properties,
 	double &pathLenOut,
 	double &textLenOut)
@@ -766,7 +758,7 @@ void draw_formatted_twisted_text (cairo_t *cr, const std::string &text,
 	cairo_restore (cr);
 }
 
-void get_bounding_triangles_twisted_text (cairo_t *cr, const std::string &text, const std::vector<TwistedCurveCmd> &cmds,
+void get_bounding_triangles_twisted_text (cairo_t *cr, const std::string &text, const class TwistedPath &cmds,
 	const class TextProperties &properties, TwistedTriangles &trianglesOut,
 	double &pathLenOut,
 	double &textLenOut)
@@ -4,11 +4,33 @@
 #include <vector>
 #include <utility>
 #include <string>
+#include <pango/pangocairo.h>
+#include "drawlib.h"
 
-void draw_formatted_twisted_text (cairo_t *cr, const std::string &text, const std::vector<TwistedCurveCmd> &cmds,
+typedef double parametrization_t;
+
+/* Simple struct to hold a path and its parametrization */
+typedef struct {
+	cairo_path_t *path;
+	std::vector<parametrization_t> parametrization;
+} parametrized_path_t;
+
+double curve_length (double x0, double y0,
+	double x1, double y1,
+	double x2, double y2,
+	double x3, double y3);
+void parametrize_path (cairo_path_t *path, std::vector<parametrization_t> &parametrizationOut);
+void calc_twisted_bbox(PangoRectangle &rect,
+	parametrized_path_t &param,
+	double x,
+	double y,
+	TwistedTriangles &trianglesOut);
+
+void RunTwistedCurveCmds(cairo_t *cr, const class TwistedPath &path);
+void draw_formatted_twisted_text (cairo_t *cr, const std::string &text, const class TwistedPath &cmds,
 	const class TextProperties &properties, double &pathLenOut,
 	double &textLenOut);
-void get_bounding_triangles_twisted_text (cairo_t *cr, const std::string &text, const std::vector<TwistedCurveCmd> &cmds,
+void get_bounding_triangles_twisted_text (cairo_t *cr, const std::string &text, const class TwistedPath &cmds,
 	const class TextProperties &properties, TwistedTriangles &trianglesOut, double &pathLenOut,
 	double &textLenOut);
 void fancy_cairo_draw_triangles(cairo_t *cr, TwistedTriangles &triangles);
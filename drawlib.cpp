@@ -2,7 +2,13 @@
 #include <iostream>
 #include <stdexcept>
 #include <stdarg.h>
+#include <algorithm>
+#include <cmath>
+#include <assert.h>
 #include "drawlib.h"
+#include "RdpSimplify.h"
+#include "BezierFit.h"
+#include "Tessellate.h"
 using namespace std;
 
 ShapeProperties::ShapeProperties() 
@@ -139,6 +145,113 @@ bool TextProperties::operator <(const TextProperties& rhs) const
 
 // *************************************
 
+TriangleMesh::TriangleMesh() : built(false)
+{}
+
+TriangleMesh::TriangleMesh(const TriangleMesh &arg) : vertices(arg.vertices), indices(arg.indices),
+	built(arg.built)
+{}
+
+TriangleMesh::~TriangleMesh()
+{}
+
+void TriangleMesh::Clear()
+{
+	vertices.clear();
+	indices.clear();
+	built = false;
+}
+
+size_t TriangleMesh::NumVertices() const
+{
+	return vertices.size() / 2;
+}
+
+size_t TriangleMesh::NumTriangles() const
+{
+	if(indices.size() > 0)
+		return indices.size() / 3;
+	return vertices.size() / 6;
+}
+
+size_t TriangleMesh::MemoryBytes() const
+{
+	return vertices.capacity() * sizeof(float) + indices.capacity() * sizeof(unsigned int);
+}
+
+// *********************************************
+
+AffineTransform::AffineTransform() : xx(1.0), yx(0.0), xy(0.0), yy(1.0), x0(0.0), y0(0.0)
+{}
+
+AffineTransform::AffineTransform(double xx, double yx, double xy, double yy, double x0, double y0):
+	xx(xx), yx(yx), xy(xy), yy(yy), x0(x0), y0(y0)
+{}
+
+AffineTransform::AffineTransform(const AffineTransform &arg):
+	xx(arg.xx), yx(arg.yx), xy(arg.xy), yy(arg.yy), x0(arg.x0), y0(arg.y0)
+{}
+
+AffineTransform::~AffineTransform()
+{}
+
+AffineTransform &AffineTransform::operator =(const AffineTransform &arg)
+{
+	xx = arg.xx; yx = arg.yx;
+	xy = arg.xy; yy = arg.yy;
+	x0 = arg.x0; y0 = arg.y0;
+	return *this;
+}
+
+AffineTransform AffineTransform::Translation(double tx, double ty)
+{
+	return AffineTransform(1.0, 0.0, 0.0, 1.0, tx, ty);
+}
+
+AffineTransform AffineTransform::Scaling(double sx, double sy)
+{
+	return AffineTransform(sx, 0.0, 0.0, sy, 0.0, 0.0);
+}
+
+bool AffineTransform::IsIdentity() const
+{
+	return xx == 1.0 && yx == 0.0 && xy == 0.0 && yy == 1.0 && x0 == 0.0 && y0 == 0.0;
+}
+
+bool AffineTransform::IsInvertible() const
+{
+	double det = xx * yy - xy * yx;
+	return det != 0.0 && std::isfinite(det) && std::isfinite(x0) && std::isfinite(y0);
+}
+
+AffineTransform AffineTransform::operator *(const AffineTransform &rhs) const
+{
+	return AffineTransform(xx * rhs.xx + xy * rhs.yx,
+		yx * rhs.xx + yy * rhs.yx,
+		xx * rhs.xy + xy * rhs.yy,
+		yx * rhs.xy + yy * rhs.yy,
+		xx * rhs.x0 + xy * rhs.y0 + x0,
+		yx * rhs.x0 + yy * rhs.y0 + y0);
+}
+
+void AffineTransform::Apply(double &x, double &y) const
+{
+	double tx = xx * x + xy * y + x0;
+	double ty = yx * x + yy * y + y0;
+	x = tx;
+	y = ty;
+}
+
+void AffineTransform::ApplyDistance(double &dx, double &dy) const
+{
+	double tx = xx * dx + xy * dy;
+	double ty = yx * dx + yy * dy;
+	dx = tx;
+	dy = ty;
+}
+
+// *************************************
+
 TextLabel::TextLabel() : x(0.0), y(0.0), ang(0.0)
 {}
 
@@ -161,15 +274,109 @@ void TextLabel::Translate(double tx, double ty)
 	this->y += ty;
 }
 
+void TextLabel::Transform(const class AffineTransform &transform)
+{
+	double dx = cos(this->ang), dy = sin(this->ang);
+	transform.ApplyDistance(dx, dy);
+	transform.Apply(this->x, this->y);
+	if(dx != 0.0 || dy != 0.0)
+		this->ang = atan2(dy, dx);
+}
+
+// *************************************
+
+TwistedPath::TwistedPath()
+{}
+
+TwistedPath::TwistedPath(const std::vector<TwistedCurveCmd> &cmds)
+{
+	for(size_t i = 0;i < cmds.size(); i++)
+	{
+		const TwistedCurveCmd &cmd = cmds[i];
+		if(cmd.second.size() != (size_t)TwistedCurveCmdArity(cmd.first))
+			throw std::invalid_argument("Incorrect number of arguments");
+		this->Append(cmd.first, &cmd.second[0]);
+	}
+}
+
+TwistedPath::TwistedPath(const TwistedPath &arg) : verbs(arg.verbs), coords(arg.coords)
+{}
+
+TwistedPath::~TwistedPath()
+{}
+
+void TwistedPath::Append(TwistedCurveCmdType ty, const double *vals)
+{
+	verbs.push_back(ty);
+	coords.insert(coords.end(), vals, vals + TwistedCurveCmdArity(ty));
+}
+
+void TwistedPath::Clear()
+{
+	verbs.clear();
+	coords.clear();
+}
+
+void TwistedPath::Reserve(size_t numVerbs, size_t numCoords)
+{
+	verbs.reserve(numVerbs);
+	coords.reserve(numCoords);
+}
+
+size_t TwistedPath::Size() const
+{
+	return verbs.size();
+}
+
+//Relative commands are offsets from the previous point, so they
+//are unchanged by a translation.
+void TwistedPath::Translate(double tx, double ty)
+{
+	size_t c = 0;
+	for(size_t i = 0;i < verbs.size(); i++)
+	{
+		TwistedCurveCmdType cmdType = verbs[i];
+		int arity = TwistedCurveCmdArity(cmdType);
+		if(cmdType != ::RelLineTo && cmdType != ::RelCurveTo)
+		{
+			for(int j=0;j < arity;j+=2)
+			{
+				coords[c+j] += tx;
+				coords[c+j+1] += ty;
+			}
+		}
+		c += arity;
+	}
+}
+
+void TwistedPath::Transform(const class AffineTransform &transform)
+{
+	size_t c = 0;
+	for(size_t i = 0;i < verbs.size(); i++)
+	{
+		TwistedCurveCmdType cmdType = verbs[i];
+		int arity = TwistedCurveCmdArity(cmdType);
+		bool relative = cmdType == ::RelLineTo || cmdType == ::RelCurveTo;
+		for(int j=0;j < arity;j+=2)
+		{
+			if(relative)
+				transform.ApplyDistance(coords[c+j], coords[c+j+1]);
+			else
+				transform.Apply(coords[c+j], coords[c+j+1]);
+		}
+		c += arity;
+	}
+}
+
 // *************************************
 
 TwistedTextLabel::TwistedTextLabel()
 {}
 
-TwistedTextLabel::TwistedTextLabel(std::string &text, const std::vector<TwistedCurveCmd> &path): text(text), path(path)
+TwistedTextLabel::TwistedTextLabel(std::string &text, const class TwistedPath &path): text(text), path(path)
 {}
 
-TwistedTextLabel::TwistedTextLabel(const char *text, const std::vector<TwistedCurveCmd> &path): text(text), path(path)
+TwistedTextLabel::TwistedTextLabel(const char *text, const class TwistedPath &path): text(text), path(path)
 {}
 
 TwistedTextLabel::TwistedTextLabel(const TwistedTextLabel &arg):
@@ -181,49 +388,104 @@ TwistedTextLabel::~TwistedTextLabel()
 
 void TwistedTextLabel::Translate(double tx, double ty)
 {
-	for(size_t i = 0;i < path.size(); i++)
+	this->path.Translate(tx, ty);
+}
+
+void TwistedTextLabel::Transform(const class AffineTransform &transform)
+{
+	this->path.Transform(transform);
+}
+
+// *************************************
+
+CmdMemoryUsage::CmdMemoryUsage()
+{
+	this->Clear();
+}
+
+void CmdMemoryUsage::Clear()
+{
+	count = 0;
+	geometryBytes = 0;
+	propertiesBytes = 0;
+	vertices = 0;
+	labels = 0;
+}
+
+void CmdMemoryUsage::Add(const class CmdMemoryUsage &arg)
+{
+	count += arg.count;
+	geometryBytes += arg.geometryBytes;
+	propertiesBytes += arg.propertiesBytes;
+	vertices += arg.vertices;
+	labels += arg.labels;
+}
+
+size_t CmdMemoryUsage::TotalBytes() const
+{
+	return geometryBytes + propertiesBytes;
+}
+
+StoreMemoryUsage::StoreMemoryUsage()
+{
+	this->Clear();
+}
+
+void StoreMemoryUsage::Clear()
+{
+	cmdTypes.clear();
+	overheadBytes = 0;
+	totalBytes = 0;
+	peakBytes = 0;
+	vertices = 0;
+	labels = 0;
+}
+
+class CmdMemoryUsage &StoreMemoryUsage::ForType(CmdTypes type)
+{
+	if((size_t)type >= cmdTypes.size())
+		cmdTypes.resize(type+1);
+	return cmdTypes[type];
+}
+
+///Heap memory of a string, which is none if it fits in the string object itself
+static size_t StringBytes(const std::string &str)
+{
+	const char *data = str.data();
+	if(data >= (const char *)&str && data < (const char *)(&str + 1))
+		return 0;
+	return str.capacity() + 1;
+}
+
+static size_t ContoursBytes(const Contours &contours, size_t &verticesOut)
+{
+	size_t bytes = contours.capacity() * sizeof(Contour);
+	for(size_t i=0;i < contours.size(); i++)
 	{
-		TwistedCurveCmd &cmd = path[i];
-		TwistedCurveCmdType cmdType = cmd.first;	
-		std::vector<double> &params = cmd.second;
+		bytes += contours[i].capacity() * sizeof(Point);
+		verticesOut += contours[i].size();
+	}
+	return bytes;
+}
 
-		switch(cmdType)
-		{
-		case MoveTo:
-			for(size_t j=0;j+1 < params.size();j+=2)
-			{
-				params[j] += tx;
-				params[j+1] += ty;
-			}	
-			break;
-		case LineTo:
-			for(size_t j=0;j+1 < params.size();j+=2)
-			{
-				params[j] += tx;
-				params[j+1] += ty;
-			}	
-			break;
-		case RelLineTo:
-			break;
-		case CurveTo:
-			for(size_t j=0;j+1 < params.size();j+=2)
-			{
-				params[j] += tx;
-				params[j+1] += ty;
-			}	
-			break;
-		case RelCurveTo:
-			break;
-		}
+static size_t PolygonsBytes(const std::vector<Polygon> &polygons, size_t &verticesOut)
+{
+	size_t bytes = polygons.capacity() * sizeof(Polygon);
+	for(size_t i=0;i < polygons.size(); i++)
+	{
+		bytes += polygons[i].first.capacity() * sizeof(Point);
+		verticesOut += polygons[i].first.size();
+		bytes += ContoursBytes(polygons[i].second, verticesOut);
 	}
+	return bytes;
 }
 
 // *************************************
 
-BaseCmd::BaseCmd(CmdTypes type): type(type)
+BaseCmd::BaseCmd(CmdTypes type): refCount(1), type(type)
 {}
 
-BaseCmd::BaseCmd(const BaseCmd &arg): type(arg.type)
+BaseCmd::BaseCmd(const BaseCmd &arg): refCount(1), type(arg.type)
 {}
 
 BaseCmd::~BaseCmd()
@@ -232,11 +494,34 @@ BaseCmd::~BaseCmd()
 BaseCmd *BaseCmd::Clone()
 {return new class BaseCmd(*this);}
 
+void BaseCmd::GetMemoryUsage(class CmdMemoryUsage &usage) const
+{
+	usage.count ++;
+	usage.propertiesBytes += sizeof(*this);
+}
+
+void BaseCmd::AddRef() const
+{
+	this->refCount++;
+}
+
+void BaseCmd::Release() const
+{
+	if(--this->refCount == 0)
+		delete this;
+}
+
+bool BaseCmd::IsShared() const
+{
+	return this->refCount.load() > 1;
+}
+
 DrawPolygonsCmd::DrawPolygonsCmd(const std::vector<Polygon> &polygons, const class ShapeProperties &properties) : 
 	BaseCmd(CMD_POLYGONS), polygons(polygons), properties(properties)
 {}
 
-DrawPolygonsCmd::DrawPolygonsCmd(const DrawPolygonsCmd &arg) : BaseCmd(CMD_POLYGONS), polygons(arg.polygons), properties(arg.properties) 
+DrawPolygonsCmd::DrawPolygonsCmd(const DrawPolygonsCmd &arg) : BaseCmd(CMD_POLYGONS), polygons(arg.polygons), properties(arg.properties),
+	detailLevels(arg.detailLevels), meshes(arg.meshes), quantized(arg.quantized)
 {}
 
 DrawPolygonsCmd::~DrawPolygonsCmd() 
@@ -245,11 +530,82 @@ DrawPolygonsCmd::~DrawPolygonsCmd()
 BaseCmd *DrawPolygonsCmd::Clone()
 {return new class DrawPolygonsCmd(*this);}
 
+void DrawPolygonsCmd::GetMemoryUsage(class CmdMemoryUsage &usage) const
+{
+	usage.count ++;
+	usage.propertiesBytes += sizeof(*this) + StringBytes(properties.imageId);
+	usage.geometryBytes += PolygonsBytes(polygons, usage.vertices);
+	usage.geometryBytes += quantized.MemoryBytes();
+	usage.vertices += quantized.NumPoints();
+	size_t levelVertices = 0;
+	usage.geometryBytes += detailLevels.capacity() * sizeof(std::vector<Polygon>);
+	for(size_t i=0;i < detailLevels.size(); i++)
+		usage.geometryBytes += PolygonsBytes(detailLevels[i], levelVertices);
+	usage.geometryBytes += meshes.capacity() * sizeof(class TriangleMesh);
+	for(size_t i=0;i < meshes.size(); i++)
+		usage.geometryBytes += meshes[i].MemoryBytes();
+}
+
+const std::vector<Polygon> &DrawPolygonsCmd::GetPolygons(int level) const
+{
+	if(level < 0 || (size_t)level >= detailLevels.size())
+		return polygons;
+	return detailLevels[level];
+}
+
+const class TriangleMesh &DrawPolygonsCmd::GetMesh(int level)
+{
+	if(level < 0 || (size_t)level >= detailLevels.size())
+		level = -1;
+	if(meshes.size() < detailLevels.size() + 1)
+		meshes.resize(detailLevels.size() + 1);
+	class TriangleMesh &mesh = meshes[level + 1];
+	if(!mesh.built && this->IsQuantized())
+	{
+		std::vector<Polygon> expanded;
+		quantized.Dequantize(expanded);
+		TessellatePolygons(expanded, mesh);
+	}
+	else if(!mesh.built)
+		TessellatePolygons(this->GetPolygons(level), mesh);
+	return mesh;
+}
+
+bool DrawPolygonsCmd::Quantize(double step)
+{
+	if(this->IsQuantized())
+		this->Dequantize();
+	if(polygons.size() == 0)
+		return true;
+	if(!quantized.Quantize(polygons, step))
+		return false;
+	std::vector<Polygon>().swap(polygons);
+	detailLevels.clear();
+	meshes.clear();
+	return true;
+}
+
+void DrawPolygonsCmd::Dequantize()
+{
+	if(!this->IsQuantized())
+		return;
+	quantized.Dequantize(polygons);
+	quantized.Clear();
+	meshes.clear();
+}
+
+bool DrawPolygonsCmd::IsQuantized() const
+{
+	return !quantized.Empty();
+}
+
 DrawLinesCmd::DrawLinesCmd(const Contours &lines, const class LineProperties &properties) : BaseCmd(CMD_LINES), 
 	lines(lines), properties(properties) 
 {}
 
-DrawLinesCmd::DrawLinesCmd(const DrawLinesCmd &arg) : BaseCmd(CMD_LINES), lines(arg.lines), properties(arg.properties)
+DrawLinesCmd::DrawLinesCmd(const DrawLinesCmd &arg) : BaseCmd(CMD_LINES), lines(arg.lines), properties(arg.properties),
+	detailLevels(arg.detailLevels), strokeMeshes(arg.strokeMeshes), strokeTolerances(arg.strokeTolerances),
+	quantized(arg.quantized)
 {}
 
 DrawLinesCmd::~DrawLinesCmd()
@@ -258,6 +614,85 @@ DrawLinesCmd::~DrawLinesCmd()
 BaseCmd *DrawLinesCmd::Clone()
 {return new class DrawLinesCmd(*this);}
 
+void DrawLinesCmd::GetMemoryUsage(class CmdMemoryUsage &usage) const
+{
+	usage.count ++;
+	usage.propertiesBytes += sizeof(*this) + StringBytes(properties.lineJoin) + StringBytes(properties.lineCap);
+	usage.geometryBytes += ContoursBytes(lines, usage.vertices);
+	usage.geometryBytes += quantized.MemoryBytes();
+	usage.vertices += quantized.NumPoints();
+	size_t levelVertices = 0;
+	usage.geometryBytes += detailLevels.capacity() * sizeof(Contours);
+	for(size_t i=0;i < detailLevels.size(); i++)
+		usage.geometryBytes += ContoursBytes(detailLevels[i], levelVertices);
+	usage.geometryBytes += strokeMeshes.capacity() * sizeof(class TriangleMesh)
+		+ strokeTolerances.capacity() * sizeof(double);
+	for(size_t i=0;i < strokeMeshes.size(); i++)
+		usage.geometryBytes += strokeMeshes[i].MemoryBytes();
+}
+
+const Contours &DrawLinesCmd::GetLines(int level) const
+{
+	if(level < 0 || (size_t)level >= detailLevels.size())
+		return lines;
+	return detailLevels[level];
+}
+
+const class TriangleMesh &DrawLinesCmd::GetStrokeMesh(int level, double tolerance)
+{
+	if(level < 0 || (size_t)level >= detailLevels.size())
+		level = -1;
+	if(strokeMeshes.size() < detailLevels.size() + 1)
+	{
+		strokeMeshes.resize(detailLevels.size() + 1);
+		strokeTolerances.resize(detailLevels.size() + 1, 0.0);
+	}
+	class TriangleMesh &mesh = strokeMeshes[level + 1];
+	if(!mesh.built || strokeTolerances[level + 1] > tolerance)
+	{
+		if(this->IsQuantized())
+		{
+			Contours expanded;
+			quantized.Dequantize(expanded);
+			TessellateStroke(expanded, properties, tolerance, mesh);
+		}
+		else
+			TessellateStroke(this->GetLines(level), properties, tolerance, mesh);
+		strokeTolerances[level + 1] = tolerance;
+	}
+	return mesh;
+}
+
+bool DrawLinesCmd::Quantize(double step)
+{
+	if(this->IsQuantized())
+		this->Dequantize();
+	if(lines.size() == 0)
+		return true;
+	if(!quantized.Quantize(lines, step))
+		return false;
+	Contours().swap(lines);
+	detailLevels.clear();
+	strokeMeshes.clear();
+	strokeTolerances.clear();
+	return true;
+}
+
+void DrawLinesCmd::Dequantize()
+{
+	if(!this->IsQuantized())
+		return;
+	quantized.Dequantize(lines);
+	quantized.Clear();
+	strokeMeshes.clear();
+	strokeTolerances.clear();
+}
+
+bool DrawLinesCmd::IsQuantized() const
+{
+	return !quantized.Empty();
+}
+
 DrawTextCmd::DrawTextCmd(const std::vector<class TextLabel> &textStrs, const class TextProperties &properties) : BaseCmd(CMD_TEXT), 
 	textStrs(textStrs), properties(properties) 
 {}
@@ -271,6 +706,16 @@ DrawTextCmd::~DrawTextCmd()
 BaseCmd *DrawTextCmd::Clone()
 {return new class DrawTextCmd(*this);}
 
+void DrawTextCmd::GetMemoryUsage(class CmdMemoryUsage &usage) const
+{
+	usage.count ++;
+	usage.propertiesBytes += sizeof(*this) + StringBytes(properties.font);
+	usage.geometryBytes += textStrs.capacity() * sizeof(class TextLabel);
+	for(size_t i=0;i < textStrs.size(); i++)
+		usage.geometryBytes += StringBytes(textStrs[i].text);
+	usage.labels += textStrs.size();
+}
+
 DrawTwistedTextCmd::DrawTwistedTextCmd(const std::vector<class TwistedTextLabel> &textStrs, const class TextProperties &properties) : 
 	BaseCmd(CMD_TWISTED_TEXT), textStrs(textStrs), properties(properties) 
 {}
@@ -285,6 +730,22 @@ DrawTwistedTextCmd::~DrawTwistedTextCmd()
 BaseCmd *DrawTwistedTextCmd::Clone()
 {return new class DrawTwistedTextCmd(*this);}
 
+void DrawTwistedTextCmd::GetMemoryUsage(class CmdMemoryUsage &usage) const
+{
+	usage.count ++;
+	usage.propertiesBytes += sizeof(*this) + StringBytes(properties.font);
+	usage.geometryBytes += textStrs.capacity() * sizeof(class TwistedTextLabel);
+	for(size_t i=0;i < textStrs.size(); i++)
+	{
+		const class TwistedTextLabel &label = textStrs[i];
+		usage.geometryBytes += StringBytes(label.text);
+		usage.geometryBytes += label.path.verbs.capacity() * sizeof(TwistedCurveCmdType);
+		usage.geometryBytes += label.path.coords.capacity() * sizeof(double);
+		usage.vertices += label.path.coords.size() / 2;
+	}
+	usage.labels += textStrs.size();
+}
+
 LoadImageResourcesCmd::LoadImageResourcesCmd(const std::map<std::string, std::string> &loadIdToFilenameMapping):
 	BaseCmd(CMD_LOAD_RESOURCES), loadIdToFilenameMapping(loadIdToFilenameMapping)
 {}
@@ -299,6 +760,19 @@ LoadImageResourcesCmd::~LoadImageResourcesCmd()
 BaseCmd *LoadImageResourcesCmd::Clone()
 {return new class LoadImageResourcesCmd(*this);}
 
+void LoadImageResourcesCmd::GetMemoryUsage(class CmdMemoryUsage &usage) const
+{
+	usage.count ++;
+	usage.propertiesBytes += sizeof(*this);
+	for(std::map<std::string, std::string>::const_iterator it = loadIdToFilenameMapping.begin();
+		it != loadIdToFilenameMapping.end(); it++)
+	{
+		//Map nodes hold the pair plus links to parent, children and colour
+		usage.propertiesBytes += sizeof(*it) + 4 * sizeof(void *);
+		usage.propertiesBytes += StringBytes(it->first) + StringBytes(it->second);
+	}
+}
+
 UnloadImageResourcesCmd::UnloadImageResourcesCmd(const std::vector<std::string> &unloadIds):
 	BaseCmd(CMD_UNLOAD_RESOURCES), unloadIds(unloadIds)
 {}
@@ -313,11 +787,147 @@ UnloadImageResourcesCmd::~UnloadImageResourcesCmd()
 BaseCmd *UnloadImageResourcesCmd::Clone()
 {return new class UnloadImageResourcesCmd(*this);}
 
+void UnloadImageResourcesCmd::GetMemoryUsage(class CmdMemoryUsage &usage) const
+{
+	usage.count ++;
+	usage.propertiesBytes += sizeof(*this) + unloadIds.capacity() * sizeof(std::string);
+	for(size_t i=0;i < unloadIds.size(); i++)
+		usage.propertiesBytes += StringBytes(unloadIds[i]);
+}
+
+DrawInstancesCmd::DrawInstancesCmd(const std::vector<Polygon> &polygons, const class ShapeProperties &properties,
+	const std::vector<double> &transforms, const std::vector<unsigned int> &colours):
+	BaseCmd(CMD_INSTANCES), polygons(polygons), shapeProperties(properties), transforms(transforms), colours(colours)
+{
+	if(transforms.size() % 6 != 0)
+		throw std::invalid_argument("Transforms must have six values per instance");
+	if(colours.size() > 0 && colours.size() != transforms.size() / 6)
+		throw std::invalid_argument("Colours must have one value per instance");
+}
+
+DrawInstancesCmd::DrawInstancesCmd(const Contours &lines, const class LineProperties &properties,
+	const std::vector<double> &transforms, const std::vector<unsigned int> &colours):
+	BaseCmd(CMD_INSTANCES), lines(lines), lineProperties(properties), transforms(transforms), colours(colours)
+{
+	if(transforms.size() % 6 != 0)
+		throw std::invalid_argument("Transforms must have six values per instance");
+	if(colours.size() > 0 && colours.size() != transforms.size() / 6)
+		throw std::invalid_argument("Colours must have one value per instance");
+}
+
+DrawInstancesCmd::DrawInstancesCmd(const DrawInstancesCmd &arg): BaseCmd(CMD_INSTANCES), 
+	polygons(arg.polygons), lines(arg.lines), shapeProperties(arg.shapeProperties), lineProperties(arg.lineProperties),
+	transforms(arg.transforms), colours(arg.colours)
+{}
+
+DrawInstancesCmd::~DrawInstancesCmd()
+{}
+
+BaseCmd *DrawInstancesCmd::Clone()
+{return new class DrawInstancesCmd(*this);}
+
+void DrawInstancesCmd::GetMemoryUsage(class CmdMemoryUsage &usage) const
+{
+	usage.count ++;
+	usage.propertiesBytes += sizeof(*this) + StringBytes(shapeProperties.imageId) 
+		+ StringBytes(lineProperties.lineJoin) + StringBytes(lineProperties.lineCap);
+	usage.geometryBytes += PolygonsBytes(polygons, usage.vertices);
+	usage.geometryBytes += ContoursBytes(lines, usage.vertices);
+	usage.geometryBytes += transforms.capacity() * sizeof(double) + colours.capacity() * sizeof(unsigned int);
+}
+
+size_t DrawInstancesCmd::NumInstances() const
+{
+	return transforms.size() / 6;
+}
+
+class AffineTransform DrawInstancesCmd::GetTransform(size_t instance) const
+{
+	const double *t = &transforms[instance * 6];
+	return AffineTransform(t[0], t[1], t[2], t[3], t[4], t[5]);
+}
+
+void DrawInstancesCmd::SetTransform(size_t instance, const class AffineTransform &transform)
+{
+	double *t = &transforms[instance * 6];
+	t[0] = transform.xx; t[1] = transform.yx;
+	t[2] = transform.xy; t[3] = transform.yy;
+	t[4] = transform.x0; t[5] = transform.y0;
+}
+
+void DrawInstancesCmd::GetColour(size_t instance, double &r, double &g, double &b, double &a) const
+{
+	if(colours.size() == 0)
+	{
+		const bool filled = polygons.size() > 0;
+		r = filled ? shapeProperties.r : lineProperties.r;
+		g = filled ? shapeProperties.g : lineProperties.g;
+		b = filled ? shapeProperties.b : lineProperties.b;
+		a = filled ? shapeProperties.a : lineProperties.a;
+		return;
+	}
+	unsigned int c = colours[instance];
+	r = ((c >> 24) & 0xff) / 255.0;
+	g = ((c >> 16) & 0xff) / 255.0;
+	b = ((c >> 8) & 0xff) / 255.0;
+	a = (c & 0xff) / 255.0;
+}
+
+static unsigned int ColourByte(double v)
+{
+	if(v <= 0.0) return 0;
+	if(v >= 1.0) return 255;
+	return (unsigned int)(v * 255.0 + 0.5);
+}
+
+unsigned int PackColour(double r, double g, double b, double a)
+{
+	return (ColourByte(r) << 24) | (ColourByte(g) << 16) | (ColourByte(b) << 8) | ColourByte(a);
+}
+
 // *************************************
 
-LocalStore::LocalStore() : IDrawLib()
+///Quantize a polygon or line command, leaving it in floating point if the step is too fine.
+///\return true if the command is now quantized
+static bool QuantizeCmd(class BaseCmd *baseCmd, double step)
 {
+	if(baseCmd->type == CMD_POLYGONS)
+	{
+		class DrawPolygonsCmd *polygonsCmd = (class DrawPolygonsCmd *)baseCmd;
+		return polygonsCmd->Quantize(step) && polygonsCmd->IsQuantized();
+	}
+	if(baseCmd->type == CMD_LINES)
+	{
+		class DrawLinesCmd *linesCmd = (class DrawLinesCmd *)baseCmd;
+		return linesCmd->Quantize(step) && linesCmd->IsQuantized();
+	}
+	return false;
+}
 
+///Move a command back to floating point.
+///\return the step it was quantized with, or zero if it was not
+static double DequantizeCmd(class BaseCmd *baseCmd)
+{
+	class QuantizedContours *quantized = NULL;
+	if(baseCmd->type == CMD_POLYGONS)
+		quantized = &((class DrawPolygonsCmd *)baseCmd)->quantized;
+	else if(baseCmd->type == CMD_LINES)
+		quantized = &((class DrawLinesCmd *)baseCmd)->quantized;
+	if(quantized == NULL || quantized->Empty())
+		return 0.0;
+	double step = quantized->step;
+	if(baseCmd->type == CMD_POLYGONS)
+		((class DrawPolygonsCmd *)baseCmd)->Dequantize();
+	else
+		((class DrawLinesCmd *)baseCmd)->Dequantize();
+	return step;
+}
+
+// *************************************
+
+LocalStore::LocalStore() : IDrawLib(), detailPixelError(0.5), quantizeStep(0.0)
+{
+	this->UpdateMemoryUsage();
 }
 
 LocalStore::~LocalStore()
@@ -328,14 +938,78 @@ LocalStore::~LocalStore()
 void LocalStore::ClearDrawingCmds()
 {
 	for(size_t i=0;i < cmds.size(); i++)
-		delete cmds[i];
+		cmds[i]->Release();
 	cmds.clear();
+	this->UpdateMemoryUsage();
 }
 
 
 void LocalStore::AddCmd(class BaseCmd *cmd)
 {
-	cmds.push_back(cmd->Clone());
+	this->AdoptCmd(cmd->Clone());
+}
+
+///Drop the detail levels of a polygon or line command, and the meshes built from them
+static void ClearDetailLevels(class BaseCmd *baseCmd)
+{
+	if(baseCmd->type == CMD_POLYGONS)
+	{
+		((class DrawPolygonsCmd *)baseCmd)->detailLevels.clear();
+		((class DrawPolygonsCmd *)baseCmd)->meshes.clear();
+	}
+	else if(baseCmd->type == CMD_LINES)
+	{
+		((class DrawLinesCmd *)baseCmd)->detailLevels.clear();
+		((class DrawLinesCmd *)baseCmd)->strokeMeshes.clear();
+		((class DrawLinesCmd *)baseCmd)->strokeTolerances.clear();
+	}
+}
+
+void LocalStore::AppendCmds(const class LocalStore &other)
+{
+	bool share = this->detailTolerances == other.detailTolerances
+		&& this->quantizeStep == other.quantizeStep;
+	size_t numCmds = other.cmds.size(); //Other may be this store
+	for(size_t i=0;i < numCmds; i++)
+	{
+		class BaseCmd *cmd = other.cmds[i];
+		if(!share)
+		{
+			//Stored as if added to this store, with its levels and quantization
+			class BaseCmd *copy = cmd->Clone();
+			if(quantizeStep == 0.0)
+				DequantizeCmd(copy);
+			if(detailTolerances.size() == 0)
+				ClearDetailLevels(copy);
+			this->AdoptCmd(copy);
+			continue;
+		}
+		cmd->AddRef();
+		cmds.push_back(cmd);
+		this->AddMemoryUsage(cmd);
+	}
+}
+
+///Get a command to change, first replacing it with a copy if it is shared
+class BaseCmd *LocalStore::MutableCmd(size_t index)
+{
+	class BaseCmd *cmd = cmds[index];
+	if(cmd->IsShared())
+	{
+		cmds[index] = cmd->Clone();
+		cmd->Release();
+	}
+	return cmds[index];
+}
+
+void LocalStore::AdoptCmd(class BaseCmd *cmd)
+{
+	cmds.push_back(cmd);
+	if(quantizeStep > 0.0)
+		QuantizeCmd(cmds.back(), quantizeStep);
+	if(detailTolerances.size() > 0)
+		this->BuildDetailLevels(cmds.size()-1, false, NULL);
+	this->AddMemoryUsage(cmds.back());
 }
 
 void LocalStore::AddDrawPolygonsCmd(const std::vector<Polygon> &polygons, const class ShapeProperties &properties)
@@ -374,6 +1048,20 @@ void LocalStore::AddUnloadImageResourcesCmd(const std::vector<std::string> &unlo
 	this->AddCmd(&cmd);
 }
 
+void LocalStore::AddDrawPolygonInstancesCmd(const std::vector<Polygon> &polygons, const class ShapeProperties &properties,
+	const std::vector<double> &transforms, const std::vector<unsigned int> &colours)
+{
+	class DrawInstancesCmd cmd(polygons, properties, transforms, colours);
+	this->AddCmd(&cmd);
+}
+
+void LocalStore::AddDrawLineInstancesCmd(const Contours &lines, const class LineProperties &properties,
+	const std::vector<double> &transforms, const std::vector<unsigned int> &colours)
+{
+	class DrawInstancesCmd cmd(lines, properties, transforms, colours);
+	this->AddCmd(&cmd);
+}
+
 int LocalStore::GetTriangleBoundsText(const TextLabel &label, const class TextProperties &properties, 
 		TwistedTriangles &trianglesOut)
 {
@@ -398,6 +1086,392 @@ int LocalStore::GetResourceDimensionsFromFilename(const std::string &filename, u
 	return -1;
 }
 
+///Points of quantized commands expanded at once by LocalStore::Simplify
+static const size_t SIMPLIFY_BATCH_POINTS = 1 << 20;
+
+///Add the rings of a polygon or line command to be simplified, dropping meshes built from them.
+///\return number of points added
+static size_t SimplifyContours(class BaseCmd *baseCmd, std::vector<Contour *> &contours)
+{
+	size_t numPoints = 0;
+	if(baseCmd->type == CMD_POLYGONS)
+	{
+		std::vector<Polygon> &polygons = ((class DrawPolygonsCmd *)baseCmd)->polygons;
+		((class DrawPolygonsCmd *)baseCmd)->meshes.clear();
+		for(size_t j=0;j < polygons.size(); j++)
+		{
+			contours.push_back(&polygons[j].first);
+			numPoints += polygons[j].first.size();
+			for(size_t k=0;k < polygons[j].second.size(); k++)
+			{
+				contours.push_back(&polygons[j].second[k]);
+				numPoints += polygons[j].second[k].size();
+			}
+		}
+	}
+	else if(baseCmd->type == CMD_LINES)
+	{
+		Contours &lines = ((class DrawLinesCmd *)baseCmd)->lines;
+		((class DrawLinesCmd *)baseCmd)->strokeMeshes.clear();
+		for(size_t j=0;j < lines.size(); j++)
+		{
+			contours.push_back(&lines[j]);
+			numPoints += lines[j].size();
+		}
+	}
+	return numPoints;
+}
+
+///Simplify a batch of rings, then store the quantized commands they came from again
+static void SimplifyBatch(std::vector<Contour *> &contours,
+	std::vector<std::pair<class BaseCmd *, double> > &quantizedCmds,
+	double epsilon, class WorkStealingPool *pool)
+{
+	RamerDouglasPeuckerBatch(contours, epsilon, pool);
+	for(size_t i=0;i < quantizedCmds.size(); i++)
+		QuantizeCmd(quantizedCmds[i].first, quantizedCmds[i].second);
+	contours.clear();
+	quantizedCmds.clear();
+}
+
+void LocalStore::Simplify(double epsilon, class WorkStealingPool *pool)
+{
+	//Quantized commands are simplified in floating point, then stored again.
+	//They are expanded a batch at a time, so they are not all in floating
+	//point at once.
+	std::vector<Contour *> contours;
+	std::vector<std::pair<class BaseCmd *, double> > quantizedCmds;
+	size_t expandedPoints = 0;
+	for(size_t i=0;i < cmds.size(); i++)
+	{
+		if(cmds[i]->type != CMD_POLYGONS && cmds[i]->type != CMD_LINES)
+			continue;
+		class BaseCmd *baseCmd = this->MutableCmd(i);
+		double quantizedStep = DequantizeCmd(baseCmd);
+		size_t numPoints = SimplifyContours(baseCmd, contours);
+		if(quantizedStep == 0.0)
+			continue;
+		quantizedCmds.push_back(std::pair<class BaseCmd *, double>(baseCmd, quantizedStep));
+		expandedPoints += numPoints;
+		if(expandedPoints >= SIMPLIFY_BATCH_POINTS)
+		{
+			SimplifyBatch(contours, quantizedCmds, epsilon, pool);
+			expandedPoints = 0;
+		}
+	}
+	SimplifyBatch(contours, quantizedCmds, epsilon, pool);
+
+	//Detail levels were built from the geometry before simplifying
+	if(detailTolerances.size() > 0)
+		this->BuildDetailLevels(0, true, pool);
+	this->UpdateMemoryUsage();
+}
+
+void LocalStore::SetDetailLevels(const std::vector<double> &tolerances, double pixelError,
+	class WorkStealingPool *pool)
+{
+	this->detailTolerances = tolerances;
+	std::sort(this->detailTolerances.begin(), this->detailTolerances.end());
+	this->detailPixelError = pixelError;
+	this->BuildDetailLevels(0, true, pool);
+	this->UpdateMemoryUsage();
+}
+
+int LocalStore::SelectDetailLevel(double pixelSize) const
+{
+	double maxTolerance = pixelSize * this->detailPixelError;
+	int level = -1;
+	for(size_t i=0;i < detailTolerances.size(); i++)
+	{
+		if(detailTolerances[i] > maxTolerance)
+			break;
+		level = i;
+	}
+	return level;
+}
+
+void LocalStore::SetQuantization(double step)
+{
+	if(step < 0.0)
+		throw invalid_argument("Quantization step must not be negative");
+	this->quantizeStep = step;
+	for(size_t i=0;i < cmds.size(); i++)
+	{
+		if(cmds[i]->type == CMD_POLYGONS || cmds[i]->type == CMD_LINES)
+			this->MutableCmd(i);
+		if(step > 0.0)
+			QuantizeCmd(cmds[i], step);
+		else
+			DequantizeCmd(cmds[i]);
+	}
+	//Commands moved back to floating point get their detail levels again
+	if(step == 0.0 && detailTolerances.size() > 0)
+		this->BuildDetailLevels(0, true, NULL);
+	this->UpdateMemoryUsage();
+}
+
+double LocalStore::GetQuantization() const
+{
+	return this->quantizeStep;
+}
+
+///Remove rings that simplification has reduced to less than a triangle
+static void PruneCollapsedRings(std::vector<Polygon> &polygons)
+{
+	size_t keptPolys = 0;
+	for(size_t i=0;i < polygons.size(); i++)
+	{
+		Polygon &polygon = polygons[i];
+		if(polygon.first.size() < 3)
+			continue;
+
+		Contours &inners = polygon.second;
+		size_t keptInners = 0;
+		for(size_t j=0;j < inners.size(); j++)
+			if(inners[j].size() >= 3)
+				inners[keptInners++].swap(inners[j]);
+		inners.resize(keptInners);
+
+		if(keptPolys != i)
+			polygons[keptPolys].swap(polygon);
+		keptPolys++;
+	}
+	polygons.resize(keptPolys);
+}
+
+void LocalStore::BuildDetailLevels(size_t firstCmd, bool useThreads, class WorkStealingPool *pool)
+{
+	size_t numLevels = detailTolerances.size();
+	for(size_t i=firstCmd;i < cmds.size(); i++)
+	{
+		class BaseCmd *baseCmd = cmds[i];
+		if(baseCmd->type == CMD_POLYGONS)
+		{
+			if(((class DrawPolygonsCmd *)baseCmd)->IsQuantized())
+				continue;
+			class DrawPolygonsCmd *polygonsCmd = (class DrawPolygonsCmd *)this->MutableCmd(i);
+			polygonsCmd->detailLevels.assign(numLevels, polygonsCmd->polygons);
+			polygonsCmd->meshes.clear();
+		}
+		else if(baseCmd->type == CMD_LINES)
+		{
+			if(((class DrawLinesCmd *)baseCmd)->IsQuantized())
+				continue;
+			class DrawLinesCmd *linesCmd = (class DrawLinesCmd *)this->MutableCmd(i);
+			linesCmd->detailLevels.assign(numLevels, linesCmd->lines);
+			linesCmd->strokeMeshes.clear();
+		}
+	}
+
+	for(size_t level=0;level < numLevels; level++)
+	{
+		std::vector<Contour *> contours;
+		for(size_t i=firstCmd;i < cmds.size(); i++)
+		{
+			class BaseCmd *baseCmd = cmds[i];
+			if(baseCmd->type == CMD_POLYGONS && !((class DrawPolygonsCmd *)baseCmd)->IsQuantized())
+			{
+				std::vector<Polygon> &polygons = ((class DrawPolygonsCmd *)baseCmd)->detailLevels[level];
+				for(size_t j=0;j < polygons.size(); j++)
+				{
+					contours.push_back(&polygons[j].first);
+					for(size_t k=0;k < polygons[j].second.size(); k++)
+						contours.push_back(&polygons[j].second[k]);
+				}
+			}
+			else if(baseCmd->type == CMD_LINES && !((class DrawLinesCmd *)baseCmd)->IsQuantized())
+			{
+				Contours &lines = ((class DrawLinesCmd *)baseCmd)->detailLevels[level];
+				for(size_t j=0;j < lines.size(); j++)
+					contours.push_back(&lines[j]);
+			}
+		}
+
+		if(useThreads)
+			RamerDouglasPeuckerBatch(contours, detailTolerances[level], pool);
+		else
+		{
+			for(size_t j=0;j < contours.size(); j++)
+				if(contours[j]->size() > 2)
+					RamerDouglasPeucker(*contours[j], detailTolerances[level], *contours[j]);
+		}
+	}
+
+	for(size_t i=firstCmd;i < cmds.size(); i++)
+	{
+		if(cmds[i]->type != CMD_POLYGONS)
+			continue;
+		class DrawPolygonsCmd *polygonsCmd = (class DrawPolygonsCmd *)cmds[i];
+		for(size_t level=0;level < polygonsCmd->detailLevels.size(); level++)
+			PruneCollapsedRings(polygonsCmd->detailLevels[level]);
+	}
+}
+
+const class StoreMemoryUsage &LocalStore::GetMemoryUsage() const
+{
+	return this->memoryUsage;
+}
+
+void LocalStore::ResetPeakMemoryUsage()
+{
+	this->memoryUsage.peakBytes = this->memoryUsage.totalBytes;
+}
+
+///Add a command to the memory usage and refresh the store overhead. cmd may be NULL.
+void LocalStore::AddMemoryUsage(const class BaseCmd *cmd)
+{
+	class StoreMemoryUsage &usage = this->memoryUsage;
+	size_t overhead = sizeof(LocalStore) + cmds.capacity() * sizeof(class BaseCmd *)
+		+ detailTolerances.capacity() * sizeof(double);
+	usage.totalBytes = usage.totalBytes - usage.overheadBytes + overhead;
+	usage.overheadBytes = overhead;
+
+	if(cmd != NULL)
+	{
+		class CmdMemoryUsage cmdUsage;
+		cmd->GetMemoryUsage(cmdUsage);
+		usage.ForType(cmd->type).Add(cmdUsage);
+		usage.totalBytes += cmdUsage.TotalBytes();
+		usage.vertices += cmdUsage.vertices;
+		usage.labels += cmdUsage.labels;
+	}
+	usage.peakBytes = max(usage.peakBytes, usage.totalBytes);
+}
+
+///Recount memory usage of all commands, keeping the peak
+void LocalStore::UpdateMemoryUsage()
+{
+	size_t peak = this->memoryUsage.peakBytes;
+	this->memoryUsage.Clear();
+	this->memoryUsage.peakBytes = peak;
+	this->AddMemoryUsage(NULL);
+	for(size_t i=0;i < cmds.size(); i++)
+		this->AddMemoryUsage(cmds[i]);
+}
+
+void LocalStore::SetViewTransform(const class AffineTransform &transform)
+{
+	this->viewTransform = transform;
+}
+
+const class AffineTransform &LocalStore::GetViewTransform() const
+{
+	return this->viewTransform;
+}
+
+void LocalStore::SwapCmds(class LocalStore &other)
+{
+	this->cmds.swap(other.cmds);
+	this->detailTolerances.swap(other.detailTolerances);
+	std::swap(this->detailPixelError, other.detailPixelError);
+	std::swap(this->quantizeStep, other.quantizeStep);
+	std::swap(this->viewTransform, other.viewTransform);
+	this->UpdateMemoryUsage();
+	other.UpdateMemoryUsage();
+}
+
+static void TransformContours(const class AffineTransform &transform, Contours &contours)
+{
+	for(size_t i=0;i < contours.size(); i++)
+		if(contours[i].size() > 0)
+			TransformPoints(transform, &contours[i][0], contours[i].size());
+}
+
+static void TransformPolygons(const class AffineTransform &transform, std::vector<Polygon> &polygons)
+{
+	for(size_t i=0;i < polygons.size(); i++)
+	{
+		Contour &outer = polygons[i].first;
+		if(outer.size() > 0)
+			TransformPoints(transform, &outer[0], outer.size());
+		TransformContours(transform, polygons[i].second);
+	}
+}
+
+void LocalStore::TransformCoordinates(const class AffineTransform &transform)
+{
+	double scale = sqrt(fabs(transform.xx * transform.yy - transform.xy * transform.yx));
+	for(size_t i=0;i < cmds.size(); i++)
+	{
+		class BaseCmd *baseCmd = this->MutableCmd(i);
+		//Quantized commands are transformed in floating point, then stored
+		//again with the step scaled to the new units
+		double quantizedStep = DequantizeCmd(baseCmd);
+		if(quantizedStep > 0.0 && scale > 0.0)
+			quantizedStep *= scale;
+		switch(baseCmd->type)
+		{
+		case CMD_POLYGONS:
+			{
+				class DrawPolygonsCmd *polygonsCmd = (class DrawPolygonsCmd *)baseCmd;
+				TransformPolygons(transform, polygonsCmd->polygons);
+				polygonsCmd->meshes.clear();
+				for(size_t j=0;j < polygonsCmd->detailLevels.size(); j++)
+					TransformPolygons(transform, polygonsCmd->detailLevels[j]);
+				break;
+			}
+		case CMD_LINES:
+			{
+				class DrawLinesCmd *linesCmd = (class DrawLinesCmd *)baseCmd;
+				TransformContours(transform, linesCmd->lines);
+				linesCmd->strokeMeshes.clear();
+				for(size_t j=0;j < linesCmd->detailLevels.size(); j++)
+					TransformContours(transform, linesCmd->detailLevels[j]);
+				break;
+			}
+		case CMD_TEXT:
+			{
+				std::vector<class TextLabel> &textStrs = ((class DrawTextCmd *)baseCmd)->textStrs;
+				for(size_t j=0;j < textStrs.size(); j++)
+					textStrs[j].Transform(transform);
+				break;
+			}
+		case CMD_TWISTED_TEXT:
+			{
+				std::vector<class TwistedTextLabel> &textStrs = ((class DrawTwistedTextCmd *)baseCmd)->textStrs;
+				for(size_t j=0;j < textStrs.size(); j++)
+					textStrs[j].Transform(transform);
+				break;
+			}
+		case CMD_INSTANCES:
+			{
+				//Prototypes stay in their own units, only the placement changes
+				class DrawInstancesCmd *instancesCmd = (class DrawInstancesCmd *)baseCmd;
+				for(size_t j=0;j < instancesCmd->NumInstances(); j++)
+					instancesCmd->SetTransform(j, transform * instancesCmd->GetTransform(j));
+				break;
+			}
+		default:
+			break;
+		}
+		if(quantizedStep > 0.0)
+			QuantizeCmd(baseCmd, quantizedStep);
+	}
+
+	//Keep detail tolerances and the quantization step in step with the new units
+	for(size_t i=0;i < detailTolerances.size(); i++)
+		detailTolerances[i] *= scale;
+	if(scale > 0.0)
+		this->quantizeStep *= scale;
+	this->UpdateMemoryUsage();
+}
+
+void LocalStore::BuildPolygonMeshes(int level)
+{
+	for(size_t i=0;i < cmds.size(); i++)
+		if(cmds[i]->type == CMD_POLYGONS)
+			((class DrawPolygonsCmd *)this->MutableCmd(i))->GetMesh(level);
+	this->UpdateMemoryUsage();
+}
+
+void LocalStore::BuildStrokeMeshes(int level, double tolerance)
+{
+	for(size_t i=0;i < cmds.size(); i++)
+		if(cmds[i]->type == CMD_LINES)
+			((class DrawLinesCmd *)this->MutableCmd(i))->GetStrokeMesh(level, tolerance);
+	this->UpdateMemoryUsage();
+}
+
 // ****************************************
 
 ///Convenience factory to create a curve command
@@ -424,61 +1498,92 @@ TwistedCurveCmd NewTwistedCurveCmd(TwistedCurveCmdType ty, int n_args, ...)
 	return TwistedCurveCmd(ty, vals);
 }
 
-void FixBezierToPoints(const Contour &line, std::vector<TwistedCurveCmd> &bezierOut)
+void FixBezierToPoints(const Contour &line, class TwistedPath &bezierOut, double maxError)
 {
-	bezierOut.clear();
-	double cx = 0.0, cy = 0.0;
-	double px = 0.0, py = 0.0; //Control point from previous curve sections
+	FitBezierToPoints(line, maxError, M_PI, bezierOut);
+}
 
-	//Control parameters
-	double a = 0.2;
-	double a2 = 1.0 - a;
-	double b = 0.05;
+// ****************************************
 
-	if(line.size() >= 1)
-	{
-		cx = line[0].first;
-		cy = line[0].second;
-		bezierOut.push_back(NewTwistedCurveCmd(MoveTo, 2, cx, line[0].second));
-		px = cx; py = cy;
-	}
-	for(size_t i=1; i < line.size(); i++)
-	{
-		const Point &pt = line[i];
-		double dx = pt.first - cx;
-		double dy = pt.second - cy;
-		
-		//Control point at begining of straight
-		double c1x = cx+dx*a;
-		double c1y = cy+dy*a;
-		double p1x = cx+dx*(a-b);
-		double p1y = cy+dy*(a-b);
-		double p2x = cx+dx*(a+b);
-		double p2y = cy+dy*(a+b);
-
-		//Control point at end of straight (and beginning of curve)
-		double c2x = cx+dx*a2;
-		double c2y = cy+dy*a2;
-		double p3x = cx+dx*(a2-b);
-		double p3y = cy+dy*(a2-b);
-
-		bezierOut.push_back(NewTwistedCurveCmd(CurveTo, 6, px, py, p1x, p1y, c1x, c1y));
-		bezierOut.push_back(NewTwistedCurveCmd(CurveTo, 6, p2x, p2y, p3x, p3y, c2x, c2y));
-
-		px = cx+dx*(a2+b);
-		py = cy+dy*(a2+b);
-		cx = pt.first;
-		cy = pt.second;
-	}
+static void LocalStoreTestCmds(class LocalStore &store)
+{
+	std::vector<Polygon> polygons;
+	Contour outer;
+	for(int i = 0; i < 40; i++)
+		outer.push_back(Point(100.0 * cos(i * 0.157), 100.0 * sin(i * 0.157)));
+	polygons.push_back(Polygon(outer, Contours()));
+	store.AddDrawPolygonsCmd(polygons, ShapeProperties(0.0, 1.0, 0.0));
+	Contours lines;
+	lines.push_back(outer);
+	store.AddDrawLinesCmd(lines, LineProperties(1.0, 0.0, 0.0, 2.0));
+	std::vector<class TextLabel> labels;
+	labels.push_back(TextLabel("label", 5.0, 5.0));
+	store.AddDrawTextCmd(labels, TextProperties());
+}
 
-	if(line.size() > 1)
+///Store giving the tests access to its commands
+class LocalStoreTestAccess : public LocalStore
+{
+public:
+	const class BaseCmd *GetCmd(size_t index) const
 	{
-		const Point &penultimate = line[line.size()-2];
-		const Point &end = line[line.size()-1];
-		double dx = end.first - penultimate.first;
-		double dy = end.second - penultimate.second;
-		//End the path
-		bezierOut.push_back(NewTwistedCurveCmd(CurveTo, 6, px, py, end.first - dx * a, end.second - dy * a, end.first, end.second));
+		return cmds[index];
 	}
-}
+};
 
+void LocalStoreTests()
+{
+	// ** Building meshes copies shared commands **
+	class LocalStoreTestAccess source;
+	LocalStoreTestCmds(source);
+	std::string before, after;
+	source.Encode(before);
+	size_t sourceBytes = source.GetMemoryUsage().cmdTypes[CMD_POLYGONS].geometryBytes
+		+ source.GetMemoryUsage().cmdTypes[CMD_LINES].geometryBytes;
+
+	class LocalStoreTestAccess shared;
+	shared.AppendCmds(source);
+	assert(shared.GetCmd(0) == source.GetCmd(0) && shared.GetCmd(1) == source.GetCmd(1));
+	assert(source.GetCmd(0)->IsShared() && source.GetCmd(1)->IsShared());
+	shared.BuildPolygonMeshes();
+	shared.BuildStrokeMeshes(-1, 0.1);
+	assert(shared.GetCmd(0) != source.GetCmd(0) && shared.GetCmd(1) != source.GetCmd(1));
+	assert(!source.GetCmd(0)->IsShared() && !source.GetCmd(1)->IsShared());
+	assert(shared.GetCmd(2) == source.GetCmd(2));
+	assert(((const class DrawPolygonsCmd *)source.GetCmd(0))->meshes.size() == 0);
+	assert(((const class DrawLinesCmd *)source.GetCmd(1))->strokeMeshes.size() == 0);
+	assert(((const class DrawPolygonsCmd *)shared.GetCmd(0))->meshes[0].built);
+	assert(((const class DrawLinesCmd *)shared.GetCmd(1))->strokeMeshes[0].built);
+	assert(source.GetMemoryUsage().cmdTypes[CMD_POLYGONS].geometryBytes
+		+ source.GetMemoryUsage().cmdTypes[CMD_LINES].geometryBytes == sourceBytes);
+
+	// ** Changing shared commands leaves the other store as it was **
+	shared.TransformCoordinates(AffineTransform::Scaling(2.0, 2.0));
+	shared.Simplify(10.0);
+	source.Encode(after);
+	assert(after == before);
+	assert(source.GetMemoryUsage().vertices == 80);
+	assert(shared.GetMemoryUsage().vertices < 80);
+
+	class LocalStore simplified;
+	simplified.AppendCmds(source);
+	simplified.Simplify(10.0);
+	after.clear();
+	source.Encode(after);
+	assert(after == before);
+
+	// ** Appending follows the quantization of the store appended to **
+	class LocalStore quantized;
+	quantized.SetQuantization(1.0 / 16.0);
+	quantized.AppendCmds(source);
+	const class CmdMemoryUsage &sourceLines = source.GetMemoryUsage().cmdTypes[CMD_LINES];
+	const class CmdMemoryUsage &quantizedLines = quantized.GetMemoryUsage().cmdTypes[CMD_LINES];
+	assert(quantizedLines.vertices == sourceLines.vertices);
+	assert(quantizedLines.geometryBytes * 2 < sourceLines.geometryBytes);
+
+	class LocalStore unquantized;
+	unquantized.AppendCmds(quantized);
+	const class CmdMemoryUsage &unquantizedLines = unquantized.GetMemoryUsage().cmdTypes[CMD_LINES];
+	assert(unquantizedLines.geometryBytes == sourceLines.geometryBytes);
+	cout << "line bytes " << sourceLines.geometryBytes << " quantized " << quantizedLines.geometryBytes << endl;
+}
@@ -5,6 +5,9 @@
 #include <utility>
 #include <string>
 #include <map>
+#include <atomic>
+#include <iosfwd>
+#include <stdint.h>
 
 typedef std::pair<double, double> Point;
 typedef std::vector<Point> Contour;
@@ -21,7 +24,8 @@ enum CmdTypes
 	CMD_TEXT,
 	CMD_TWISTED_TEXT,
 	CMD_LOAD_RESOURCES,
-	CMD_UNLOAD_RESOURCES
+	CMD_UNLOAD_RESOURCES,
+	CMD_INSTANCES
 };
 
 enum TwistedCurveCmdType
@@ -33,9 +37,167 @@ enum TwistedCurveCmdType
 	RelCurveTo
 };
 
+///Number of coordinates taken by each type of curve command
+inline int TwistedCurveCmdArity(TwistedCurveCmdType ty)
+{
+	return (ty == CurveTo || ty == RelCurveTo) ? 6 : 2;
+}
+
 typedef std::pair<TwistedCurveCmdType, std::vector<double> > TwistedCurveCmd;
 TwistedCurveCmd NewTwistedCurveCmd(TwistedCurveCmdType ty, int n_args, ...);
-void FixBezierToPoints(const Contour &line, std::vector<TwistedCurveCmd> &bezierOut);
+
+///Path made of curve commands, stored compactly as one array of command
+///types and one array of all their coordinates
+class TwistedPath
+{
+public:
+	std::vector<TwistedCurveCmdType> verbs;
+	std::vector<double> coords;
+
+	TwistedPath();
+	TwistedPath(const std::vector<TwistedCurveCmd> &cmds);
+	TwistedPath(const TwistedPath &arg);
+	virtual ~TwistedPath();
+
+	void MoveTo(double x, double y);
+	void LineTo(double x, double y);
+	void RelLineTo(double dx, double dy);
+	void CurveTo(double x1, double y1, double x2, double y2, double x3, double y3);
+	void RelCurveTo(double dx1, double dy1, double dx2, double dy2, double dx3, double dy3);
+	///Add a command with TwistedCurveCmdArity(ty) coordinates from vals
+	void Append(TwistedCurveCmdType ty, const double *vals);
+
+	void Clear();
+	void Reserve(size_t numVerbs, size_t numCoords);
+	size_t Size() const;
+
+	void Translate(double tx, double ty);
+	void Transform(const class AffineTransform &transform);
+};
+
+//Builders are called per point when paths are generated, so they are inline
+
+inline void TwistedPath::MoveTo(double x, double y)
+{
+	verbs.push_back(::MoveTo);
+	coords.push_back(x); coords.push_back(y);
+}
+
+inline void TwistedPath::LineTo(double x, double y)
+{
+	verbs.push_back(::LineTo);
+	coords.push_back(x); coords.push_back(y);
+}
+
+inline void TwistedPath::RelLineTo(double dx, double dy)
+{
+	verbs.push_back(::RelLineTo);
+	coords.push_back(dx); coords.push_back(dy);
+}
+
+inline void TwistedPath::CurveTo(double x1, double y1, double x2, double y2, double x3, double y3)
+{
+	verbs.push_back(::CurveTo);
+	coords.push_back(x1); coords.push_back(y1);
+	coords.push_back(x2); coords.push_back(y2);
+	coords.push_back(x3); coords.push_back(y3);
+}
+
+inline void TwistedPath::RelCurveTo(double dx1, double dy1, double dx2, double dy2, double dx3, double dy3)
+{
+	verbs.push_back(::RelCurveTo);
+	coords.push_back(dx1); coords.push_back(dy1);
+	coords.push_back(dx2); coords.push_back(dy2);
+	coords.push_back(dx3); coords.push_back(dy3);
+}
+
+///Fit a smooth curve through a line that stays within maxError of its points.
+///See FitBezierToPoints for control over sharp corners.
+void FixBezierToPoints(const Contour &line, class TwistedPath &bezierOut, double maxError = 1.0);
+
+///2D affine transform with the same layout and meaning as cairo_matrix_t:
+///x' = xx * x + xy * y + x0, y' = yx * x + yy * y + y0
+class AffineTransform
+{
+public:
+	double xx, yx;
+	double xy, yy;
+	double x0, y0;
+
+	AffineTransform();
+	AffineTransform(double xx, double yx, double xy, double yy, double x0, double y0);
+	AffineTransform(const AffineTransform &arg);
+	virtual ~AffineTransform();
+	AffineTransform &operator =(const AffineTransform &arg);
+
+	static AffineTransform Translation(double tx, double ty);
+	static AffineTransform Scaling(double sx, double sy);
+
+	bool IsIdentity() const;
+	///False if the transform collapses the plane, or has values that are not finite
+	bool IsInvertible() const;
+	///Transform that applies rhs first, then this one
+	AffineTransform operator *(const AffineTransform &rhs) const;
+	void Apply(double &x, double &y) const;
+	///Transform a displacement, which ignores translation
+	void ApplyDistance(double &dx, double &dy) const;
+};
+
+///Transform an array of points in place, using vector instructions where available
+void TransformPoints(const class AffineTransform &transform, Point *pts, size_t count);
+
+///Triangles in vertex and index arrays, laid out for upload to vertex buffers.
+///If there are no indices, each three vertices in order are a triangle.
+class TriangleMesh
+{
+public:
+	std::vector<float> vertices; //x, y pairs
+	std::vector<unsigned int> indices; //Three vertex numbers per triangle
+	bool built; //Set once the mesh is filled in, even if it has no triangles
+
+	TriangleMesh();
+	TriangleMesh(const TriangleMesh &arg);
+	virtual ~TriangleMesh();
+
+	void Clear();
+	size_t NumVertices() const;
+	size_t NumTriangles() const;
+	///Heap memory held by the vertex and index arrays
+	size_t MemoryBytes() const;
+};
+
+///Polygon rings or lines stored compactly in fixed point. Points are whole
+///multiples of step from an origin at the corner of their bounds, and each is
+///stored as the difference from the point before it, continuing across rings.
+///Differences are kept in 16 bits if they all fit, otherwise in 32 bits.
+class QuantizedContours
+{
+public:
+	double originX, originY;
+	double step; //Size of one stored unit in drawing coordinates
+	double x1, y1, x2, y2; //Bounds of the original points
+	std::vector<unsigned int> ringSizes; //Number of points in each ring
+	std::vector<unsigned int> polygonRings; //Number of rings in each polygon, empty for lines
+	std::vector<int16_t> deltas16; //x, y pairs
+	std::vector<int32_t> deltas32; //x, y pairs, used instead of deltas16 for larger steps
+
+	QuantizedContours();
+	virtual ~QuantizedContours();
+
+	///Store polygons, with each point moved by at most half a step.
+	///\return false, leaving this empty, if the points are too far apart for the step
+	bool Quantize(const std::vector<Polygon> &polygons, double step);
+	bool Quantize(const Contours &lines, double step);
+	///Expand the stored polygons, reusing the memory already held by polygonsOut
+	void Dequantize(std::vector<Polygon> &polygonsOut) const;
+	void Dequantize(Contours &linesOut) const;
+
+	void Clear();
+	bool Empty() const;
+	size_t NumPoints() const;
+	///Heap memory held by the arrays
+	size_t MemoryBytes() const;
+};
 
 ///Drawing properties of shapes that are filled
 class ShapeProperties
@@ -107,6 +269,8 @@ public:
 	virtual ~TextLabel();
 
 	void Translate(double tx, double ty);
+	///Move the label position and rotate its angle to follow the transform
+	void Transform(const class AffineTransform &transform);
 };
 
 ///Defines a single twisted label that follows a Bezier path
@@ -114,78 +278,160 @@ class TwistedTextLabel
 {
 public:
 	std::string text;
-	std::vector<TwistedCurveCmd> path; //Path of bottom edge
+	class TwistedPath path; //Path of bottom edge
 
 	TwistedTextLabel();
-	TwistedTextLabel(std::string &text, const std::vector<TwistedCurveCmd> &path);
-	TwistedTextLabel(const char *text, const std::vector<TwistedCurveCmd> &path);
+	TwistedTextLabel(std::string &text, const class TwistedPath &path);
+	TwistedTextLabel(const char *text, const class TwistedPath &path);
 	TwistedTextLabel(const TwistedTextLabel &arg);
 	virtual ~TwistedTextLabel();
 
 	void Translate(double tx, double ty);
+	void Transform(const class AffineTransform &transform);
 };
 
-///Base class of all command classes
+///Estimated memory used by commands, including their nested vectors and strings
+class CmdMemoryUsage
+{
+public:
+	size_t count; //Number of commands
+	size_t geometryBytes; //Points, detail levels, label text and paths
+	size_t propertiesBytes; //Command objects, properties and resource names
+	size_t vertices; //Points of the original geometry
+	size_t labels; //Text labels
+
+	CmdMemoryUsage();
+	void Clear();
+	void Add(const class CmdMemoryUsage &arg);
+	size_t TotalBytes() const;
+};
+
+///Memory used by a store, by command type
+class StoreMemoryUsage
+{
+public:
+	std::vector<class CmdMemoryUsage> cmdTypes; //Indexed by CmdTypes
+	size_t overheadBytes; //Store object and command list
+	size_t totalBytes;
+	size_t peakBytes; //Highest totalBytes since the peak was last reset
+	size_t vertices;
+	size_t labels;
+
+	StoreMemoryUsage();
+	void Clear();
+	class CmdMemoryUsage &ForType(CmdTypes type);
+};
+
+///Base class of all command classes. Commands in a store are reference
+///counted so other stores can share them. A shared command must not be
+///changed, only copied with Clone.
 class BaseCmd
 {
+protected:
+	mutable std::atomic<int> refCount;
 public:
 	const CmdTypes type;
 	BaseCmd(CmdTypes type = CMD_BASE);
 	BaseCmd(const BaseCmd &arg);
 	virtual ~BaseCmd();
 	virtual BaseCmd *Clone();
+	///Add the memory used by this command to usage
+	virtual void GetMemoryUsage(class CmdMemoryUsage &usage) const;
+
+	void AddRef() const;
+	///Drop a reference, deleting the command after the last one
+	void Release() const;
+	bool IsShared() const;
 };
 
 ///Draw polygons command
 class DrawPolygonsCmd : public BaseCmd
 {
 public:
-	const std::vector<Polygon> polygons;
+	std::vector<Polygon> polygons;
 	const class ShapeProperties properties;
+	std::vector<std::vector<Polygon> > detailLevels; //Simplified copies, finest first
+	std::vector<class TriangleMesh> meshes; //Tessellation cache, indexed by detail level + 1
+	class QuantizedContours quantized; //Holds the polygons instead while quantized
 
 	DrawPolygonsCmd(const std::vector<Polygon> &polygons, const class ShapeProperties &properties);
 	DrawPolygonsCmd(const DrawPolygonsCmd &arg);
 	virtual ~DrawPolygonsCmd();
 	virtual BaseCmd *Clone();
+	virtual void GetMemoryUsage(class CmdMemoryUsage &usage) const;
+
+	///Get polygons at a level of detail, or the original polygons if level is -1 or not built
+	const std::vector<Polygon> &GetPolygons(int level) const;
+	///Get the triangles of the polygons at a level of detail, tessellating them
+	///on first use. Clear meshes after changing the polygons directly.
+	const class TriangleMesh &GetMesh(int level);
+
+	///Move the polygons to fixed point storage, dropping detail levels and meshes.
+	///While quantized, polygons is empty and drawing expands them again.
+	///\return false, leaving the polygons as they were, if step is too fine
+	bool Quantize(double step);
+	///Move the polygons back to floating point
+	void Dequantize();
+	bool IsQuantized() const;
 };
 
 ///Draw lines command
 class DrawLinesCmd : public BaseCmd
 {
 public:
-	const Contours lines;
+	Contours lines;
 	const class LineProperties properties;
+	std::vector<Contours> detailLevels; //Simplified copies, finest first
+	std::vector<class TriangleMesh> strokeMeshes; //Stroke triangle cache, indexed by detail level + 1
+	std::vector<double> strokeTolerances; //Curve tolerance each cached stroke was built with
+	class QuantizedContours quantized; //Holds the lines instead while quantized
 
 	DrawLinesCmd(const Contours &lines, const class LineProperties &properties);
 	DrawLinesCmd(const DrawLinesCmd &arg);
 	virtual ~DrawLinesCmd();
 	virtual BaseCmd *Clone();
+	virtual void GetMemoryUsage(class CmdMemoryUsage &usage) const;
+
+	///Get lines at a level of detail, or the original lines if level is -1 or not built
+	const Contours &GetLines(int level) const;
+	///Get the triangles covering the stroked lines at a level of detail, with
+	///round joins and caps within tolerance. Strokes are built on first use and
+	///rebuilt only if a finer tolerance is asked for. Clear strokeMeshes after
+	///changing the lines directly.
+	const class TriangleMesh &GetStrokeMesh(int level, double tolerance);
+
+	///Move the lines to fixed point storage, see DrawPolygonsCmd::Quantize
+	bool Quantize(double step);
+	void Dequantize();
+	bool IsQuantized() const;
 };
 
 ///Draw text command
 class DrawTextCmd : public BaseCmd
 {
 public:
-	const std::vector<class TextLabel> textStrs;
+	std::vector<class TextLabel> textStrs;
 	const class TextProperties properties;
 
 	DrawTextCmd(const std::vector<class TextLabel> &textStrs, const class TextProperties &properties);
 	DrawTextCmd(const DrawTextCmd &arg);
 	virtual ~DrawTextCmd();
 	virtual BaseCmd *Clone();
+	virtual void GetMemoryUsage(class CmdMemoryUsage &usage) const;
 };
 
 ///Draw twisted text command
 class DrawTwistedTextCmd : public BaseCmd
 {
 public:
-	const std::vector<class TwistedTextLabel> textStrs;
+	std::vector<class TwistedTextLabel> textStrs;
 	const class TextProperties properties;
 
 	DrawTwistedTextCmd(const std::vector<class TwistedTextLabel> &textStrs, const class TextProperties &properties);
 	DrawTwistedTextCmd(const DrawTwistedTextCmd &arg);
 	virtual ~DrawTwistedTextCmd();
 	virtual BaseCmd *Clone();
+	virtual void GetMemoryUsage(class CmdMemoryUsage &usage) const;
 };
 
 ///Load image resources
@@ -198,6 +444,7 @@ public:
 	LoadImageResourcesCmd(const LoadImageResourcesCmd &arg);
 	virtual ~LoadImageResourcesCmd();
 	virtual BaseCmd *Clone();
+	virtual void GetMemoryUsage(class CmdMemoryUsage &usage) const;
 };
 
 ///Unload image resources
@@ -210,8 +457,40 @@ public:
 	UnloadImageResourcesCmd(const UnloadImageResourcesCmd &arg);
 	virtual ~UnloadImageResourcesCmd();
 	virtual BaseCmd *Clone();
+	virtual void GetMemoryUsage(class CmdMemoryUsage &usage) const;
+};
+
+///Draw one prototype shape many times, each copy with its own transform and
+///optionally its own colour. The prototype is either polygons or lines.
+class DrawInstancesCmd : public BaseCmd
+{
+public:
+	std::vector<Polygon> polygons; //Prototype to fill, if any
+	Contours lines; //Prototype to stroke, if there are no polygons
+	const class ShapeProperties shapeProperties;
+	const class LineProperties lineProperties;
+	std::vector<double> transforms; //xx, yx, xy, yy, x0, y0 of each instance, as in AffineTransform
+	std::vector<unsigned int> colours; //0xRRGGBBAA of each instance, or empty to use the properties
+
+	DrawInstancesCmd(const std::vector<Polygon> &polygons, const class ShapeProperties &properties,
+		const std::vector<double> &transforms, const std::vector<unsigned int> &colours);
+	DrawInstancesCmd(const Contours &lines, const class LineProperties &properties,
+		const std::vector<double> &transforms, const std::vector<unsigned int> &colours);
+	DrawInstancesCmd(const DrawInstancesCmd &arg);
+	virtual ~DrawInstancesCmd();
+	virtual BaseCmd *Clone();
+	virtual void GetMemoryUsage(class CmdMemoryUsage &usage) const;
+
+	size_t NumInstances() const;
+	class AffineTransform GetTransform(size_t instance) const;
+	void SetTransform(size_t instance, const class AffineTransform &transform);
+	///Get the colour of an instance, which is the prototype colour if there are no per instance colours
+	void GetColour(size_t instance, double &r, double &g, double &b, double &a) const;
 };
 
+///Pack a colour with components from 0 to 1 as 0xRRGGBBAA
+unsigned int PackColour(double r, double g, double b, double a = 1.0);
+
 ///Abstract base class of drawing library
 class IDrawLib
 {
@@ -227,6 +506,12 @@ public:
 	virtual void AddDrawTwistedTextCmd(const std::vector<class TwistedTextLabel> &textStrs, const class TextProperties &properties) = 0;
 	virtual void AddLoadImageResourcesCmd(const std::map<std::string, std::string> &loadIdToFilenameMapping) = 0;
 	virtual void AddUnloadImageResourcesCmd(const std::vector<std::string> &unloadIds) = 0;
+	///Fill the polygons once for every six values in transforms, see DrawInstancesCmd
+	virtual void AddDrawPolygonInstancesCmd(const std::vector<Polygon> &polygons, const class ShapeProperties &properties,
+		const std::vector<double> &transforms, const std::vector<unsigned int> &colours) = 0;
+	///Stroke the lines once for every six values in transforms, see DrawInstancesCmd
+	virtual void AddDrawLineInstancesCmd(const Contours &lines, const class LineProperties &properties,
+		const std::vector<double> &transforms, const std::vector<unsigned int> &colours) = 0;
 	virtual int GetTriangleBoundsText(const TextLabel &label, const class TextProperties &properties, 
 		TwistedTriangles &trianglesOut) = 0;
 	virtual int GetTriangleBoundsTwistedText(const TwistedTextLabel &label, 
@@ -247,18 +532,42 @@ class LocalStore : public IDrawLib
 {
 protected:
 	std::vector<class BaseCmd *> cmds;
+	std::vector<double> detailTolerances;
+	double detailPixelError;
+	double quantizeStep;
+	class AffineTransform viewTransform;
+	class StoreMemoryUsage memoryUsage;
+
+	void DecodeCmds(class StoreDecoder &decoder);
+	class BaseCmd *MutableCmd(size_t index);
+	void AddMemoryUsage(const class BaseCmd *cmd);
+	void UpdateMemoryUsage();
+	void BuildDetailLevels(size_t firstCmd, bool useThreads, class WorkStealingPool *pool);
 public:
 	LocalStore();
 	virtual ~LocalStore();
 
 	void ClearDrawingCmds();
 	void AddCmd(class BaseCmd *cmd);
+	///Add a new command without copying it, such as one built by a decoder.
+	///The store takes ownership and deletes it.
+	void AdoptCmd(class BaseCmd *cmd);
+	///Append the commands of another store by reference, without copying them.
+	///A shared command is copied only when a store changes it, such as by
+	///Simplify or TransformCoordinates. Commands are copied straight away if
+	///the stores have different detail levels or quantization, so they get
+	///those of this store.
+	void AppendCmds(const class LocalStore &other);
 	void AddDrawPolygonsCmd(const std::vector<Polygon> &polygons, const class ShapeProperties &properties);
 	void AddDrawLinesCmd(const Contours &lines, const class LineProperties &properties);
 	void AddDrawTextCmd(const std::vector<class TextLabel> &textStrs, const class TextProperties &properties);
 	void AddDrawTwistedTextCmd(const std::vector<class TwistedTextLabel> &textStrs, const class TextProperties &properties);
 	void AddLoadImageResourcesCmd(const std::map<std::string, std::string> &loadIdToFilenameMapping);
 	void AddUnloadImageResourcesCmd(const std::vector<std::string> &unloadIds);
+	void AddDrawPolygonInstancesCmd(const std::vector<Polygon> &polygons, const class ShapeProperties &properties,
+		const std::vector<double> &transforms, const std::vector<unsigned int> &colours);
+	void AddDrawLineInstancesCmd(const Contours &lines, const class LineProperties &properties,
+		const std::vector<double> &transforms, const std::vector<unsigned int> &colours);
 	int GetTriangleBoundsText(const TextLabel &label, const class TextProperties &properties, 
 		TwistedTriangles &trianglesOut);
 	int GetTriangleBoundsTwistedText(const TwistedTextLabel &label, 
@@ -266,7 +575,66 @@ public:
 		TwistedTriangles &trianglesOut,
 		double &pathLenOut, double &textLenOut);
 	int GetResourceDimensionsFromFilename(const std::string &filename, unsigned &widthOut, unsigned &heightOut);
+
+	///Simplify every polygon ring and line in the store in place using
+	///Ramer-Douglas-Peucker, spread over a thread pool (a temporary one if NULL).
+	///Detail levels are built again from the simplified geometry.
+	void Simplify(double epsilon, class WorkStealingPool *pool = NULL);
+
+	///Precompute simplified copies of all polygons and lines at each tolerance,
+	///including commands added later. An empty list of tolerances turns this off.
+	///When drawing, the coarsest level with a tolerance no larger than
+	///pixelError pixels is used.
+	void SetDetailLevels(const std::vector<double> &tolerances, double pixelError = 0.5,
+		class WorkStealingPool *pool = NULL);
+	///\return level to draw for a pixel size in drawing units, or -1 for the original geometry
+	int SelectDetailLevel(double pixelSize) const;
+
+	///Store the geometry of polygon and line commands, including those added
+	///later, in fixed point with units of step, such as 1/16 of a pixel. This
+	///uses a quarter to an eighth of the memory and is expanded again when
+	///drawn. Quantized commands have no detail levels. A step of zero turns
+	///this off and moves stored geometry back to floating point.
+	void SetQuantization(double step);
+	double GetQuantization() const;
+
+	///Set the transform from stored coordinates to drawing coordinates. This is
+	///applied when drawing, so the stored commands can be reused for other views.
+	void SetViewTransform(const class AffineTransform &transform);
+	const class AffineTransform &GetViewTransform() const;
+	///Transform every stored coordinate in place, including detail levels and labels
+	void TransformCoordinates(const class AffineTransform &transform);
+	///Exchange the commands, detail levels and view transform with another store
+	///without copying them, such as to draw a store on another back end
+	void SwapCmds(class LocalStore &other);
+
+	///Tessellate every polygon command at a level of detail ahead of drawing, so
+	///the meshes are cached and counted in the memory usage. Shared commands are
+	///copied first, leaving the other stores as they were.
+	void BuildPolygonMeshes(int level = -1);
+	///Tessellate the strokes of every line command at a level of detail ahead of drawing
+	void BuildStrokeMeshes(int level, double tolerance);
+
+	///Append the commands in a compact binary form, with coordinates rounded
+	///to multiples of step. Properties are written once and then referred to
+	///by number. Detail levels and meshes are not written. See StoreCodec.cpp.
+	void Encode(std::string &out, double step = 1.0 / 16.0) const;
+	///Add the commands written by Encode, decoding each one straight into the
+	///store as if it had been added. Throws std::runtime_error if the data is
+	///malformed, keeping the commands decoded before the error.
+	void Decode(const char *data, size_t size);
+	///As Decode, reading the stream a block at a time
+	void Decode(std::istream &in);
+
+	///Estimated memory used by the stored commands. This is kept up to date
+	///as commands are added and changed, so it is cheap to call. Commands
+	///shared with other stores are counted in each of them.
+	const class StoreMemoryUsage &GetMemoryUsage() const;
+	void ResetPeakMemoryUsage();
 };
 
+void LocalStoreTests();
+void QuantizedContoursTests();
+
 #endif //_DRAWLIB_H
 
@@ -4,7 +4,9 @@
 #include <cmath>
 #include <stdexcept>
 #include <iostream>
+#include <algorithm>
 #include "cairotwisted.h"
+#include "RectClip.h"
 using namespace std;
 
 DrawLibCairo::DrawLibCairo(cairo_surface_t *surface): LocalStore(),
@@ -12,6 +14,14 @@ DrawLibCairo::DrawLibCairo(cairo_surface_t *surface): LocalStore(),
 {
 	this->cr = cairo_create(surface);
 	this->maskSurface = NULL;
+	this->detailLevel = -1;
+	this->pixelSize = 1.0;
+	this->clipGeometry = true;
+	this->clipMarginPixels = 2.0;
+	this->collectStats = false;
+	this->traceFrames = false;
+	this->cmdVertices = 0;
+	this->cmdGlyphs = 0;
 }
 
 DrawLibCairo::~DrawLibCairo()
@@ -27,33 +37,151 @@ DrawLibCairo::~DrawLibCairo()
 	this->imageResources.clear();
 }
 
+void DrawLibCairo::SetSurface(cairo_surface_t *surface)
+{
+	cairo_destroy(this->cr);
+	this->surface = surface;
+	this->cr = cairo_create(surface);
+}
+
+///Apply the view transform to the context and pick the level of detail for it
+void DrawLibCairo::BeginDraw()
+{
+	const class AffineTransform &view = this->GetViewTransform();
+	if(!view.IsIdentity())
+	{
+		cairo_matrix_t viewMatrix;
+		cairo_matrix_init(&viewMatrix, view.xx, view.yx, view.xy, view.yy, view.x0, view.y0);
+		cairo_transform(this->cr, &viewMatrix);
+	}
+
+	//Pick level of detail from the size of a device pixel in user space
+	double pxx = 1.0, pxy = 0.0, pyx = 0.0, pyy = 1.0;
+	cairo_device_to_user_distance(this->cr, &pxx, &pxy);
+	cairo_device_to_user_distance(this->cr, &pyx, &pyy);
+	this->pixelSize = min(sqrt(pxx*pxx + pxy*pxy), sqrt(pyx*pyx + pyy*pyy));
+	this->detailLevel = this->SelectDetailLevel(this->pixelSize);
+}
+
+void DrawLibCairo::DrawCmd(class BaseCmd &baseCmd)
+{
+	switch(baseCmd.type)
+	{
+	case CMD_POLYGONS:
+		if(((class DrawPolygonsCmd &)baseCmd).IsQuantized())
+			this->DrawQuantizedPolygons((class DrawPolygonsCmd &)baseCmd);
+		else
+			this->DrawCmdPolygons((class DrawPolygonsCmd &)baseCmd);
+		break;
+	case CMD_LINES:
+		if(((class DrawLinesCmd &)baseCmd).IsQuantized())
+			this->DrawQuantizedLines((class DrawLinesCmd &)baseCmd);
+		else
+			this->DrawCmdLines((class DrawLinesCmd &)baseCmd);
+		break;
+	case CMD_TEXT:
+		this->DrawCmdText((class DrawTextCmd &)baseCmd);
+		break;
+	case CMD_TWISTED_TEXT:
+		this->DrawCmdTwistedText((class DrawTwistedTextCmd &)baseCmd);
+		break;
+	case CMD_LOAD_RESOURCES:
+		this->LoadResources((class LoadImageResourcesCmd &)baseCmd);
+		break;
+	case CMD_UNLOAD_RESOURCES:
+		this->UnloadResources((class UnloadImageResourcesCmd &)baseCmd);
+		break;
+	case CMD_INSTANCES:
+		this->DrawCmdInstances((class DrawInstancesCmd &)baseCmd);
+		break;
+	}
+}
+
+//Quantized geometry is expanded into a temporary command, leaving the stored
+//one unchanged so other threads may draw it at the same time. The expanded
+//points are kept in scratch memory between commands.
+
+void DrawLibCairo::DrawQuantizedPolygons(class DrawPolygonsCmd &polygonsCmd)
+{
+	class DrawPolygonsCmd expanded(std::vector<Polygon>(), polygonsCmd.properties);
+	expanded.polygons.swap(this->quantizedPolygons);
+	polygonsCmd.quantized.Dequantize(expanded.polygons);
+	try
+	{
+		this->DrawCmdPolygons(expanded);
+	}
+	catch(...)
+	{
+		expanded.polygons.swap(this->quantizedPolygons);
+		throw;
+	}
+	expanded.polygons.swap(this->quantizedPolygons);
+}
+
+void DrawLibCairo::DrawQuantizedLines(class DrawLinesCmd &linesCmd)
+{
+	class DrawLinesCmd expanded(Contours(), linesCmd.properties);
+	expanded.lines.swap(this->quantizedLines);
+	linesCmd.quantized.Dequantize(expanded.lines);
+	try
+	{
+		this->DrawCmdLines(expanded);
+	}
+	catch(...)
+	{
+		expanded.lines.swap(this->quantizedLines);
+		throw;
+	}
+	expanded.lines.swap(this->quantizedLines);
+}
+
+void DrawLibCairo::DrawSingleCmd(class BaseCmd &cmd)
+{
+	cairo_save(this->cr);
+	this->BeginDraw();
+	this->DrawCmd(cmd);
+	cairo_restore(this->cr);
+}
+
 void DrawLibCairo::Draw()
 {
+	cairo_save(this->cr);
+	this->BeginDraw();
+
+	bool timing = this->collectStats;
+	double frameStart = timing ? DrawStatsClock() : 0.0;
+	if(timing)
+		this->stats.frameTrace.clear();
+
 	for(size_t i=0;i < cmds.size(); i++) {
 		class BaseCmd *baseCmd = cmds[i];
-		switch(baseCmd->type)
+		double cmdStart = 0.0;
+		if(timing)
 		{
-		case CMD_POLYGONS:
-			this->DrawCmdPolygons(*(class DrawPolygonsCmd *)baseCmd);
-			break;
-		case CMD_LINES:
-			this->DrawCmdLines(*(class DrawLinesCmd *)baseCmd);
-			break;
-		case CMD_TEXT:
-			this->DrawCmdText(*(class DrawTextCmd *)baseCmd);
-			break;
-		case CMD_TWISTED_TEXT:
-			this->DrawCmdTwistedText(*(class DrawTwistedTextCmd *)baseCmd);
-			break;
-		case CMD_LOAD_RESOURCES:
-			this->LoadResources(*(class LoadImageResourcesCmd *)baseCmd);
-			break;
-		case CMD_UNLOAD_RESOURCES:
-			this->UnloadResources(*(class UnloadImageResourcesCmd *)baseCmd);
-			break;
+			this->cmdVertices = 0;
+			this->cmdGlyphs = 0;
+			cmdStart = DrawStatsClock();
 		}
 
+		this->DrawCmd(*baseCmd);
+
+		if(timing)
+			this->stats.AddCmd(baseCmd->type, frameStart, cmdStart, DrawStatsClock(),
+				this->cmdVertices, this->cmdGlyphs, this->traceFrames);
 	}
+	if(timing)
+		this->stats.AddFrame(frameStart, DrawStatsClock());
+	cairo_restore(this->cr);
+}
+
+const class DrawStats &DrawLibCairo::GetDrawStats() const
+{
+	return this->stats;
+}
+
+void DrawLibCairo::ClearDrawStats()
+{
+	this->stats.Clear();
 }
 
 void DrawLibCairo::CreateMaskSurface(double width, double height)
@@ -61,6 +189,9 @@ void DrawLibCairo::CreateMaskSurface(double width, double height)
 	if(this->maskSurface != NULL) 
 		cairo_surface_destroy(maskSurface);
 
+	if(this->collectStats)
+		this->stats.maskSurfaceCreations ++;
+
 	//Create mask surface
 	this->maskSurface = cairo_image_surface_create (CAIRO_FORMAT_A8,
 		                round(width),
@@ -82,6 +213,8 @@ void DrawLibCairo::SetPolySource(const class ShapeProperties &properties)
 		if(it != this->imageResources.end() && cairo_surface_status(it->second)==CAIRO_STATUS_SUCCESS)
 		{
 			cairo_pattern_t *pattern = cairo_pattern_create_for_surface (it->second);
+			if(this->collectStats)
+				this->stats.patternCreations ++;
 			cairo_pattern_set_extend (pattern,
                   CAIRO_EXTEND_REPEAT);
 
@@ -101,24 +234,92 @@ void DrawLibCairo::SetPolySource(const class ShapeProperties &properties)
 	}
 }
 
+void DrawLibCairo::GetClipRect(double &x1, double &y1, double &x2, double &y2)
+{
+	this->GetDrawableExtents(x1, y1, x2, y2);
+	double margin = this->clipMarginPixels * this->pixelSize;
+	x1 -= margin;
+	y1 -= margin;
+	x2 += margin;
+	y2 += margin;
+}
+
+void DrawLibCairo::SetLineStyle(const class LineProperties &properties)
+{
+	cairo_set_line_width (cr, properties.lineWidth);
+
+	if(properties.lineCap == "butt") //cairo default
+		cairo_set_line_cap (cr, CAIRO_LINE_CAP_BUTT);
+	if(properties.lineCap == "sqaure")
+		cairo_set_line_cap (cr, CAIRO_LINE_CAP_SQUARE);
+	if(properties.lineCap == "round")
+		cairo_set_line_cap (cr, CAIRO_LINE_CAP_ROUND);
+
+	if(properties.lineJoin == "miter") //cairo default
+		cairo_set_line_join (cr, CAIRO_LINE_JOIN_MITER);
+	if(properties.lineJoin == "round") //cairo default
+		cairo_set_line_join (cr, CAIRO_LINE_JOIN_ROUND);
+	if(properties.lineJoin == "bevel") //cairo default
+		cairo_set_line_join (cr, CAIRO_LINE_JOIN_BEVEL);
+}
+
 void DrawLibCairo::DrawCmdPolygons(class DrawPolygonsCmd &polygonsCmd)
 {
 	cairo_save (this->cr);
 	const class ShapeProperties &properties = polygonsCmd.properties;
 
+	double cx1=0.0, cy1=0.0, cx2=0.0, cy2=0.0;
+	if(this->clipGeometry)
+		this->GetClipRect(cx1, cy1, cx2, cy2);
+
 	//Draw outer polygons
-	const std::vector<Polygon> &polygons = polygonsCmd.polygons;
+	const std::vector<Polygon> &polygons = polygonsCmd.GetPolygons(this->detailLevel);
 	for(size_t i=0;i < polygons.size();i++)
 	{
 		const Polygon &polygon = polygons[i];
-		const Contour &outer = polygon.first;
-		const Contours &inners = polygon.second;
+		const Contour *outerPtr = &polygon.first;
+		const Contours &polyInners = polygon.second;
+
+		//Clip rings to the drawable area so only visible vertices reach cairo
+		std::vector<const Contour *> &inners = this->clipInnerPtrs;
+		inners.clear();
+		if(this->clipGeometry)
+		{
+			if(ClipRingToRect(*outerPtr, cx1, cy1, cx2, cy2, this->clipOuter, this->clipScratch))
+				outerPtr = &this->clipOuter;
+			if(outerPtr->size() == 0)
+				continue;
+
+			if(this->clipInners.size() < polyInners.size())
+				this->clipInners.resize(polyInners.size());
+			for(size_t j=0; j < polyInners.size(); j++)
+			{
+				const Contour *innerPtr = &polyInners[j];
+				if(ClipRingToRect(*innerPtr, cx1, cy1, cx2, cy2, this->clipInners[j], this->clipScratch))
+					innerPtr = &this->clipInners[j];
+				if(innerPtr->size() > 0)
+					inners.push_back(innerPtr);
+			}
+		}
+		else
+		{
+			for(size_t j=0; j < polyInners.size(); j++)
+				inners.push_back(&polyInners[j]);
+		}
+		const Contour &outer = *outerPtr;
 
 		double x1=0.0, x2=0.0, y1=0.0, y2=0.0;
 
 		if(inners.size() > 0)
 		{
-			this->GetDrawableExtents(x1, y1, x2, y2);
+			//The mask is in device pixels, so it stays sharp under any transform
+			cairo_matrix_t userToDevice;
+			cairo_get_matrix(cr, &userToDevice);
+			cairo_identity_matrix(cr);
+			cairo_clip_extents(cr, &x1, &y1, &x2, &y2);
+			cairo_set_matrix(cr, &userToDevice);
+			x1 = floor(x1); y1 = floor(y1);
+			x2 = ceil(x2); y2 = ceil(y2);
 			double width = x2 - x1;
 			double height = y2 - y1;
 
@@ -147,12 +348,19 @@ void DrawLibCairo::DrawCmdPolygons(class DrawPolygonsCmd &polygonsCmd)
 			cairo_line_to(maskCr, 0.0, height);
 			cairo_fill (maskCr);
 
+			//Draw rings in user coordinates, offset to the mask origin
+			cairo_matrix_t maskMatrix = userToDevice;
+			maskMatrix.x0 -= x1;
+			maskMatrix.y0 -= y1;
+			cairo_set_matrix(maskCr, &maskMatrix);
+
 			//Draw outer polygon to mask surface
 			cairo_set_source_rgba(maskCr, 1.0, 1.0, 1.0, 1.0);
+			this->cmdVertices += outer.size();
 			if(outer.size() > 0) {
-				cairo_move_to(maskCr, outer[0].first-x1, outer[0].second-y1);
+				cairo_move_to(maskCr, outer[0].first, outer[0].second);
 				for(size_t pt=1;pt < outer.size();pt++)
-					cairo_line_to(maskCr, outer[pt].first-x1, outer[pt].second-y1);
+					cairo_line_to(maskCr, outer[pt].first, outer[pt].second);
 				cairo_fill (maskCr);
 			}
 
@@ -160,11 +368,12 @@ void DrawLibCairo::DrawCmdPolygons(class DrawPolygonsCmd &polygonsCmd)
 			cairo_set_source_rgba(maskCr, 0.0, 0.0, 0.0, 0.0);
 			for(size_t j=0; j < inners.size(); j++)
 			{
-				const Contour &inner = inners[j];
+				const Contour &inner = *inners[j];
+				this->cmdVertices += inner.size();
 				if(inner.size() > 0) {
-					cairo_move_to(maskCr, inner[0].first-x1, inner[0].second-y1);
+					cairo_move_to(maskCr, inner[0].first, inner[0].second);
 					for(size_t pt=1;pt < inner.size();pt++)
-						cairo_line_to(maskCr, inner[pt].first-x1, inner[pt].second-y1);
+						cairo_line_to(maskCr, inner[pt].first, inner[pt].second);
 					cairo_fill (maskCr);
 				}
 			}
@@ -172,9 +381,12 @@ void DrawLibCairo::DrawCmdPolygons(class DrawPolygonsCmd &polygonsCmd)
 			cairo_surface_flush(maskSurface);
 			cairo_destroy(maskCr);
 
-			//Fill using mask surface
+			//Fill using mask surface. The source is set in user space
+			//so textures follow the transform.
 			this->SetPolySource(properties);
+			cairo_identity_matrix(cr);
 			cairo_mask_surface(cr, maskSurface, x1, y1);
+			cairo_set_matrix(cr, &userToDevice);
 			cairo_fill (cr);
 			
 		}
@@ -183,6 +395,7 @@ void DrawLibCairo::DrawCmdPolygons(class DrawPolygonsCmd &polygonsCmd)
 			this->SetPolySource(properties);
 
 			//Draw outer polygon
+			this->cmdVertices += outer.size();
 			if(outer.size() > 0) {
 				cairo_move_to(cr, outer[0].first, outer[0].second);
 				for(size_t pt=1;pt < outer.size();pt++)
@@ -200,26 +413,40 @@ void DrawLibCairo::DrawCmdLines(class DrawLinesCmd &linesCmd)
 	cairo_save (this->cr);
 	const class LineProperties &properties = linesCmd.properties;
 	cairo_set_source_rgba(cr, properties.r, properties.g, properties.b, properties.a);
-	cairo_set_line_width (cr, properties.lineWidth);
+	this->SetLineStyle(properties);
 
-	if(properties.lineCap == "butt") //cairo default
-		cairo_set_line_cap (cr, CAIRO_LINE_CAP_BUTT);
-	if(properties.lineCap == "sqaure")
-		cairo_set_line_cap (cr, CAIRO_LINE_CAP_SQUARE);
-	if(properties.lineCap == "round")
-		cairo_set_line_cap (cr, CAIRO_LINE_CAP_ROUND);
-
-	if(properties.lineJoin == "miter") //cairo default
-		cairo_set_line_join (cr, CAIRO_LINE_JOIN_MITER);
-	if(properties.lineJoin == "round") //cairo default
-		cairo_set_line_join (cr, CAIRO_LINE_JOIN_ROUND);
-	if(properties.lineJoin == "bevel") //cairo default
-		cairo_set_line_join (cr, CAIRO_LINE_JOIN_BEVEL);
+	//Clip to the drawable area, leaving room for the widest miter join
+	double cx1=0.0, cy1=0.0, cx2=0.0, cy2=0.0;
+	if(this->clipGeometry)
+	{
+		this->GetClipRect(cx1, cy1, cx2, cy2);
+		double strokeMargin = 0.5 * properties.lineWidth * max(cairo_get_miter_limit(cr), M_SQRT2);
+		cx1 -= strokeMargin;
+		cy1 -= strokeMargin;
+		cx2 += strokeMargin;
+		cy2 += strokeMargin;
+	}
 
-	const Contours &lines = linesCmd.lines;
+	const Contours &lines = linesCmd.GetLines(this->detailLevel);
 	for(size_t i=0;i < lines.size();i++)
 	{
 		const Contour &contour = lines[i];
+		if(this->clipGeometry && ClipLineToRect(contour, properties.closedLoop, cx1, cy1, cx2, cy2, this->clipPieces))
+		{
+			//Draw visible pieces only
+			for(size_t j=0;j < this->clipPieces.size();j++)
+			{
+				const Contour &piece = this->clipPieces[j];
+				this->cmdVertices += piece.size();
+				cairo_move_to(cr, piece[0].first, piece[0].second);
+				for(size_t pt=1;pt < piece.size();pt++)
+					cairo_line_to(cr, piece[pt].first, piece[pt].second);
+			}
+			cairo_stroke (cr);
+			continue;
+		}
+
+		this->cmdVertices += contour.size();
 		if(contour.size() > 0)
 			cairo_move_to(cr, contour[0].first, contour[0].second);
 		for(size_t pt=1;pt < contour.size();pt++)
@@ -234,6 +461,139 @@ void DrawLibCairo::DrawCmdLines(class DrawLinesCmd &linesCmd)
 	cairo_restore(this->cr);
 }
 
+void DrawLibCairo::DrawCmdInstances(class DrawInstancesCmd &instancesCmd)
+{
+	size_t numInstances = instancesCmd.NumInstances();
+	bool filled = instancesCmd.polygons.size() > 0;
+	if(numInstances == 0 || (!filled && instancesCmd.lines.size() == 0))
+		return;
+	cairo_save (this->cr);
+
+	//Build the prototype path once, then replay it under each instance transform
+	double px1=0.0, py1=0.0, px2=0.0, py2=0.0;
+	bool firstPt = true;
+	size_t protoVertices = 0;
+	cairo_new_path(cr);
+	if(filled)
+	{
+		const std::vector<Polygon> &polygons = instancesCmd.polygons;
+		for(size_t i=0;i < polygons.size();i++)
+		{
+			for(size_t j=0;j < polygons[i].second.size() + 1;j++)
+			{
+				const Contour &ring = j == 0 ? polygons[i].first : polygons[i].second[j-1];
+				for(size_t pt=0;pt < ring.size();pt++)
+				{
+					double x = ring[pt].first, y = ring[pt].second;
+					if(pt == 0)
+						cairo_move_to(cr, x, y);
+					else
+						cairo_line_to(cr, x, y);
+					if(firstPt || x < px1) px1 = x;
+					if(firstPt || x > px2) px2 = x;
+					if(firstPt || y < py1) py1 = y;
+					if(firstPt || y > py2) py2 = y;
+					firstPt = false;
+				}
+				if(ring.size() > 0)
+					cairo_close_path(cr);
+				protoVertices += ring.size();
+			}
+		}
+		cairo_set_fill_rule(cr, CAIRO_FILL_RULE_EVEN_ODD);
+		this->SetPolySource(instancesCmd.shapeProperties);
+	}
+	else
+	{
+		const class LineProperties &properties = instancesCmd.lineProperties;
+		const Contours &lines = instancesCmd.lines;
+		for(size_t i=0;i < lines.size();i++)
+		{
+			const Contour &contour = lines[i];
+			for(size_t pt=0;pt < contour.size();pt++)
+			{
+				double x = contour[pt].first, y = contour[pt].second;
+				if(pt == 0)
+					cairo_move_to(cr, x, y);
+				else
+					cairo_line_to(cr, x, y);
+				if(firstPt || x < px1) px1 = x;
+				if(firstPt || x > px2) px2 = x;
+				if(firstPt || y < py1) py1 = y;
+				if(firstPt || y > py2) py2 = y;
+				firstPt = false;
+			}
+			if(properties.closedLoop && contour.size() > 0)
+				cairo_close_path(cr);
+			protoVertices += contour.size();
+		}
+		this->SetLineStyle(properties);
+		cairo_set_source_rgba(cr, properties.r, properties.g, properties.b, properties.a);
+
+		//Strokes are scaled with the instance, so grow the prototype bounds before transforming them
+		double strokeMargin = 0.5 * properties.lineWidth * max(cairo_get_miter_limit(cr), M_SQRT2);
+		px1 -= strokeMargin;
+		py1 -= strokeMargin;
+		px2 += strokeMargin;
+		py2 += strokeMargin;
+	}
+	cairo_path_t *path = cairo_copy_path(cr);
+	cairo_new_path(cr);
+
+	double cx1=0.0, cy1=0.0, cx2=0.0, cy2=0.0;
+	if(this->clipGeometry)
+		this->GetClipRect(cx1, cy1, cx2, cy2);
+	bool perInstanceColour = instancesCmd.colours.size() > 0;
+
+	for(size_t i=0;i < numInstances;i++)
+	{
+		class AffineTransform transform = instancesCmd.GetTransform(i);
+		//A singular matrix puts cairo in an error state that later commands
+		//would inherit, and the instance would have no area anyway
+		if(!transform.IsInvertible())
+			continue;
+		if(this->clipGeometry)
+		{
+			//Skip instances whose transformed bounds miss the drawable area
+			double bx[4] = {px1, px2, px2, px1};
+			double by[4] = {py1, py1, py2, py2};
+			double ix1=0.0, iy1=0.0, ix2=0.0, iy2=0.0;
+			for(int k=0;k < 4;k++)
+			{
+				transform.Apply(bx[k], by[k]);
+				if(k == 0 || bx[k] < ix1) ix1 = bx[k];
+				if(k == 0 || bx[k] > ix2) ix2 = bx[k];
+				if(k == 0 || by[k] < iy1) iy1 = by[k];
+				if(k == 0 || by[k] > iy2) iy2 = by[k];
+			}
+			if(ix2 < cx1 || ix1 > cx2 || iy2 < cy1 || iy1 > cy2)
+				continue;
+		}
+
+		cairo_save(cr);
+		cairo_matrix_t instanceMatrix;
+		cairo_matrix_init(&instanceMatrix, transform.xx, transform.yx, transform.xy, transform.yy, 
+			transform.x0, transform.y0);
+		cairo_transform(cr, &instanceMatrix);
+		cairo_append_path(cr, path);
+		if(perInstanceColour)
+		{
+			double r=0.0, g=0.0, b=0.0, a=0.0;
+			instancesCmd.GetColour(i, r, g, b, a);
+			cairo_set_source_rgba(cr, r, g, b, a);
+		}
+		if(filled)
+			cairo_fill(cr);
+		else
+			cairo_stroke(cr);
+		cairo_restore(cr);
+		this->cmdVertices += protoVertices;
+	}
+
+	cairo_path_destroy(path);
+	cairo_restore(this->cr);
+}
+
 void DrawLibCairo::DrawCmdText(class DrawTextCmd &textCmd)
 {
 	cairo_save (this->cr);
@@ -247,6 +607,9 @@ void DrawLibCairo::DrawCmdText(class DrawTextCmd &textCmd)
 	const std::vector<class TextLabel> &textStrs = textCmd.textStrs;
 	for(size_t i=0;i < textStrs.size();i++)
 	{
+		if(this->collectStats)
+			this->cmdGlyphs += CountCharacters(textStrs[i].text);
+
 		cairo_text_extents_t extents;
 		cairo_text_extents (cr,
                     textStrs[i].text.c_str(),
@@ -409,6 +772,19 @@ void DrawLibCairoPango::DrawCmdText(class DrawTextCmd &textCmd)
                                 &ink_rect,
                                 &logical_rect);
 
+		if(this->collectStats)
+		{
+			PangoLayoutIter *iter = pango_layout_get_iter (layout);
+			do
+			{
+				PangoLayoutRun *run = pango_layout_iter_get_run_readonly (iter);
+				if(run != NULL)
+					this->cmdGlyphs += run->glyphs->num_glyphs;
+			}
+			while(pango_layout_iter_next_run (iter));
+			pango_layout_iter_free (iter);
+		}
+
 		if(properties.outline)
 		{
 			cairo_save (this->cr);
@@ -470,6 +846,11 @@ void DrawLibCairoPango::DrawCmdTwistedText(class DrawTwistedTextCmd &textCmd)
 	for(size_t i=0; i< textCmd.textStrs.size(); i++)
 	{
 		const class TwistedTextLabel &tl = textCmd.textStrs[i];
+		if(this->collectStats)
+		{
+			this->cmdGlyphs += CountCharacters(tl.text);
+			this->cmdVertices += tl.path.coords.size() / 2;
+		}
 		double pathLen = 0.0;
 		double textLen = 0.0;
 		draw_formatted_twisted_text (this->cr, tl.text, tl.path, properties, pathLen, textLen);
@@ -546,3 +927,108 @@ int DrawLibCairoPango::GetTriangleBoundsTwistedText(const TwistedTextLabel &labe
 	return 0;
 }
 
+// *****************************************************
+
+DrawLibCairoStream::DrawLibCairoStream(class DrawLibCairo &target) : IDrawLib(), target(target)
+{
+
+}
+
+DrawLibCairoStream::~DrawLibCairoStream()
+{
+
+}
+
+void DrawLibCairoStream::DrawAndClear()
+{
+	this->target.Draw();
+	this->target.ClearDrawingCmds();
+}
+
+void DrawLibCairoStream::ClearDrawingCmds()
+{
+	this->target.ClearDrawingCmds();
+}
+
+void DrawLibCairoStream::AddCmd(class BaseCmd *cmd)
+{
+	this->target.AddCmd(cmd);
+	this->DrawAndClear();
+}
+
+void DrawLibCairoStream::AddDrawPolygonsCmd(const std::vector<Polygon> &polygons, const class ShapeProperties &properties)
+{
+	this->target.AddDrawPolygonsCmd(polygons, properties);
+	this->DrawAndClear();
+}
+
+void DrawLibCairoStream::AddDrawLinesCmd(const Contours &lines, const class LineProperties &properties)
+{
+	this->target.AddDrawLinesCmd(lines, properties);
+	this->DrawAndClear();
+}
+
+void DrawLibCairoStream::AddDrawTextCmd(const std::vector<class TextLabel> &textStrs, const class TextProperties &properties)
+{
+	this->target.AddDrawTextCmd(textStrs, properties);
+	this->DrawAndClear();
+}
+
+void DrawLibCairoStream::AddDrawTwistedTextCmd(const std::vector<class TwistedTextLabel> &textStrs, const class TextProperties &properties)
+{
+	this->target.AddDrawTwistedTextCmd(textStrs, properties);
+	this->DrawAndClear();
+}
+
+void DrawLibCairoStream::AddLoadImageResourcesCmd(const std::map<std::string, std::string> &loadIdToFilenameMapping)
+{
+	//Loaded images stay in the target until they are unloaded
+	this->target.AddLoadImageResourcesCmd(loadIdToFilenameMapping);
+	this->DrawAndClear();
+}
+
+void DrawLibCairoStream::AddUnloadImageResourcesCmd(const std::vector<std::string> &unloadIds)
+{
+	this->target.AddUnloadImageResourcesCmd(unloadIds);
+	this->DrawAndClear();
+}
+
+void DrawLibCairoStream::AddDrawPolygonInstancesCmd(const std::vector<Polygon> &polygons, const class ShapeProperties &properties,
+	const std::vector<double> &transforms, const std::vector<unsigned int> &colours)
+{
+	this->target.AddDrawPolygonInstancesCmd(polygons, properties, transforms, colours);
+	this->DrawAndClear();
+}
+
+void DrawLibCairoStream::AddDrawLineInstancesCmd(const Contours &lines, const class LineProperties &properties,
+	const std::vector<double> &transforms, const std::vector<unsigned int> &colours)
+{
+	this->target.AddDrawLineInstancesCmd(lines, properties, transforms, colours);
+	this->DrawAndClear();
+}
+
+int DrawLibCairoStream::GetTriangleBoundsText(const TextLabel &label, const class TextProperties &properties, 
+	TwistedTriangles &trianglesOut)
+{
+	return this->target.GetTriangleBoundsText(label, properties, trianglesOut);
+}
+
+int DrawLibCairoStream::GetTriangleBoundsTwistedText(const TwistedTextLabel &label, 
+	const class TextProperties &properties, 
+	TwistedTriangles &trianglesOut, double &pathLenOut, double &textLenOut)
+{
+	return this->target.GetTriangleBoundsTwistedText(label, properties, trianglesOut, pathLenOut, textLenOut);
+}
+
+int DrawLibCairoStream::GetResourceDimensionsFromFilename(const std::string &filename, unsigned &widthOut, unsigned &heightOut)
+{
+	return this->target.GetResourceDimensionsFromFilename(filename, widthOut, heightOut);
+}
+
+int DrawLibCairoStream::GetDrawableExtents(double &x1,
+	double &y1,
+	double &x2,
+	double &y2)
+{
+	return this->target.GetDrawableExtents(x1, y1, x2, y2);
+}
@@ -3,6 +3,7 @@
 
 #include <cairo/cairo.h>
 #include "drawlib.h"
+#include "DrawStats.h"
 
 ///Drawing with a cairo back end
 class DrawLibCairo : public LocalStore
@@ -12,21 +13,50 @@ protected:
 	cairo_surface_t *surface;
 	cairo_surface_t *maskSurface;
 	std::map<std::string, cairo_surface_t *> imageResources;
+	int detailLevel; //Level of detail chosen for the current Draw
+	double pixelSize; //Size of a device pixel in user units for the current Draw
+	Contour clipOuter, clipScratch; //Working space for clipping
+	Contours clipInners;
+	std::vector<const Contour *> clipInnerPtrs;
+	Contours clipPieces;
+	std::vector<Polygon> quantizedPolygons; //Working space for expanding quantized geometry
+	Contours quantizedLines;
+	class DrawStats stats;
+	size_t cmdVertices, cmdGlyphs; //Counted by the command being drawn
 
 	virtual void DrawCmdPolygons(class DrawPolygonsCmd &polygons);
 	virtual void DrawCmdLines(class DrawLinesCmd &linesCmd);
 	virtual void DrawCmdText(class DrawTextCmd &textCmd);
 	virtual void DrawCmdTwistedText(class DrawTwistedTextCmd &textCmd);
+	virtual void DrawCmdInstances(class DrawInstancesCmd &instancesCmd);
 	virtual void LoadResources(class LoadImageResourcesCmd &resourcesCmd);
 	virtual void UnloadResources(class UnloadImageResourcesCmd &resourcesCmd);
 
+	void BeginDraw();
+	void DrawCmd(class BaseCmd &baseCmd);
+	void DrawQuantizedPolygons(class DrawPolygonsCmd &polygonsCmd);
+	void DrawQuantizedLines(class DrawLinesCmd &linesCmd);
 	void CreateMaskSurface(double width, double height);
+	void GetClipRect(double &x1, double &y1, double &x2, double &y2);
 	void SetPolySource(const class ShapeProperties &properties);
+	void SetLineStyle(const class LineProperties &properties);
 public:
+	bool clipGeometry; //Clip geometry to the drawable area before passing it to cairo
+	double clipMarginPixels; //Distance outside the drawable area to clip at
+	bool collectStats; //Time and count commands as they are drawn
+	bool traceFrames; //Also keep a trace of each command of the last frame, if collecting stats
+
 	DrawLibCairo(cairo_surface_t *surface);
 	virtual ~DrawLibCairo();
 
+	///Draw on another surface from now on. Stored commands and loaded images are kept.
+	void SetSurface(cairo_surface_t *surface);
+
 	void Draw();
+	///Draw one command straight away, with the view transform, without storing it
+	void DrawSingleCmd(class BaseCmd &cmd);
+	const class DrawStats &GetDrawStats() const;
+	void ClearDrawStats();
 	int GetTriangleBoundsText(const TextLabel &label, const class TextProperties &properties, 
 		TwistedTriangles &trianglesOut);
 	int GetDrawableExtents(double &x1,
@@ -53,4 +83,42 @@ public:
 		TwistedTriangles &trianglesOut, double &pathLenOut, double &textLenOut);
 };
 
+///Draw each command on a cairo drawing library as soon as it is added, then
+///discard it, so memory use does not grow with the number of commands. Used
+///with a cairo PDF or SVG surface, this streams vector output. Cairo itself
+///keeps the content of the current page until cairo_show_page is called.
+class DrawLibCairoStream : public IDrawLib
+{
+protected:
+	class DrawLibCairo &target;
+
+	void DrawAndClear();
+public:
+	DrawLibCairoStream(class DrawLibCairo &target);
+	virtual ~DrawLibCairoStream();
+
+	void ClearDrawingCmds();
+	void AddCmd(class BaseCmd *cmd);
+	void AddDrawPolygonsCmd(const std::vector<Polygon> &polygons, const class ShapeProperties &properties);
+	void AddDrawLinesCmd(const Contours &lines, const class LineProperties &properties);
+	void AddDrawTextCmd(const std::vector<class TextLabel> &textStrs, const class TextProperties &properties);
+	void AddDrawTwistedTextCmd(const std::vector<class TwistedTextLabel> &textStrs, const class TextProperties &properties);
+	void AddLoadImageResourcesCmd(const std::map<std::string, std::string> &loadIdToFilenameMapping);
+	void AddUnloadImageResourcesCmd(const std::vector<std::string> &unloadIds);
+	void AddDrawPolygonInstancesCmd(const std::vector<Polygon> &polygons, const class ShapeProperties &properties,
+		const std::vector<double> &transforms, const std::vector<unsigned int> &colours);
+	void AddDrawLineInstancesCmd(const Contours &lines, const class LineProperties &properties,
+		const std::vector<double> &transforms, const std::vector<unsigned int> &colours);
+	int GetTriangleBoundsText(const TextLabel &label, const class TextProperties &properties, 
+		TwistedTriangles &trianglesOut);
+	int GetTriangleBoundsTwistedText(const TwistedTextLabel &label, 
+		const class TextProperties &properties, 
+		TwistedTriangles &trianglesOut, double &pathLenOut, double &textLenOut);
+	int GetResourceDimensionsFromFilename(const std::string &filename, unsigned &widthOut, unsigned &heightOut);
+	int GetDrawableExtents(double &x1,
+		double &y1,
+		double &x2,
+		double &y2);
+};
+
 #endif //_DRAW_LIB_CAIRO_H
@@ -1,4 +1,12 @@
 #include "drawlibcairo.h"
+#include "DrawLibRaster.h"
+#include "DrawLibTiled.h"
+#include "DrawLibSvg.h"
+#include "RenderQueue.h"
+#include "DrawLibPipe.h"
+#include <fstream>
+#include <string.h>
+#include <stdlib.h>
 #include <iostream>
 using namespace std;
 
@@ -105,9 +113,9 @@ void DrawTestPatterns(class IDrawLib *drawLib)
 
 	//Twisted text
 	std::vector<class TwistedTextLabel> twistedTextStrs;
-	std::vector<TwistedCurveCmd> pathCmds;
-	pathCmds.push_back(NewTwistedCurveCmd(MoveTo, 2, 320.0, 100.0));
-	pathCmds.push_back(NewTwistedCurveCmd(RelCurveTo, 6, 50.0, -50.0, 150.0, -50.0, 200.0, 0.0));
+	class TwistedPath pathCmds;
+	pathCmds.MoveTo(320.0, 100.0);
+	pathCmds.RelCurveTo(50.0, -50.0, 150.0, -50.0, 200.0, 0.0);
 	twistedTextStrs.push_back(TwistedTextLabel(arabic, pathCmds));
 	properties2.valign = 0.5;
 	drawLib->AddDrawTwistedTextCmd(twistedTextStrs, properties2);
@@ -136,7 +144,7 @@ void DrawTestPatterns(class IDrawLib *drawLib)
 
 	//Test fitting Bezier to set of points
 	const char *rooms = "All the rooms renumbered. All the rooms renumbered.";
-	std::vector<TwistedCurveCmd> pathCmds2;
+	class TwistedPath pathCmds2;
 	FixBezierToPoints(line3, pathCmds2);
 	class TextProperties properties3;
 	properties3.fontSize = 15.0;
@@ -181,6 +189,36 @@ void DrawTestPatterns(class IDrawLib *drawLib)
 
 }
 
+///Largest difference of any channel of any pixel between two images of the same size
+static int MaxPixelDifference(cairo_surface_t *a, cairo_surface_t *b, int tolerance, int &pixelsOverOut)
+{
+	cairo_surface_flush(a);
+	cairo_surface_flush(b);
+	const unsigned char *pa = cairo_image_surface_get_data(a);
+	const unsigned char *pb = cairo_image_surface_get_data(b);
+	int stride = cairo_image_surface_get_stride(a);
+	int maxDiff = 0;
+	pixelsOverOut = 0;
+	for(int y = 0; y < cairo_image_surface_get_height(a); y++)
+	{
+		for(int x = 0; x < cairo_image_surface_get_width(a); x++)
+		{
+			int pixelDiff = 0;
+			for(int c = 0; c < 4; c++)
+			{
+				int diff = abs((int)pa[y * stride + x * 4 + c] - (int)pb[y * stride + x * 4 + c]);
+				if(diff > pixelDiff)
+					pixelDiff = diff;
+			}
+			if(pixelDiff > tolerance)
+				pixelsOverOut++;
+			if(pixelDiff > maxDiff)
+				maxDiff = pixelDiff;
+		}
+	}
+	return maxDiff;
+}
+
 int main(void)
 {
 	cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 640, 480);
@@ -189,8 +227,90 @@ int main(void)
 	
 	DrawTestPatterns(&drawlib);
 
+	//Vector copy, measuring text with the cairo back end
+	std::ofstream svgFile("image.svg");
+	{
+		class DrawLibSvg svg(svgFile, 640, 480, &drawlib);
+		DrawTestPatterns(&svg);
+	}
+
 	cairo_surface_write_to_png(surface, "image.png");	
+
+	//Same patterns drawn in tiles in parallel, which should match image.png exactly
+	cairo_surface_t *tiledSurface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 640, 480);
+	{
+		class WorkStealingPool pool(4);
+		class DrawLibTiled tiledlib(tiledSurface, &pool);
+		tiledlib.tileSize = 64;
+		DrawTestPatterns(&tiledlib);
+	}
+	cairo_surface_write_to_png(tiledSurface, "image_tiled.png");
+	cairo_surface_flush(surface);
+	cairo_surface_flush(tiledSurface);
+	int stride = cairo_image_surface_get_stride(surface);
+	bool tilesMatch = memcmp(cairo_image_surface_get_data(surface), cairo_image_surface_get_data(tiledSurface),
+		stride * cairo_image_surface_get_height(surface)) == 0;
+	cout << "Tiled drawing " << (tilesMatch ? "matches" : "differs from") << " serial drawing" << endl;
+	cairo_surface_destroy(tiledSurface);
+
+	//Same patterns from the software rasterizer, which should match image.png
+	//apart from small differences in antialiasing
+	cairo_surface_t *rasterSurface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 640, 480);
+	{
+		class DrawLibRaster rasterlib(rasterSurface);
+		DrawTestPatterns(&rasterlib);
+	}
+	cairo_surface_write_to_png(rasterSurface, "image_raster.png");
+	const int rasterTolerance = 8;
+	int pixelsOver = 0;
+	int maxDiff = MaxPixelDifference(surface, rasterSurface, rasterTolerance, pixelsOver);
+	cout << "Raster drawing " << (pixelsOver == 0 ? "matches" : "differs from") << " serial drawing, "
+		<< "max difference " << maxDiff << ", " << pixelsOver << " pixels over " << rasterTolerance << endl;
+	cairo_surface_destroy(rasterSurface);
 	cairo_surface_destroy(surface);
+
+	//A command after an instance with a singular transform is still drawn
+	surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 64, 64);
+	{
+		class DrawLibCairo singularlib(surface);
+		std::vector<Polygon> square(1);
+		square[0].first.push_back(Point(0, 0));
+		square[0].first.push_back(Point(64, 0));
+		square[0].first.push_back(Point(64, 64));
+		square[0].first.push_back(Point(0, 64));
+		double transforms[] = {0.0, 0.0, 0.0, 0.0, 10.0, 10.0, 1.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+		singularlib.AddDrawPolygonInstancesCmd(square, ShapeProperties(0.0, 0.0, 1.0),
+			std::vector<double>(transforms, transforms + 12), std::vector<unsigned int>());
+		singularlib.AddDrawPolygonsCmd(square, ShapeProperties(1.0, 0.0, 0.0));
+		singularlib.Draw();
+	}
+	cairo_surface_flush(surface);
+	uint32_t centre = *(const uint32_t *)(cairo_image_surface_get_data(surface)
+		+ 32 * cairo_image_surface_get_stride(surface) + 32 * 4);
+	cout << "Drawing after a singular instance " << (centre == 0xffff0000 ? "works" : "is lost") << endl;
+	cairo_surface_destroy(surface);
+
+	//Same patterns drawn on a second thread while they are added
+	surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 640, 480);
+	{
+		class DrawLibCairoPango target(surface);
+		class DrawLibPipe pipe(target, 4);
+		DrawTestPatterns(&pipe);
+	}
+	cairo_surface_write_to_png(surface, "image_pipe.png");
+	cairo_surface_destroy(surface);
+
+	//Same patterns drawn on a render queue thread
+	{
+		class RenderQueue queue(2, 4);
+		class LocalStore *store = new class LocalStore();
+		DrawTestPatterns(store);
+		std::future<class RenderResult> future = queue.Submit(store, 640, 480);
+		class RenderResult result = future.get();
+		cout << "Queued drawing took " << result.drawSeconds << " s" << endl;
+		cairo_surface_write_to_png(result.surface, "image_queue.png");
+		cairo_surface_destroy(result.surface);
+	}
 	return 0;
 }
 